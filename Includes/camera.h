@@ -44,6 +44,101 @@
 #ifndef SOURCES_CAMERA_H_
 #define SOURCES_CAMERA_H_
 
+/* CONFIGURATION *******************************************************************/
+
+/**
+ @brief Drop the whole frame on a camera buffer overrun.
+ @details When defined, an overrun of the camera buffer discards the rest
+ 	 of the current frame. Lines are not stored again until the next VSYNC
+ 	 edge and camera_read reports the aborted frame through
+ 	 camera_frame_aborted() so that it can be marked in error to the host.
+ 	 The camera interface also waits for a VSYNC edge after every complete
+ 	 frame. When undefined, only the overrunning lines are discarded.
+ */
+#define CAMERA_OVERRUN_DROP_FRAME
+
+/**
+ @brief Pass camera data straight to the USB endpoint.
+ @details When defined, cam_ISR can write full scale YUYV lines from the
+ 	 camera FIFO directly into the endpoint FIFO through the function set
+ 	 by camera_passthrough_start(). Each pixel is then moved once instead
+ 	 of being written to the camera buffer and read back out of it. The
+ 	 camera buffer only takes the part of a line which does not fit in
+ 	 the endpoint and the last line of each frame.
+ */
+#undef CAMERA_PASSTHROUGH
+
+/**
+ @brief Frame rate decimation factors.
+ @details Each mode added at a camera module frame rate is also offered
+ 	 at that rate divided by each of these factors. A 15 fps mode is then
+ 	 offered at 15, 7.5, 5 and 3.75 fps. Frames which are skipped are
+ 	 flushed from the camera FIFO and are never stored or sent over USB.
+ 	 Each entry is X(factor, arg) where arg is passed through unchanged.
+ 	 The first factor must be 1 and the factors must increase.
+ */
+#define CAMERA_FRAME_DECIMATION(X, arg) X(1, arg) X(2, arg) X(3, arg) X(4, arg)
+
+/**
+ @brief Camera modes offered to the host.
+ @details There is one list for each output format. Each entry is
+ 	 X(image_width, image_height, x, y, width, height, frame_rate).
+ 	 The camera module is set up for an image of image_width by
+ 	 image_height at frame_rate and only the window of width by height at
+ 	 offset x and y is stored and sent. For a whole frame the window is the
+ 	 image size at offset zero. The offset and width must be even. There
+ 	 can be only one entry for each image and window in a list.
+ 	 The camera mode table and the USB configuration descriptors are both
+ 	 made from these lists at compile time. Frame indexes for each format
+ 	 follow the order of the list.
+ 	 The *_FS lists hold the modes which are also offered when the device
+ 	 is connected at USB Full Speed. They start each full list so that a
+ 	 mode has the same frame index at both speeds. Every format with modes
+ 	 must have at least one Full Speed mode.
+ */
+//@{
+#define CAMERA_MODES_UNCOMPRESSED_FS(X) \
+	X(160, 120, 0, 0, 160, 120, 15)
+#define CAMERA_MODES_LUMA_FS(X) \
+	X(160, 120, 0, 0, 160, 120, 15)
+#define CAMERA_MODES_MJPEG_FS(X) \
+	X(160, 120, 0, 0, 160, 120, 15)
+
+#define CAMERA_MODES_UNCOMPRESSED(X) \
+	CAMERA_MODES_UNCOMPRESSED_FS(X) \
+	X(320, 240, 0, 0, 320, 240, 15) \
+	X(640, 480, 0, 0, 640, 480, 15) \
+	/* Band across the bottom of the VGA frame for line following and docking. */ \
+	X(640, 480, 0, 360, 640, 120, 15)
+#define CAMERA_MODES_LUMA(X) \
+	CAMERA_MODES_LUMA_FS(X) \
+	X(320, 240, 0, 0, 320, 240, 15) \
+	X(640, 480, 0, 0, 640, 480, 15)
+#define CAMERA_MODES_MJPEG(X) \
+	CAMERA_MODES_MJPEG_FS(X) \
+	X(320, 240, 0, 0, 320, 240, 15)
+//@}
+
+/**
+ @brief Counts of configured modes and decimation factors.
+ @details Worked out from the lists above by the preprocessor so that they
+ 	 can be used in array sizes and in #if tests. The last decimation
+ 	 factor is the largest. It is found by multiplying every other factor
+ 	 by zero.
+ */
+//@{
+#define CAMERA_COUNT_ONE(...) + 1
+#define CAMERA_LAST_ONE(a, ...) * 0 + (a)
+#define CAMERA_FRAME_COUNT_UNCOMPRESSED (0 CAMERA_MODES_UNCOMPRESSED(CAMERA_COUNT_ONE))
+#define CAMERA_FRAME_COUNT_LUMA (0 CAMERA_MODES_LUMA(CAMERA_COUNT_ONE))
+#define CAMERA_FRAME_COUNT_MJPEG (0 CAMERA_MODES_MJPEG(CAMERA_COUNT_ONE))
+#define CAMERA_FRAME_COUNT_UNCOMPRESSED_FS (0 CAMERA_MODES_UNCOMPRESSED_FS(CAMERA_COUNT_ONE))
+#define CAMERA_FRAME_COUNT_LUMA_FS (0 CAMERA_MODES_LUMA_FS(CAMERA_COUNT_ONE))
+#define CAMERA_FRAME_COUNT_MJPEG_FS (0 CAMERA_MODES_MJPEG_FS(CAMERA_COUNT_ONE))
+#define CAMERA_FRAME_DECIMATION_COUNT (0 CAMERA_FRAME_DECIMATION(CAMERA_COUNT_ONE, 0))
+#define CAMERA_FRAME_DECIMATION_MAX (0 CAMERA_FRAME_DECIMATION(CAMERA_LAST_ONE, 0))
+//@}
+
 /**
  @brief Output format definitions for camera interface.
  @details Uncompressed video is an uncompressed bitmap format which is
@@ -51,10 +146,18 @@
  	 by DirectShow as an input format from a WebCam. It is not supported
  	 by Live555 (and derivatives such as VLC) as an input format.
  	 MJPEG format is Motion-JPEG and consists of a series of JPEG
- 	 compressed frames. There is no inter-frame compression. */
+ 	 compressed frames. There is no inter-frame compression. The camera
+ 	 interface stores YUYV lines for MJPEG which are compressed by the
+ 	 encoder in mjpeg.c.
+ 	 Luma format is uncompressed with only the Y byte of each pixel.
+ 	 It is made by the camera interface from YUYV data. */
 //@{
 #define CAMERA_FORMAT_ANY 0
 #define CAMERA_FORMAT_UNCOMPRESSED 1
+#define CAMERA_FORMAT_LUMA 2
+#define CAMERA_FORMAT_MJPEG 3
+/// Number of output formats excluding CAMERA_FORMAT_ANY.
+#define CAMERA_FORMAT_COUNT 3
 //@}
 
 /**
@@ -86,20 +189,102 @@
 #define CAMERA_STREAMING_STOP 2
 #define CAMERA_STREAMING_STARTED 3
 #define CAMERA_STREAMING_STOPPED 4
+/// Camera started and waiting for a VSYNC edge before streaming.
+#define CAMERA_STREAMING_SYNC 5
+/// Committed mode is already running. Restart the stream without
+/// setting up the camera again.
+#define CAMERA_STREAMING_RESTART 6
+
+/**
+ @brief Place the camera buffer in free RAM.
+ @details When defined camera_init() uses all the RAM between the end of
+ 	 static data, as reported by the linker, and the stack for the camera
+ 	 buffer. CAMERA_STACK_RESERVE bytes are left for the stack. The USB
+ 	 descriptors and camera mode table are constant and the heap is not
+ 	 used so nothing else needs this RAM. A larger buffer allows the host
+ 	 to be busy for longer before data from the camera is dropped.
+ 	 The heap starts at the end of static data too, so malloc, calloc and
+ 	 realloc must not be used while this is defined. They are poisoned in
+ 	 camera.c.
+ 	 When undefined the camera buffer is a static array of
+ 	 CAMERA_BUFFER_LENGTH bytes.
+ */
+#define CAMERA_BUFFER_FREE_RAM
+
+/**
+ @brief Bytes of RAM kept for the stack below the frame of camera_init().
+ @details Interrupt handlers run on the same stack as the main loop.
+ 	 Interrupts do not nest. The deepest main loop call chain from main()
+ 	 needs about 700 bytes and the deepest interrupt chain, a UVC commit
+ 	 handled from the USB interrupt, about 800 bytes plus the registers
+ 	 saved on entry. That is a peak near 1.6 kB from -fstack-usage call
+ 	 graphs. This leaves more than twice that for SDK functions which were
+ 	 not counted. The stack is painted by camera_init() and the part of
+ 	 the reserve never used is printed at boot and each time streaming
+ 	 stops. Check that with every format streaming before making this
+ 	 smaller.
+ */
+#define CAMERA_STACK_RESERVE (4 * 1024)
 
 /**
  @brief Number of lines of image data to buffer.
  @details This has to create a buffer large enough to buffer JPEG
  	 encoded and uncompressed data before it is transmitted.
  	 16kB is sufficient for reliability up to SVGA on a typical busy
- 	 network.
+ 	 network. Used when CAMERA_BUFFER_FREE_RAM is not defined.
  */
 #define CAMERA_BUFFER_LENGTH (32 * 1024)
 
+/**
+ @brief Longest line of data from the camera module.
+ @details A line from the camera module is read into a line buffer of
+ 	 this size when the image is scaled down.
+ */
+#define CAMERA_LINE_BUFFER_LENGTH (CAMERA_FRAME_WIDTH_VGA * 2)
+
+/**
+ @brief Camera capture statistics.
+ @details Counters of data lost between the camera module and camera_read.
+ 	 These are reset each time the camera is started.
+ */
+typedef struct CAMERA_stats {
+	/// Lines from the camera module discarded because the buffer was full.
+	uint32_t lines_dropped;
+	/// Frames which had one or more lines discarded.
+	uint32_t frames_dropped;
+	/// Camera FIFO flushes while waiting to synchronise with a frame.
+	uint32_t fifo_flushes;
+	/// Most bytes found in the camera FIFO on entry to the camera ISR.
+	/// The excess over the line length shows the worst-case interrupt
+	/// latency in bytes received from the camera.
+	uint32_t fifo_peak;
+} CAMERA_stats;
+
+/**
+ @brief Camera mode.
+ @details An entry in the constant table made from CAMERA_MODES_*. The line
+ 	 length is worked out at compile time and is the number of bytes in
+ 	 each line of the window read from the camera buffer.
+ */
+typedef struct CAMERA_mode {
+	uint16_t width;
+	uint16_t height;
+	uint16_t x;
+	uint16_t y;
+	uint16_t image_width;
+	uint16_t image_height;
+	uint16_t line;
+	uint8_t frame_rate;
+	uint8_t format;
+} CAMERA_mode;
+
 typedef void (*CAMERA_start_stop)(void);
 typedef int8_t (*CAMERA_supports)(uint16_t width, uint16_t height, int8_t frame_rate, int8_t format);
 typedef int8_t (*CAMERA_set)(uint16_t width, uint16_t height, int8_t format,
 		int8_t *frame_rate, uint16_t *sample, uint32_t *frame);
+/** Write up-to length bytes from the port to the USB endpoint without
+ waiting. Returns the number of bytes written. **/
+typedef uint16_t (*CAMERA_passthrough)(volatile uint32_t *port, uint16_t length);
 
 /**
  @brief Camera Initialisation
@@ -109,11 +294,34 @@ typedef int8_t (*CAMERA_set)(uint16_t width, uint16_t height, int8_t format,
 uint16_t camera_init(void);
 
 /**
- @brief Camera Add
- @details Adds camera mode support for a resolution, frame
- 	 rate and output format.
+ @brief Camera Buffer Location
+ @details Returns the start of the camera buffer and the number of bytes
+ 	 of RAM available to it. The buffer used while streaming is the
+ 	 largest whole number of lines which fits in this length.
+ */
+uint8_t *camera_get_buffer(uint32_t *length);
+
+/**
+ @brief Camera Stack Unused
+ @details Returns the number of bytes above the camera buffer which the
+ 	 stack has never reached since camera_init(). This is zero when
+ 	 CAMERA_BUFFER_FREE_RAM is not defined.
  */
-void camera_mode_add(uint16_t width, uint16_t height, int8_t frame_rate, int8_t format);
+uint32_t camera_get_stack_unused(void);
+
+/**
+ @brief Camera Mode Table Count
+ @details Returns the number of entries in the camera mode table.
+ */
+uint8_t camera_mode_table_count(void);
+
+/**
+ @brief Camera Mode Table Get
+ @details Returns an entry in the camera mode table or NULL if mode is
+ 	 past the end of the table. The table holds the uncompressed, luma
+ 	 and then MJPEG modes each in frame index order.
+ */
+const CAMERA_mode *camera_mode_table_get(uint8_t mode);
 
 /**
  @brief Camera Mode Count
@@ -126,15 +334,49 @@ uint8_t camera_mode_get_frame_count(int8_t format);
  @details Returns parameters for a particular camera mode and output format.
  */
 uint8_t camera_mode_get_frame(int8_t format, int8_t count, uint16_t *width, uint16_t *height);
+
+/**
+ @brief Camera Mode Get Window
+ @details Returns the image size and window offset for a particular camera
+ 	 mode and output format. For modes without a window the image size is
+ 	 the frame size and the offset is zero.
+ */
+uint8_t camera_mode_get_window(int8_t format, int8_t count,
+		uint16_t *image_width, uint16_t *image_height, uint16_t *x, uint16_t *y);
 uint8_t camera_mode_get_frame_rate_count(int8_t format, int8_t count);
 uint8_t camera_mode_get_frame_rate(int8_t format, int8_t count, int8_t frame_rate);
 
+/**
+ @brief Camera Mode Get Frame Decimation
+ @details Returns the decimation factor for a frame rate of a particular
+ 	 camera mode and output format. One frame in this many from the camera
+ 	 module is kept.
+ */
+uint8_t camera_mode_get_frame_decimation(int8_t format, int8_t count, int8_t frame_rate);
+
+/**
+ @brief Camera Mode Get Frame Interval
+ @details Returns the frame interval in 100 ns units for a frame rate of a
+ 	 particular camera mode and output format. This includes decimation.
+ */
+uint32_t camera_mode_get_frame_interval(int8_t format, int8_t count, int8_t frame_rate);
+
 /**
  @brief Camera Mode Get Sample Size
  @details Returns maximum sample size for that is a factor of the frame size.
+ 	 The sample size is a multiple of 4 bytes and no larger than max_sample.
+ 	 If max_sample is zero then the line size is returned.
  */
 uint16_t camera_mode_get_sample_size(int8_t format, int8_t count, uint16_t max_sample);
 
+/**
+ @brief Camera Set Decimation
+ @details Keep one frame in every decimation frames from the camera
+ 	 module. The others are flushed from the camera FIFO. Set after
+ 	 camera_set and before camera_start.
+ */
+void camera_set_decimation(uint8_t decimation);
+
 /**
  @brief Camera Start
  @details Starts streaming data from the Camera.
@@ -147,9 +389,19 @@ void camera_start();
  */
 void camera_stop(void);
 
+/**
+ @brief Camera Restart
+ @details Restarts streaming from a running Camera with the same settings.
+ 	 The camera interface and module are not set up again. Buffered data
+ 	 is discarded and streaming resumes at the next VSYNC edge.
+ */
+void camera_restart(void);
+
 /**
  @brief Camera Read
  @details Read a sample line of data from the camera buffer.
+ 	 The data remains valid until the next call to camera_read.
+ 	 This may be called with the camera interrupt enabled.
  @returns Pointer to the start of a camera buffer data line.
  */
 uint8_t *camera_read(void);
@@ -168,6 +420,14 @@ int8_t camera_supports(uint16_t width, uint16_t height, int8_t frame_rate, int8_
  */
 int8_t camera_set(uint16_t width, uint16_t height, int8_t frame_rate, int8_t format, uint16_t max_sample);
 
+/**
+ @brief Camera Set Window
+ @details Store and transmit only a window of the image set by camera_set.
+ 	 Must be called after camera_set and before camera_start.
+ @returns Zero if the window is valid for the image.
+ */
+int8_t camera_set_window(uint16_t x, uint16_t y, uint16_t width, uint16_t height);
+
 /**
  @brief      CAMERA state change
  @details    Will flag that there is a state change to the camera.
@@ -215,12 +475,83 @@ uint32_t camera_get_frame_size();
  @details    Gets the sampling parameters of the current frame.
  **/
 uint16_t camera_get_sample();
+
+/**
+ @brief      CAMERA read length
+ @details    Gets the length of the data last returned by camera_read. This
+ 	 	 	 is the sample length unless the start of a line has been
+ 	 	 	 passed straight to the USB endpoint.
+ **/
+uint16_t camera_get_read_length(void);
+
+/**
+ @brief      CAMERA buffer wrap count
+ @details    Gets the number of times the read position has wrapped around
+ 	 	 	 the camera buffer since the camera was started.
+ **/
+uint32_t camera_get_wrap_count();
+
+/**
+ @brief      CAMERA capture statistics
+ @details    Copies the capture statistics for the current stream.
+ @param[out] stats Structure to receive the counters.
+ **/
+void camera_get_stats(CAMERA_stats *stats);
+
+/**
+ @brief      CAMERA frame aborted
+ @details    Returns non-zero once after camera_read has returned all the
+ 	 	 	 stored data for a frame that was aborted by a buffer overrun.
+ 	 	 	 The next data from camera_read will be the start of a new frame.
+ **/
+uint8_t camera_frame_aborted(void);
+
+/**
+ @brief      CAMERA VSYNC interrupt
+ @details    Must be called from the VSYNC interrupt handler on each
+ 	 	 	 VSYNC edge. Moves a started camera from CAMERA_STREAMING_SYNC
+ 	 	 	 to CAMERA_STREAMING_STARTED and resumes capture after an
+ 	 	 	 aborted frame.
+ @param[in]  timestamp Time of the VSYNC edge. This is returned by
+ 	 	 	 camera_get_timestamp for data from the frame that follows.
+ **/
+void camera_vsync_isr(uint32_t timestamp);
+
+/**
+ @brief      CAMERA frame timestamp
+ @details    Returns the timestamp passed to camera_vsync_isr at the start
+ 	 	 	 of the frame containing the data last returned by camera_read.
+ **/
+uint32_t camera_get_timestamp(void);
+
+#ifdef CAMERA_PASSTHROUGH
+/**
+ @brief      CAMERA passthrough start
+ @details    Lets cam_ISR write the following lines of the current frame
+ 	 	 	 through fn instead of storing them. Must only be called when
+ 	 	 	 camera_read has returned NULL. cam_ISR stops using fn when the
+ 	 	 	 endpoint is full, for the last line of the frame or for a line
+ 	 	 	 which needs to be processed. That line is then stored as usual.
+ @param[in]  fn Function to write data from the camera FIFO to the endpoint.
+ **/
+void camera_passthrough_start(CAMERA_passthrough fn);
+
+/**
+ @brief      CAMERA passthrough active
+ @details    Returns non-zero while cam_ISR may call the passthrough
+ 	 	 	 function. The caller must not use the endpoint until this
+ 	 	 	 returns zero.
+ **/
+uint8_t camera_passthrough_active(void);
+
 /**
- @brief      CAMERA VSYNC detected
- @details    Tells the camera interface code that VSYNC event has been
- 	 	 	 detected.
+ @brief      CAMERA passthrough stop
+ @details    Stops cam_ISR from using the passthrough function.
+ @returns    Number of bytes written through the passthrough function since
+ 	 	 	 camera_passthrough_start.
  **/
-void camera_vsync(volatile uint8_t *signal);
+uint32_t camera_passthrough_stop(void);
+#endif // CAMERA_PASSTHROUGH
 
 #include "epuck_camera.h"
 
@@ -7,6 +7,12 @@
  */
 #define EPUCK_BBP (16 >> 3)
 
+/**
+ @brief Format Bytes Per Pixel definition for luma only output.
+ @details Only the Y byte of each pixel is kept.
+ */
+#define EPUCK_LUMA_BBP (8 >> 3)
+
 uint16_t epuck_init(void);
 void epuck_start(void);
 void epuck_stop(void);
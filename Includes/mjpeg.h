@@ -0,0 +1,135 @@
+/**
+ @file mjpeg.h
+ */
+/*
+ * ============================================================================
+ * History
+ * =======
+ * 2026-10-17 : Created
+ *
+ * (C) Copyright Bridgetek Pte Ltd
+ * ============================================================================
+ *
+ * This source code ("the Software") is provided by Bridgetek Pte Ltd
+ * ("Bridgetek") subject to the licence terms set out
+ * http://www.ftdichip.com/FTSourceCodeLicenceTerms.htm ("the Licence Terms").
+ * You must read the Licence Terms before downloading or using the Software.
+ * By installing or using the Software you agree to the Licence Terms. If you
+ * do not agree to the Licence Terms then do not download or use the Software.
+ *
+ * Without prejudice to the Licence Terms, here is a summary of some of the key
+ * terms of the Licence Terms (and in the event of any conflict between this
+ * summary and the Licence Terms then the text of the Licence Terms will
+ * prevail).
+ *
+ * The Software is provided "as is".
+ * There are no warranties (or similar) in relation to the quality of the
+ * Software. You use it at your own risk.
+ * The Software should not be used in, or for, any medical device, system or
+ * appliance. There are exclusions of Bridgetek liability for certain types of loss
+ * such as: special loss or damage; incidental loss or damage; indirect or
+ * consequential loss or damage; loss of income; loss of business; loss of
+ * profits; loss of revenue; loss of contracts; business interruption; loss of
+ * the use of money or anticipated savings; loss of information; loss of
+ * opportunity; loss of goodwill or reputation; and/or loss of, damage to or
+ * corruption of data.
+ * There is a monetary cap on Bridgetek's liability.
+ * The Software may have subsequently been amended by another user and then
+ * distributed by that other user ("Adapted Software").  If so that user may
+ * have additional licence terms that apply to those amendments. However, Bridgetek
+ * has no liability in relation to those amendments.
+ * ============================================================================
+ */
+
+#ifndef SOURCES_MJPEG_H_
+#define SOURCES_MJPEG_H_
+
+/* CONFIGURATION *******************************************************************/
+
+/**
+ @brief JPEG quality for MJPEG streams.
+ @details Quality from 1 to 100 on the same scale as the IJG libjpeg
+ 	 library. The standard quantisation tables from Annex K of the JPEG
+ 	 specification are scaled by this value. Higher values give larger
+ 	 frames and take longer to encode.
+ */
+#define MJPEG_QUALITY 75
+
+/* CONSTANTS ***********************************************************************/
+
+/**
+ @name    MJPEG encoder limits
+ @details The encoder works on a band of MJPEG_BAND_LINES lines of YUYV
+ 	 data at a time. This is the height of a 4:2:2 MCU. The widest
+ 	 image which can be encoded is QVGA. The JPEG data for each band is
+ 	 written to an output buffer of MJPEG_OUTPUT_LENGTH bytes which must
+ 	 be sent before the next band is encoded.
+ */
+//@{
+#define MJPEG_BAND_LINES 8
+#define MJPEG_MAX_WIDTH 320
+#define MJPEG_OUTPUT_LENGTH (8 * 1024)
+//@}
+
+/* TYPES ***************************************************************************/
+
+/* GLOBAL VARIABLES ****************************************************************/
+
+/* MACROS **************************************************************************/
+
+/* FUNCTIONS ***********************************************************************/
+
+/**
+ @brief      MJPEG start
+ @details    Set up the encoder for frames of the given size. The width
+ 	 	 	 must be a multiple of 16 and no more than MJPEG_MAX_WIDTH.
+ 	 	 	 The height must be a multiple of MJPEG_BAND_LINES.
+ @param[in]  width Width of the image in pixels.
+ @param[in]  height Height of the image in lines.
+ @param[in]  quality JPEG quality from 1 to 100.
+ @returns    Zero on success or -1 if the frame size is not supported.
+ **/
+int8_t mjpeg_start(uint16_t width, uint16_t height, uint8_t quality);
+
+/**
+ @brief      MJPEG encode line
+ @details    Add a line of YUYV data to the current band. When the band
+ 	 	 	 is complete it is encoded to the output buffer. The first band
+ 	 	 	 of a frame is preceded by the JPEG headers and the last band is
+ 	 	 	 followed by the end of image marker.
+ @param[in]  line A line of YUYV data, width * 2 bytes long and aligned
+ 	 	 	 to 4 bytes.
+ @returns    Number of bytes of JPEG data in the output buffer. Zero if
+ 	 	 	 the band is not yet complete.
+ **/
+uint16_t mjpeg_encode_line(const uint8_t *line);
+
+/**
+ @brief      MJPEG get output
+ @details    Returns the output buffer. This is valid until the next call
+ 	 	 	 to mjpeg_encode_line.
+ **/
+uint8_t *mjpeg_get_output(void);
+
+/**
+ @brief      MJPEG frame end
+ @details    Returns non-zero if the data in the output buffer ends the
+ 	 	 	 frame.
+ **/
+uint8_t mjpeg_frame_end(void);
+
+/**
+ @brief      MJPEG frame error
+ @details    Returns non-zero if any band in the current frame did not
+ 	 	 	 fit in the output buffer. The frame will not decode correctly.
+ **/
+uint8_t mjpeg_frame_error(void);
+
+/**
+ @brief      MJPEG abort
+ @details    Discard the current frame. The next line passed to
+ 	 	 	 mjpeg_encode_line is the first line of a new frame.
+ **/
+void mjpeg_abort(void);
+
+#endif /* SOURCES_MJPEG_H_ */
@@ -0,0 +1,87 @@
+/**
+ @file usbd_stream.h
+ */
+
+#ifndef INCLUDES_USBD_STREAM_H_
+#define INCLUDES_USBD_STREAM_H_
+
+/* CONFIGURATION *******************************************************************/
+
+/* CONSTANTS ***********************************************************************/
+
+/* TYPES ***************************************************************************/
+
+/**
+ @brief Data fragment for USBD_stream_in
+ @details One entry in a gather list. The fragments are written to the
+ 	 endpoint back to back as a single stream of bytes.
+ */
+typedef struct USBD_stream_fragment {
+	/// Data to write.
+	const uint8_t *data;
+	/// Number of bytes to write. May be zero.
+	size_t length;
+} USBD_stream_fragment;
+
+/**
+ @brief How USBD_stream_in ends a call
+ */
+typedef enum {
+	/// Leave a partly filled packet for the next call.
+	USBD_STREAM_IN_PART,
+	/// Send a partly filled packet as a short packet.
+	USBD_STREAM_IN_END,
+	/// As USBD_STREAM_IN_END but send a zero length packet if the data
+	/// ended on a packet boundary.
+	USBD_STREAM_IN_END_ZLP,
+} USBD_STREAM_IN_MODE;
+
+/* GLOBAL VARIABLES ****************************************************************/
+
+/* MACROS **************************************************************************/
+
+/* FUNCTIONS ***********************************************************************/
+
+/**
+ @brief      Stream data from a port to an IN endpoint
+ @details    Moves data from a peripheral FIFO register into the endpoint
+ 	 	 	 FIFO without passing it through RAM. Only packet buffers which
+ 	 	 	 are free are filled and the function never waits for the host.
+ 	 	 	 Each full packet is sent. A partly filled packet is left for
+ 	 	 	 the next call or for USBD_transfer_ex to complete.
+ @param[in]  ep_number USB endpoint number.
+ @param[in]  port Peripheral data register to read longwords from.
+ @param[in]  length Maximum number of bytes to move. Must be a multiple
+ 	 	 	 of 4 bytes.
+ @param[in]  offset Offset of the data in the current packet. Must be a
+ 	 	 	 multiple of 4 bytes.
+ @returns    Number of bytes moved into the endpoint FIFO, or a negative
+ 	 	 	 error code if the endpoint is not valid or the length or
+ 	 	 	 offset is not a multiple of 4 bytes.
+ **/
+int32_t USBD_stream_from_port(USBD_ENDPOINT_NUMBER ep_number,
+		volatile uint32_t *port, size_t length, size_t offset);
+
+/**
+ @brief      Stream a gather list to an IN endpoint
+ @details    Writes data for a video data endpoint. The fragments are
+ 	 	 	 written to the endpoint FIFO back to back and each packet is
+ 	 	 	 sent as soon as it is full.
+ 	 	 	 The endpoint must be a bulk or isochronous IN endpoint
+ 	 	 	 which is only written from one context. The call waits for a free packet buffer before
+ 	 	 	 starting each packet.
+ @param[in]  ep_number USB endpoint number.
+ @param[in]  fragments Gather list of data to write.
+ @param[in]  count Number of entries in the gather list.
+ @param[in,out] offset Offset of the data in the current packet. Must be
+ 	 	 	 less than the maximum packet size. Updated with the offset
+ 	 	 	 after the data written.
+ @param[in]  end What to do with the last packet.
+ @returns    Number of bytes written to the endpoint FIFO or a USBD_ERR_*
+ 	 	 	 code if the endpoint is not valid or not configured.
+ **/
+int32_t USBD_stream_in(USBD_ENDPOINT_NUMBER ep_number,
+		const USBD_stream_fragment *fragments, uint8_t count,
+		size_t *offset, USBD_STREAM_IN_MODE end);
+
+#endif /* INCLUDES_USBD_STREAM_H_ */
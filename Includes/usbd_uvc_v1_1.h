@@ -64,6 +64,27 @@
  */
 #undef USB_ENDPOINT_USE_ISOC
 
+/**
+ @brief Send a whole frame as a single bulk payload.
+ @details When defined and the data endpoint is a bulk type, each
+  uncompressed frame is sent to the host as one UVC payload with a single header. The
+  dwMaxPayloadTransferSize negotiated with the host is the size of a
+  frame plus the header. The header is sent at the start of the frame
+  with the EOF bit set as it is the only payload in the frame.
+  When undefined a payload, and hence a header, is sent for each line
+  of uncompressed data or each band of MJPEG data. This needs many more
+  short packets per frame and so more interrupts on the host.
+  If a frame is aborted part way through then the payload is ended
+  early with a short packet. The header has already been sent so the
+  ERR bit cannot be set. The host will see that the frame is too small
+  and discard it. Hosts such as uvcvideo do not check the size of
+  MJPEG frames so MJPEG is always sent with a payload for each band.
+  An aborted MJPEG frame is then ended with a payload that has only a
+  header with the ERR bit set.
+  This has no effect with isochronous endpoints.
+ */
+#define USB_BULK_PAYLOAD_FRAME
+
 /**
  @brief Include a DFU Interface in the configuration.
  @details This adds an interface to the USB configuration descriptor
@@ -206,6 +227,17 @@
 #define WCID_VENDOR_REQUEST_CODE	 0xF1
 //@}
 
+/**
+ @name STATS_VENDOR_REQUEST_CODE for capture statistics.
+ @brief Vendor request code to read the camera capture statistics.
+ @details A device-to-host request with this code returns a CAMERA_stats
+  structure in little-endian byte order. The counters are reset when
+  streaming starts.
+ */
+//@{
+#define STATS_VENDOR_REQUEST_CODE	 0xF2
+//@}
+
 /**
  @brief Endpoint definitions for UVC device.
  */
@@ -223,10 +255,50 @@
 #define UVC_DATA_USBD_EP_SIZE_HS 		USBD_EP_SIZE_512
 #endif // USB_ENDPOINT_USE_ISOC
 /// Endpoint for Full Speed mode
-#define UVC_DATA_EP_SIZE_FS				0x200
-#define UVC_DATA_USBD_EP_SIZE_FS 		USBD_EP_SIZE_512
+#ifdef USB_ENDPOINT_USE_ISOC
+#define UVC_DATA_EP_SIZE_FS				0x3FF
+#define UVC_DATA_USBD_EP_SIZE_FS 		USBD_EP_SIZE_1023
+#else // !USB_ENDPOINT_USE_ISOC
+#define UVC_DATA_EP_SIZE_FS				0x40
+#define UVC_DATA_USBD_EP_SIZE_FS 		USBD_EP_SIZE_64
+#endif // USB_ENDPOINT_USE_ISOC
 //@}
 
+/**
+ @brief Full Speed bulk bandwidth.
+ @details The most bytes a bulk endpoint can send in each 1 ms frame at
+  Full Speed. This is 19 packets of 64 bytes when no other device is
+  using the bus.
+ */
+#define UVC_BULK_FRAME_BYTES_FS			(19 * 64)
+
+#ifdef USB_ENDPOINT_USE_ISOC
+/**
+ @brief Isochronous alternate settings for High Speed mode.
+ @details The wMaxPacketSize of the endpoint in each non-zero alternate
+  setting of the video streaming interface. The host chooses the smallest
+  alternate setting which can carry the dwMaxPayloadTransferSize agreed
+  by probe and commit. Small frame modes then reserve less bandwidth on
+  the bus so that more devices can stream through the same hub.
+  Each entry is X(alternate setting, wMaxPacketSize). Alternate settings
+  are numbered from 1 to UVC_ISOC_ALT_COUNT and the sizes must increase.
+  The last size must be UVC_DATA_EP_SIZE_HS.
+  UVC_ISOC_ALT_SIZES_FS are the same for Full Speed mode where one
+  packet is sent in each 1 ms frame. It has UVC_ISOC_ALT_COUNT entries and
+  the last size must be UVC_DATA_EP_SIZE_FS.
+  Uncompressed samples must divide a line, so a VGA YUYV packet carries
+  at most 640 bytes. That is too little for 7.5 fps with the 25% headroom
+  and VGA YUYV streams at 5 fps over an isochronous endpoint.
+ */
+//@{
+#define UVC_ISOC_ALT_SIZES(X) \
+	X(1, 128) X(2, 256) X(3, 512) X(4, 768) X(5, UVC_DATA_EP_SIZE_HS)
+#define UVC_ISOC_ALT_SIZES_FS(X) \
+	X(1, 128) X(2, 256) X(3, 512) X(4, 768) X(5, UVC_DATA_EP_SIZE_FS)
+#define UVC_ISOC_ALT_COUNT				5
+//@}
+#endif // USB_ENDPOINT_USE_ISOC
+
 /** @brief Uncompressed payload format definition
  * @details The uncompressed payload formats for UVC devices allow
  * NV12 or YUY2. These are selected using the following GUIDs:
@@ -239,6 +311,18 @@
  */
 #define PAYLOAD_BBP_UNCOMPRESSED 0x10 /* format.bBitsPerPixel */
 
+/** @brief Luma only payload format definition
+ * @details A second uncompressed format with only the Y component of the
+ * image. This uses the Y800 GUID which is reported by Linux as GREY.
+ */
+#define PAYLOAD_FORMAT_LUMA {'Y', '8', '0', '0', 0x00, 0x00, 0x10, 0x00, \
+		0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71} /* format.guidFormat[16] */
+
+/** @brief Luma only payload pixel size
+ * @details Luma only payload images are 8 bits per pixel.
+ */
+#define PAYLOAD_BBP_LUMA 0x08 /* format.bBitsPerPixel */
+
 /** @brief Compressed payload pixel size
  * @details Uncompressed payload images can be 16 or 24 bits per pixel.
  */
@@ -248,12 +332,47 @@
  * @details The UVC payload can have a variable length header. This must
  * include 2 bytes described in the structure USB_UVC_Payload_Header but
  * can also include the presentation time and/or the source clock.
- * The payload header is defined as USB_UVC_Payload_Header but as a lot of
- * calculations on buffer and transfer sizes are made in the preprocessor
- * the define must be an integer constant rather than a sizeof which is
- * filled in by the compiler - not the preprocessor.
+ * This firmware always sends both as described in the structure
+ * USB_UVC_Payload_Header_PTS_SCR.
+ * The payload header length is used in a lot of calculations on buffer
+ * and transfer sizes which are made in the preprocessor so the define
+ * must be an integer constant rather than a sizeof which is filled in
+ * by the compiler - not the preprocessor.
+ * It must be a multiple of 4 bytes so that image data following the
+ * header in a packet is on a longword boundary in the endpoint FIFO.
+ * The USB driver can then use longword stream writes for the data.
+ */
+#define PAYLOAD_HEADER_LENGTH 12
+
+#if (PAYLOAD_HEADER_LENGTH & 3)
+#error "PAYLOAD_HEADER_LENGTH must be a multiple of 4 bytes"
+#endif
+
+/** @brief UVC Payload Header with Presentation Time and Source Clock.
+ * @details The presentation time (PTS) is the source clock when the
+ * VSYNC edge starting the frame was seen. It is the same in every payload
+ * of a frame. The source clock reference (SCR) is the source clock and
+ * the USB SOF frame number when the payload header was written.
+ */
+typedef struct PACK USB_UVC_Payload_Header_PTS_SCR
+{
+	uint8_t bHeaderLength;
+	uint8_t bmHeaderInfo;
+	uint32_t dwPresentationTime;
+	uint32_t dwSourceClock;
+	uint16_t wSofCounter;
+} USB_UVC_Payload_Header_PTS_SCR;
+
+/** @brief UVC Payload Header bmHeaderInfo bits.
  */
-#define PAYLOAD_HEADER_LENGTH 2
+//@{
+#define PAYLOAD_HEADER_INFO_FID 0x01
+#define PAYLOAD_HEADER_INFO_EOF 0x02
+#define PAYLOAD_HEADER_INFO_PTS 0x04
+#define PAYLOAD_HEADER_INFO_SCR 0x08
+#define PAYLOAD_HEADER_INFO_ERR 0x40
+#define PAYLOAD_HEADER_INFO_EOH 0x80
+//@}
 
 /**
  @brief Entity ID definitions for UVC device.
@@ -271,6 +390,12 @@
  */
 #define FORMAT_UC_BBP (PAYLOAD_BBP_UNCOMPRESSED >> 3)
 
+/**
+ @brief Format Bits Per Pixel definition for UVC device.
+ @details Derived from the image type for luma only format.
+ */
+#define FORMAT_LUMA_BBP (PAYLOAD_BBP_LUMA >> 3)
+
 /**
  @brief Format Bits Per Pixel definition for UVC device.
  @details Derived from the image type.
@@ -287,6 +412,7 @@ enum {
 	FORMAT_INDEX_TYPE_NONE = 0,
 	FORMAT_INDEX_TYPE_UNCOMPRESSED,
 	FORMAT_INDEX_TYPE_MJPEG,
+	FORMAT_INDEX_TYPE_LUMA,
 	FORMAT_INDEX_MAX,
 };
 //@}
@@ -324,9 +450,13 @@ enum {
 
 /**
  @brief Clock Frequency definitions for UVC device.
+ @details The source clock for PTS and SCR values in payload headers
+ 	 is derived from timer A which counts at 100 kHz.
  */
 //@{
 #define CLK_FREQ_48MHz 0x02dc6c00
+#define CLK_FREQ_100kHz 0x000186a0
+#define CLK_FREQ_SOURCE_CLOCK CLK_FREQ_100kHz
 //@}
 
 /**
@@ -337,22 +467,86 @@ enum {
  **/
 uint8_t usb_uvc_get_alt();
 
+/**
+ @brief      Get current packet size.
+ @details    Return the maximum packet size of the video data endpoint for
+ 	 	 	 the current alternate setting. Zero if the alternate setting
+ 	 	 	 has no bandwidth.
+ **/
+uint16_t usb_uvc_get_packet_size();
+
 /**
  @brief      Test whether UVC module has a valid format set with COMMIT.
  **/
 int8_t usb_uvc_has_commit();
 int8_t usb_uvc_is_uncompressed();
+int8_t usb_uvc_is_luma();
 int8_t usb_uvc_is_mjpeg();
 
+/**
+ @brief      Get the current USB frame number.
+ @details    Returns the 11-bit frame number from the last SOF packet for
+ 	 	 	 the SCR field of the payload header.
+ **/
+uint16_t usb_uvc_get_sof();
+
+/**
+ @brief      Video data endpoint event.
+ @details    Returns non-zero if the host has taken a packet from the video
+ 	 	 	 data endpoint since the last call. The endpoint interrupt
+ 	 	 	 records each packet sent so no event is missed between the
+ 	 	 	 endpoint being found full and this call.
+ **/
+uint8_t usb_uvc_data_ep_event();
+
+#ifdef USB_ENDPOINT_USE_ISOC
+/**
+ @brief      SOF event.
+ @details    Returns non-zero if an SOF has been received since the last
+ 	 	 	 call. The isochronous endpoint is refilled once for each
+ 	 	 	 (micro)frame.
+ **/
+uint8_t usb_uvc_sof_event();
+
+/**
+ @brief      Set data pending.
+ @details    Tell the SOF callback whether the main loop has data waiting
+ 	 	 	 to be sent on the video data endpoint. A (micro)frame in which
+ 	 	 	 the host takes no packet is only counted as missed when there
+ 	 	 	 was data to send.
+ @param[in]  pending Non-zero if there is data to send.
+ **/
+void usb_uvc_set_data_pending(uint8_t pending);
+
+/**
+ @brief      Get missed microframe count.
+ @details    Returns the number of (micro)frames since the alternate
+ 	 	 	 setting was selected in which there was data to send but no
+ 	 	 	 packet was sent on the video data endpoint.
+ **/
+uint32_t usb_uvc_get_missed_microframes();
+#endif // USB_ENDPOINT_USE_ISOC
+
 /**
  @brief      Test whether a frame size and frame rate can be transferred
  	 	 	 over USB.
+ @param[in]  speed Bus speed to test. USBD_SPEED_HIGH or USBD_SPEED_FULL.
+ **/
+int8_t usb_uvc_bandwidth_ok(USBD_DEVICE_SPEED speed, uint16_t width, uint16_t height,
+		uint8_t frame_rate, int8_t format);
+
+/**
+ @brief      Full Speed frame count
+ @details    Returns the number of frame indexes of a camera format which
+ 	 	 	 are offered at Full Speed. These are the first frame indexes
+ 	 	 	 of the format.
  **/
-int8_t usb_uvc_bandwidth_ok(uint16_t width, uint16_t height, uint8_t frame_rate);
+uint8_t usb_uvc_get_frame_count_fs(int8_t format);
 
 /**
  @brief      Set up the USB device configuration.
- @details    Setup the configuration descriptors, probe settings and strings.
+ @details    Setup the probe settings and the serial number string. The
+ 	 	 	 configuration descriptors are made at compile time.
  **/
 void usb_uvc_build_configuration(uint16_t module);
 
@@ -47,13 +47,17 @@
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
-#include <stdlib.h>
 
 #include <ft900.h>
 
 #include "camera.h"
 #include "tinyprintf.h"
 
+#ifdef CAMERA_BUFFER_FREE_RAM
+/* The camera buffer takes the RAM where the heap would be. */
+#pragma GCC poison malloc calloc realloc
+#endif // CAMERA_BUFFER_FREE_RAM
+
 #define CAMERA_DEBUG
 #ifdef CAMERA_DEBUG
 #define CAMERA_DEBUG_PRINTF(...) do {tfp_printf(__VA_ARGS__);} while (0)
@@ -69,7 +73,7 @@ static CAMERA_supports CAMERA_supports_fn;
 /** @brief Camera state change flag.
  * @details Signals bottom half that a commit has changed something about the camera image.
  */
-static uint8_t camera_state = CAMERA_STREAMING_OFF;
+static volatile uint8_t camera_state = CAMERA_STREAMING_OFF;
 
 /** @brief Current set image information.
  *  @details Updated by a commit and used to time frames.
@@ -85,6 +89,25 @@ static uint16_t frame_height = 0;
 static uint32_t frame_size = 0;
 /// @brief Total bytes in a line or sample received from the camera module.
 static uint16_t camera_sample_length = 0;
+/// @brief Total bytes in a line stored in the camera buffer.
+/// @details Smaller than camera_sample_length when the image is scaled down.
+static uint16_t camera_line_length = 0;
+/// @brief Ratio of camera module to stored image size (1, 2 or 4).
+/// @details Lines and pixel pairs are decimated by this factor.
+static uint8_t camera_scale = 1;
+/// @brief Log2 of camera_scale.
+static uint8_t camera_scale_shift = 0;
+/// @brief Bytes per pixel stored in the camera buffer.
+/// @details 2 for YUYV data and 1 when only the luma is kept.
+static uint8_t camera_bpp = 2;
+/// @brief Window of the scaled image which is stored.
+/// @details Offset of the window in bytes from the start of a scaled line
+/// and the first and last (exclusive) scaled lines in the window.
+//@{
+static uint16_t camera_window_offset = 0;
+static uint16_t camera_window_top = 0;
+static uint16_t camera_window_bottom = 0;
+//@}
 /// @brief Total bytes in a line or sample returned by camera_read function.
 static uint16_t read_sample_length = 0;
 /// @brief Number of bytes in a line from the camera module.
@@ -96,86 +119,471 @@ static uint16_t read_sample_length = 0;
 static int8_t camera_frame_rate = 0;
 
 /** @brief Camera format.
- * @details Must be CAMERA_FORMAT_UNCOMPRESSED.
+ * @details One of CAMERA_FORMAT_UNCOMPRESSED, CAMERA_FORMAT_LUMA or
+ * CAMERA_FORMAT_MJPEG.
  */
 static int8_t camera_format = 0;
 
-/** @brief Used to wait for vsync (VIDEO)
+/** @brief Frame decimation.
+ * @details Only one frame in camera_decimation is kept. cam_ISR sets
+ * camera_skip_count at the end of each kept frame. camera_vsync_isr counts
+ * it down at each following VSYNC edge and sets camera_skip_frame for the
+ * frames to skip. cam_ISR flushes the camera FIFO during those frames.
+ */
+//@{
+static uint8_t camera_decimation = 1;
+static volatile uint8_t camera_skip_count = 0;
+static volatile uint8_t camera_skip_frame = 0;
+//@}
+
+/** @brief Synchronised to the start of a frame.
+ * @details Set by camera_vsync_isr on the first VSYNC edge after the
+ * camera is started. Until then cam_ISR discards all data.
  */
 static volatile uint8_t vsync = 0;
 
 /** @brief Camera and VSYNC ISR.
  * @details Keep state of camera interface and communicate with
- * the bottom half.
+ * the bottom half. The camera_buffer is a single-producer/single-consumer
+ * ring: cam_ISR is the only writer of the write-side members and
+ * camera_read is the only writer of the read-side members. Neither side
+ * performs a read-modify-write on the other's state so the camera
+ * interrupt never needs to be masked to read from the ring.
  */
 //@{
-/// Count of number of lines available from camera.
-static uint32_t camera_rx_data_avail = 0;
+/// Total bytes written to the camera_buffer by cam_ISR (free running).
+static volatile uint32_t camera_wr_total = 0;
+/// Total bytes released from the camera_buffer by camera_read (free running).
+/// Read by cam_ISR to check for free space in the camera_buffer.
+static volatile uint32_t camera_rd_total = 0;
+/// Bytes in the sample last returned by camera_read not yet released.
+static uint16_t camera_rd_pending = 0;
+/// Length of the data last returned by camera_read.
+static uint16_t camera_rd_length = 0;
 /// Buffer line write location within the camera_buffer array.
-static uint16_t camera_wr_buffer = 0;
+static uint32_t camera_wr_buffer = 0;
 /// Buffer line read location within the camera_buffer array.
-static uint16_t camera_rd_buffer = 0;
+static uint32_t camera_rd_buffer = 0;
+/// Lines received from the camera module in the current frame.
+static uint16_t camera_frame_line = 0;
+/// Lines in a frame received from the camera module.
+static uint16_t camera_frame_lines = 0;
+/// Set when a line in the current frame has been discarded.
+static uint8_t camera_frame_overrun = 0;
+/// Capture statistics for the current stream.
+static volatile CAMERA_stats camera_stats;
+//@}
+
+/** @brief Frame timestamps.
+ * @details camera_vsync_isr queues the timestamp of each VSYNC edge with
+ * the position in the camera_buffer data where that frame starts. Another
+ * single-producer/single-consumer queue, read by camera_read.
+ */
+//@{
+/// Number of frame timestamps which can be queued (power of 2).
+#define CAMERA_TIMESTAMP_QUEUE_LENGTH 4
+/// Value of camera_wr_total at the start of each frame.
+static uint32_t camera_ts_pos[CAMERA_TIMESTAMP_QUEUE_LENGTH];
+/// Timestamp of the VSYNC edge for each frame.
+static uint32_t camera_ts_value[CAMERA_TIMESTAMP_QUEUE_LENGTH];
+/// Count of timestamps queued by camera_vsync_isr (free running).
+static volatile uint8_t camera_ts_wr = 0;
+/// Count of timestamps taken by camera_read (free running).
+static uint8_t camera_ts_rd = 0;
+/// Timestamp of the frame for the data last returned by camera_read.
+static uint32_t camera_timestamp = 0;
+//@}
+
+#ifdef CAMERA_OVERRUN_DROP_FRAME
+/** @brief Frame abort handling.
+ * @details When cam_ISR aborts a frame it stops storing lines until
+ * camera_vsync_isr is called on the next VSYNC edge. The position in the
+ * camera_buffer data where the aborted frame ends is put in a small
+ * single-producer/single-consumer queue for camera_read.
+ */
+//@{
+/// Number of aborted frame positions which can be queued (power of 2).
+#define CAMERA_ABORT_QUEUE_LENGTH 4
+/// Set by cam_ISR to discard data until the next VSYNC edge.
+static volatile uint8_t camera_resync = 0;
+/// Value of camera_wr_total at the end of each aborted frame.
+static uint32_t camera_abort_pos[CAMERA_ABORT_QUEUE_LENGTH];
+/// Count of aborted frames queued by cam_ISR (free running).
+static volatile uint8_t camera_abort_wr = 0;
+/// Count of aborted frames taken by camera_read (free running).
+static uint8_t camera_abort_rd = 0;
+/// Set by camera_read when the end of an aborted frame is reached.
+static uint8_t camera_abort_flag = 0;
 //@}
+#endif // CAMERA_OVERRUN_DROP_FRAME
+
+#ifdef CAMERA_PASSTHROUGH
+/** @brief Passthrough of lines to the USB endpoint.
+ * @details While camera_pass_fn is set cam_ISR writes lines through it
+ * instead of storing them in the camera_buffer. It is only set by the
+ * reader when the camera_buffer is empty so the order of the data is kept.
+ * cam_ISR clears it before it next stores a line. If the start of that
+ * line has been written to the endpoint then camera_pass_skip tells
+ * camera_read to return only the rest of the line.
+ */
+//@{
+/// Function to write to the endpoint. Set by the reader, cleared by cam_ISR.
+static volatile CAMERA_passthrough camera_pass_fn = NULL;
+/// Bytes written through camera_pass_fn since it was set.
+static volatile uint32_t camera_pass_total = 0;
+/// Bytes at the start of the next stored line already written to the endpoint.
+static volatile uint16_t camera_pass_skip = 0;
+//@}
+#endif // CAMERA_PASSTHROUGH
 
 /* @brief Camera Buffer
  * @details Circular buffer to receive data from the camera inteface.
  * "Lines" of data from the camera are written here and data is taken
  * from here by the camera interface code. This buffer is passed to
- * the camera interface code.
+ * the camera interface code. With CAMERA_BUFFER_FREE_RAM it is placed
+ * in free RAM by camera_init() instead.
  */
+#ifndef CAMERA_BUFFER_FREE_RAM
 static uint8_t camera_buffer[CAMERA_BUFFER_LENGTH]  __attribute__((aligned(4)));
+#else
+/// End of static data in RAM. Defined by the linker script.
+extern char _end[];
+
+/* @brief Camera Stack Paint
+ * @details The RAM between the camera buffer and the stack is filled
+ * with CAMERA_STACK_PAINT by camera_init(). Words which still hold it
+ * have never been used by the stack.
+ */
+//@{
+#define CAMERA_STACK_PAINT 0x5354434bUL
+static uint32_t *camera_stack_end = NULL;
+//@}
+#endif // CAMERA_BUFFER_FREE_RAM
+
+/* @brief Camera Line Buffer
+ * @details Receives a line from the camera module when it is not streamed
+ * directly into the camera_buffer. Used to scale lines down and to
+ * discard lines.
+ */
+static uint8_t camera_line_buffer[CAMERA_LINE_BUFFER_LENGTH]  __attribute__((aligned(4)));
 
 /** @brief Current set image information.
  *  @details Updated by a commit and used to time frames.
  */
 //@{
-/// @brief Total size of the frame received from the camera module.
-static uint8_t *camera_buffer_ptr = camera_buffer;
+/// @brief Start of the camera buffer.
+static uint8_t *camera_buffer_ptr = NULL;
+/// @brief Bytes of RAM available for the camera buffer.
+static uint32_t camera_buffer_length = 0;
 /// @brief Total size of camera buffer.
-static uint16_t camera_buffer_size = CAMERA_BUFFER_LENGTH;
+static uint32_t camera_buffer_size = 0;
+/// @brief Number of times camera_read has wrapped around camera_buffer.
+static uint32_t camera_wrap_count = 0;
 //@}
 
+/** @brief Scale a line of YUYV data down horizontally.
+ * @details Takes every camera_scale-th pair of pixels from the source line.
+ * Each 32-bit word holds one YUYV pixel pair (Y0 U Y1 V in memory). The
+ * output pair is the first luma and the chroma of one input pair and the
+ * first luma of the input pair half way to the next output pair.
+ * @param dst Destination in the camera_buffer, camera_line_length bytes.
+ * @param src First pixel pair to scale from a line from the camera module.
+ */
+static void cam_scale_line(uint32_t *dst, const uint32_t *src)
+{
+	uint16_t i;
+	uint8_t half = camera_scale >> 1;
+
+	for (i = camera_line_length / sizeof(uint32_t); i > 0; i--)
+	{
+		*dst++ = (src[0] & 0xff00ffff) | ((src[half] & 0xff) << 16);
+		src += camera_scale;
+	}
+}
+
+/** @brief Strip the chroma from a line of YUYV data.
+ * @details Takes the luma byte of every pixel to be stored. When scaling
+ * down the pixels chosen are the same as those chosen by cam_scale_line.
+ * Each output word holds four luma bytes.
+ * @param dst Destination in the camera_buffer, camera_line_length bytes.
+ * @param src First pixel pair to convert from a line from the camera module.
+ */
+static void cam_luma_line(uint32_t *dst, const uint32_t *src)
+{
+	uint16_t i;
+	uint8_t half = camera_scale >> 1;
+
+	if (half == 0)
+	{
+		for (i = camera_line_length / sizeof(uint32_t); i > 0; i--)
+		{
+			*dst++ = (src[0] & 0xff) | ((src[0] >> 8) & 0xff00) |
+					((src[1] & 0xff) << 16) | ((src[1] << 8) & 0xff000000);
+			src += 2;
+		}
+	}
+	else
+	{
+		for (i = camera_line_length / sizeof(uint32_t); i > 0; i--)
+		{
+			*dst++ = (src[0] & 0xff) | ((src[half] & 0xff) << 8) |
+					((src[half * 2] & 0xff) << 16) | ((src[half * 3] & 0xff) << 24);
+			src += half * 4;
+		}
+	}
+}
+
+/** @brief Read bytes from the camera FIFO into a buffer.
+ * @details The length must be a multiple of 4 bytes and the buffer
+ * aligned to 4 bytes. Host builds of the tests read the register a
+ * word at a time instead.
+ */
+static inline void cam_stream_in(void *dst, uint16_t length)
+{
+#ifdef __FT32__
+	asm volatile("streamin.l %0,%1,%2" \
+			: \
+			  :"r"(dst), "r"(&(CAM->CAM_REG3)), "r"(length) \
+			  :"memory");
+#else // !__FT32__
+	uint32_t *pdst = (uint32_t *)dst;
+
+	for (; length >= sizeof(uint32_t); length -= sizeof(uint32_t))
+	{
+		*pdst++ = CAM->CAM_REG3;
+	}
+#endif // __FT32__
+}
+
 void cam_ISR(void)
 {
 	static uint8_t *pbuffer;
 	static uint16_t len;
+	// Bytes of the line written straight to the USB endpoint.
+	uint16_t sent = 0;
+	// Bytes of the sample taken from the camera FIFO before it is stored.
+	uint16_t taken = 0;
+	// There is space in the camera_buffer for the line.
+	uint8_t space;
 
 	// Synchronise on the start of a frame.
 	// If we are waiting for the VSYNC signal then flush all data.
-	if (vsync != 0)
+	// Frames skipped for decimation are flushed.
+#ifdef CAMERA_OVERRUN_DROP_FRAME
+	if ((vsync != 0) && (camera_resync == 0) && (camera_skip_frame == 0))
+#else // !CAMERA_OVERRUN_DROP_FRAME
+	if ((vsync != 0) && (camera_skip_frame == 0))
+#endif // CAMERA_OVERRUN_DROP_FRAME
 	{
 		// Read in a line of data from the camera.
 		len = cam_available();
+		if (len > camera_stats.fifo_peak)
+		{
+			camera_stats.fifo_peak = len;
+		}
 		if (len >= camera_sample_length)
 		{
-			// Point to the current line in the camera_buffer.
-			pbuffer = &camera_buffer_ptr[camera_wr_buffer];
-
-			// Stream data from the camera to camera_buffer.
-			// This must be aligned to and be a multiple of 4 bytes.
-			asm("streamin.l %0,%1,%2" \
-					: \
-					  :"r"(pbuffer), "r"(&(CAM->CAM_REG3)), "r"(camera_sample_length));
-
-			// Increment the number of bytes available to read.
-			// This will signal data is ready to transmit.
-			camera_rx_data_avail += camera_sample_length;
-			camera_wr_buffer += camera_sample_length;
-			if (camera_wr_buffer >= camera_buffer_size)
+			// When scaling down only the first of every camera_scale lines
+			// is kept. Lines outside the window are not kept either. Lines
+			// not kept are read into the line buffer and ignored.
+			// All data must be taken from the camera FIFO a whole line at a
+			// time. A cam_flush() would also discard the start of the next
+			// line and lose alignment.
+			if ((camera_frame_line & (camera_scale - 1)) ||
+					((camera_frame_line >> camera_scale_shift) < camera_window_top) ||
+					((camera_frame_line >> camera_scale_shift) >= camera_window_bottom))
 			{
-				// Wrap around in camera_buffer.
-				camera_wr_buffer = 0;
+				cam_stream_in(camera_line_buffer, camera_sample_length);
+			}
+			else
+			{
+				// Check there is space in the camera_buffer for the line. The
+				// sample last returned by camera_read is not released until the
+				// next call so it will not be overwritten.
+				space = ((camera_buffer_size - (camera_wr_total - camera_rd_total)) >= camera_line_length);
+#ifdef CAMERA_PASSTHROUGH
+				// Processed lines are always stored.
+				if ((camera_scale != 1) || (camera_bpp != 2))
+				{
+					camera_pass_fn = NULL;
+				}
+				// A line written to the endpoint needs no space in the
+				// camera_buffer so this is tried first. The last line of the
+				// frame is always stored so that the reader can end the frame.
+				if (camera_pass_fn)
+				{
+					// Columns either side of the window go to the line buffer.
+					if (camera_window_offset)
+					{
+						cam_stream_in(camera_line_buffer, camera_window_offset);
+					}
+					if (camera_frame_line + 1 < camera_window_bottom)
+					{
+						sent = camera_pass_fn(&(CAM->CAM_REG3), camera_line_length);
+						camera_pass_total += sent;
+					}
+					taken = camera_window_offset + sent;
+					if (sent < camera_line_length)
+					{
+						// Store the rest of the line and hand the endpoint
+						// back to the reader. If there is no space for it the
+						// line is lost and the reader has nothing to skip.
+						camera_pass_skip = space ? sent : 0;
+						camera_pass_fn = NULL;
+					}
+				}
+#endif // CAMERA_PASSTHROUGH
+
+				if ((space) || (sent == camera_line_length))
+				{
+					// Point to the current line in the camera_buffer.
+					pbuffer = &camera_buffer_ptr[camera_wr_buffer];
+
+					// Stream data from the camera to camera_buffer.
+					// This must be aligned to and be a multiple of 4 bytes.
+					// The memory clobber stops the compiler moving the update of
+					// camera_wr_total before the data is in camera_buffer.
+					if ((camera_scale == 1) && (camera_bpp == 2))
+					{
+						// Columns either side of the window go to the line buffer.
+						if (camera_window_offset > taken)
+						{
+							cam_stream_in(camera_line_buffer, camera_window_offset);
+						}
+						if (sent < camera_line_length)
+						{
+							cam_stream_in(&pbuffer[sent], camera_line_length - sent);
+						}
+						if (camera_sample_length > camera_window_offset + camera_line_length)
+						{
+							cam_stream_in(camera_line_buffer,
+									camera_sample_length - camera_window_offset - camera_line_length);
+						}
+					}
+					else
+					{
+						cam_stream_in(camera_line_buffer, camera_sample_length);
+						if (camera_bpp == 2)
+						{
+							cam_scale_line((uint32_t *)pbuffer,
+									(const uint32_t *)&camera_line_buffer[camera_window_offset << camera_scale_shift]);
+						}
+						else
+						{
+							cam_luma_line((uint32_t *)pbuffer,
+									(const uint32_t *)&camera_line_buffer[camera_window_offset << camera_scale_shift]);
+						}
+					}
+
+					// Publish the line to camera_read. This is the only write to
+					// camera_wr_total so the reader sees either the old or the new
+					// total and never a partial update.
+					// This will signal data is ready to transmit.
+					// A line written to the endpoint is not stored.
+					if (sent < camera_line_length)
+					{
+						camera_wr_total += camera_line_length;
+						camera_wr_buffer += camera_line_length;
+						if (camera_wr_buffer >= camera_buffer_size)
+						{
+							// Wrap around in camera_buffer.
+							camera_wr_buffer = 0;
+						}
+					}
+				}
+				else
+				{
+					// Overrun. Discard the rest of the line from the camera FIFO
+					// so that following lines stay aligned.
+					cam_stream_in(camera_line_buffer, camera_sample_length - taken);
+					camera_stats.lines_dropped++;
+					camera_frame_overrun = 1;
+
+#ifdef CAMERA_OVERRUN_DROP_FRAME
+					// Abort the rest of the frame. If lines from this frame
+					// have been stored then tell camera_read where they end.
+					// The queue cannot realistically fill as it needs a whole
+					// aborted frame per entry within the camera_buffer.
+					camera_stats.frames_dropped++;
+					if ((camera_frame_line > (camera_window_top << camera_scale_shift)) &&
+							((uint8_t)(camera_abort_wr - camera_abort_rd) < CAMERA_ABORT_QUEUE_LENGTH))
+					{
+						camera_abort_pos[camera_abort_wr & (CAMERA_ABORT_QUEUE_LENGTH - 1)] = camera_wr_total;
+						camera_abort_wr++;
+					}
+					camera_frame_line = 0;
+					camera_frame_overrun = 0;
+					camera_resync = 1;
+					camera_skip_count = camera_decimation - 1;
+					return;
+#endif // CAMERA_OVERRUN_DROP_FRAME
+				}
+			}
+
+			// Count frames which have lost lines.
+			if (++camera_frame_line >= camera_frame_lines)
+			{
+				if (camera_frame_overrun)
+				{
+					camera_stats.frames_dropped++;
+				}
+				camera_frame_line = 0;
+				camera_frame_overrun = 0;
+				// Skip the following frames for decimation.
+				camera_skip_count = camera_decimation - 1;
+#ifdef CAMERA_OVERRUN_DROP_FRAME
+				// Realign with the start of the next frame.
+				camera_resync = 1;
+#endif // CAMERA_OVERRUN_DROP_FRAME
 			}
 		}
 	}
 	else
 	{
 		cam_flush();
+		if (((camera_state == CAMERA_STREAMING_SYNC) ||
+				(camera_state == CAMERA_STREAMING_STARTED)) &&
+				(camera_skip_frame == 0))
+		{
+			camera_stats.fifo_flushes++;
+		}
 	}
 }
 
 uint16_t camera_init(void)
 {
+#ifdef CAMERA_BUFFER_FREE_RAM
+	uint32_t ram_start;
+	uint32_t ram_end;
+	uint32_t *paint;
+
+	// Use the RAM from the end of static data up to the stack. This is
+	// called from main so the stack is close to its top here.
+	ram_start = ((uint32_t)_end + 3) & (~3UL);
+	ram_end = ((uint32_t)__builtin_frame_address(0) - CAMERA_STACK_RESERVE) & (~3UL);
+	if ((ram_end < ram_start) || (ram_end - ram_start < CAMERA_LINE_BUFFER_LENGTH))
+	{
+		CAMERA_DEBUG_PRINTF("Not enough RAM for camera buffer\r\n");
+		return 0;
+	}
+	camera_buffer_ptr = (uint8_t *)ram_start;
+	camera_buffer_length = ram_end - ram_start;
+
+	// Paint the stack from the end of the camera buffer up to just below
+	// this frame. Interrupts are not enabled yet and this loop calls no
+	// functions so none of it is in use.
+	camera_stack_end = (uint32_t *)ram_end;
+	for (paint = camera_stack_end;
+			(uint32_t)paint < (((uint32_t)&ram_start - 64) & (~3UL));
+			paint++)
+	{
+		*paint = CAMERA_STACK_PAINT;
+	}
+#else
+	camera_buffer_ptr = camera_buffer;
+	camera_buffer_length = CAMERA_BUFFER_LENGTH;
+#endif // CAMERA_BUFFER_FREE_RAM
+
 	CAMERA_DEBUG_PRINTF("Camera Test ");
 
 	epuck_init();
@@ -194,221 +602,281 @@ uint16_t camera_init(void)
 	return 1;
 }
 
-struct modes {
-	uint16_t width;
-	uint16_t height;
-	uint8_t frame_rate_count;
-	uint8_t frame_rates[16];
-	uint8_t format;
-	uint8_t index;
-	struct modes *next;
-};
-
-static struct modes *uvc_cam_modes;
-static uint8_t frame_idx_uncompressed = 0;
+uint8_t *camera_get_buffer(uint32_t *length)
+{
+	*length = camera_buffer_length;
+	return camera_buffer_ptr;
+}
 
-static void cam_modes_append(uint16_t width, uint16_t height, uint8_t frame_rate, uint8_t format)
+uint32_t camera_get_stack_unused(void)
 {
-	struct modes *new, *end;
+#ifdef CAMERA_BUFFER_FREE_RAM
+	const uint32_t *p = camera_stack_end;
 
-	/* Look for existing width/height/format matches.*/
-	end = uvc_cam_modes;
-	while (end)
+	if (p == NULL)
 	{
-		if ((width == end->width) && (height == end->height) && (format == end->format))
-		{
-			/* Add new frame rate to this entry. */
-			end->frame_rates[end->frame_rate_count] = frame_rate;
-			end->frame_rate_count++;
-			return;
-		}
-		end = end->next;
+		return 0;
 	}
+	while (*p == CAMERA_STACK_PAINT)
+	{
+		p++;
+	}
+	return (uint32_t)p - (uint32_t)camera_stack_end;
+#else
+	return 0;
+#endif // CAMERA_BUFFER_FREE_RAM
+}
+
+/** @brief Camera mode table.
+ *  @details Built from CAMERA_MODES_* at compile time as constant data.
+ *  The modes for each format follow each other in frame index order. The
+ *  line length of each mode is the sample size read from the camera buffer
+ *  when there is no limit on the sample size.
+ */
+//@{
+#define CAM_MODE_ENTRY(format, image_width, image_height, x, y, width, height, frame_rate) \
+	{(width), (height), (x), (y), (image_width), (image_height), \
+	(width) * (((format) == CAMERA_FORMAT_LUMA)?1:2), (frame_rate), (format)},
+#define CAM_MODE_UNCOMPRESSED(...) CAM_MODE_ENTRY(CAMERA_FORMAT_UNCOMPRESSED, __VA_ARGS__)
+#define CAM_MODE_LUMA(...) CAM_MODE_ENTRY(CAMERA_FORMAT_LUMA, __VA_ARGS__)
+#define CAM_MODE_MJPEG(...) CAM_MODE_ENTRY(CAMERA_FORMAT_MJPEG, __VA_ARGS__)
+
+static const CAMERA_mode cam_modes[] = {
+		CAMERA_MODES_UNCOMPRESSED(CAM_MODE_UNCOMPRESSED)
+		CAMERA_MODES_LUMA(CAM_MODE_LUMA)
+		CAMERA_MODES_MJPEG(CAM_MODE_MJPEG)
+};
 
-	uint8_t frame_index = 0;
-	if (format == CAMERA_FORMAT_UNCOMPRESSED)
+#define CAM_MODE_COUNT (sizeof(cam_modes) / sizeof(cam_modes[0]))
+//@}
+
+/** @brief Position and number of modes for each format in the mode table.
+ *  @details Indexed by format less one so that every lookup is a single
+ *  index into the mode table.
+ */
+//@{
+static const uint8_t cam_mode_first[CAMERA_FORMAT_COUNT] = {
+		0,
+		CAMERA_FRAME_COUNT_UNCOMPRESSED,
+		CAMERA_FRAME_COUNT_UNCOMPRESSED + CAMERA_FRAME_COUNT_LUMA,
+};
+static const uint8_t cam_mode_frames[CAMERA_FORMAT_COUNT] = {
+		CAMERA_FRAME_COUNT_UNCOMPRESSED,
+		CAMERA_FRAME_COUNT_LUMA,
+		CAMERA_FRAME_COUNT_MJPEG,
+};
+//@}
+
+#define CAM_DECIMATION_ENTRY(factor, arg) (factor),
+static const uint8_t cam_decimation[CAMERA_FRAME_DECIMATION_COUNT] = {
+		CAMERA_FRAME_DECIMATION(CAM_DECIMATION_ENTRY, 0)
+};
+
+/* Find the mode for a zero based frame number of a format. */
+static const CAMERA_mode *cam_mode_lookup(int8_t format, int8_t count)
+{
+	if ((format < CAMERA_FORMAT_UNCOMPRESSED) || (format > CAMERA_FORMAT_COUNT))
 	{
-		frame_index = ++frame_idx_uncompressed;
+		return NULL;
 	}
-	if (frame_index)
+	if ((count < 0) || (count >= cam_mode_frames[format - 1]))
 	{
-		/* Make a new width/height/format. */
-		new = malloc(sizeof(struct modes));
-		if (new)
-		{
-			memset(new, 0, sizeof(struct modes));
-			new->next = NULL;
-			new->width = width;
-			new->height = height;
-			new->frame_rate_count = 1;
-			new->frame_rates[0] = frame_rate;
-			new->format = format;
-			new->index = frame_index;
-
-			/* Append to the end of the list. */
-			if (uvc_cam_modes == NULL)
-			{
-				uvc_cam_modes = new;
-			}
-			else
-			{
-				end = uvc_cam_modes;
-				while (end->next)
-				{
-					end = end->next;
-				}
-				end->next = new;
-			}
-		}
+		return NULL;
 	}
+	return &cam_modes[cam_mode_first[format - 1] + count];
 }
 
-/*static void cam_modes_free()
+uint8_t camera_mode_table_count(void)
 {
-	struct modes *old, *end;
+	return CAM_MODE_COUNT;
+}
 
-	old = uvc_cam_modes;
-	while (old)
+const CAMERA_mode *camera_mode_table_get(uint8_t mode)
+{
+	if (mode >= CAM_MODE_COUNT)
 	{
-		end = old->next;
-		free(old);
-		old = end;
+		return NULL;
 	}
-
-	uvc_cam_modes = NULL;
-}*/
-
-void camera_mode_add(uint16_t width, uint16_t height, int8_t frame_rate, int8_t format)
-{
-	cam_modes_append(width, height, frame_rate, format);
+	return &cam_modes[mode];
 }
 
 uint8_t camera_mode_get_frame_count(int8_t format)
 {
-	struct modes *end;
-	uint8_t count = 0;
-
-	end = uvc_cam_modes;
-	while (end)
+	if ((format < CAMERA_FORMAT_UNCOMPRESSED) || (format > CAMERA_FORMAT_COUNT))
 	{
-		if (end->format == format)
-		{
-			count++;
-		}
-		end = end->next;
+		return 0;
 	}
-	return count;
+	return cam_mode_frames[format - 1];
 }
 
 uint8_t camera_mode_get_frame(int8_t format, int8_t count, uint16_t *width, uint16_t *height)
 {
-	struct modes *end;
+	const CAMERA_mode *mode = cam_mode_lookup(format, count);
 
-	end = uvc_cam_modes;
-	while (end)
+	if (mode == NULL)
 	{
-		if (end->format == format)
-		{
-			if (count == 0)
-			{
-				if (width) *width = end->width;
-				if (height) *height = end->height;
+		return 0;
+	}
+	if (width) *width = mode->width;
+	if (height) *height = mode->height;
 
-				return end->index;
-			}
-			count--;
-		}
-		end = end->next;
+	return count + 1;
+}
+
+uint8_t camera_mode_get_window(int8_t format, int8_t count,
+		uint16_t *image_width, uint16_t *image_height, uint16_t *x, uint16_t *y)
+{
+	const CAMERA_mode *mode = cam_mode_lookup(format, count);
+
+	if (mode == NULL)
+	{
+		return 0;
 	}
-	return 0;
+	if (image_width) *image_width = mode->image_width;
+	if (image_height) *image_height = mode->image_height;
+	if (x) *x = mode->x;
+	if (y) *y = mode->y;
+
+	return count + 1;
 }
 
 uint8_t camera_mode_get_frame_rate_count(int8_t format, int8_t count)
 {
-	struct modes *end;
-
-	end = uvc_cam_modes;
-	while (end)
+	if (cam_mode_lookup(format, count) == NULL)
 	{
-		if (end->format == format)
-		{
-			if (count == 0)
-			{
-				return end->frame_rate_count;
-			}
-			count--;
-		}
-		end = end->next;
+		return 0;
 	}
-	return 0;
+	// Each mode is offered at every decimation of its frame rate.
+	return CAMERA_FRAME_DECIMATION_COUNT;
 }
 
 uint8_t camera_mode_get_frame_rate(int8_t format, int8_t count, int8_t frame_rate)
 {
-	struct modes *end;
+	const CAMERA_mode *mode = cam_mode_lookup(format, count);
 
-	end = uvc_cam_modes;
-	while (end)
+	if ((mode == NULL) || (frame_rate < 0) || (frame_rate >= CAMERA_FRAME_DECIMATION_COUNT))
 	{
-		if (end->format == format)
-		{
-			if (count == 0)
-			{
-				return end->frame_rates[frame_rate];
-			}
-			count--;
-		}
-		end = end->next;
+		return 0;
 	}
-	return 0;
+	return mode->frame_rate;
+}
+
+uint8_t camera_mode_get_frame_decimation(int8_t format, int8_t count, int8_t frame_rate)
+{
+	if ((cam_mode_lookup(format, count) == NULL) ||
+			(frame_rate < 0) || (frame_rate >= CAMERA_FRAME_DECIMATION_COUNT))
+	{
+		return 0;
+	}
+	return cam_decimation[frame_rate];
+}
+
+uint32_t camera_mode_get_frame_interval(int8_t format, int8_t count, int8_t frame_rate)
+{
+	uint8_t rate = camera_mode_get_frame_rate(format, count, frame_rate);
+
+	if (rate == 0)
+	{
+		return 0;
+	}
+	return (10000000UL * camera_mode_get_frame_decimation(format, count, frame_rate)) / rate;
 }
 
 uint16_t camera_mode_get_sample_size(int8_t format, int8_t count, uint16_t max_sample)
 {
-	struct modes *end;
-	uint16_t sample;
-	uint16_t factor;
+	const CAMERA_mode *mode = cam_mode_lookup(format, count);
+	uint16_t parts;
+
+	if (mode == NULL)
+	{
+		return 0;
+	}
+
+	// Enforce a longword boundary.
+	max_sample = ((max_sample) & ~3);
 
-	end = uvc_cam_modes;
-	while (end)
+	if (((format == CAMERA_FORMAT_UNCOMPRESSED) || (format == CAMERA_FORMAT_LUMA))
+			&& (max_sample > 0))
 	{
-		if (end->format == format)
+		// For uncompressed images the sample size read from the
+		// camera buffer MUST be a factor of the total line size.
+		// It must also be a multiple of 4 bytes so that every
+		// sample starts on a longword boundary in the camera
+		// buffer. Find the largest such factor that fits by
+		// splitting the line into the fewest equal parts.
+		for (parts = (mode->line + max_sample - 1) / max_sample;
+				parts <= mode->line / 4; parts++)
 		{
-			if (count == 0)
+			if (((mode->line % parts) == 0) && (((mode->line / parts) & 3) == 0))
 			{
-				// Enforce a longword boundary.
-				max_sample = ((max_sample) & ~3);
-				factor = 1;
-
-				if (format == CAMERA_FORMAT_UNCOMPRESSED)
-				{
-					if (max_sample > 0)
-					{
-						// For uncompressed images the sample size read from the
-						// camera buffer MUST be a factor of the total line size.
-						do
-						{
-							sample = (end->width * 2) / factor;
-							if (factor * sample < max_sample)
-							{
-								return sample;
-							}
-							factor++;
-						} while (sample > 1);
-
-						return 1;
-					}
-					else
-					{
-						return end->width * 2;
-					}
-				}
+				return mode->line / parts;
 			}
-			count--;
 		}
-		end = end->next;
+
+		return 4;
 	}
-	return 0;
+
+	// Whole lines are read when there is no limit on the sample size.
+	// The MJPEG encoder also reads whole YUYV lines from the camera
+	// buffer. The USB payload size is set by the encoder and not by
+	// this sample size.
+	return mode->line;
+}
+
+static uint32_t cam_gcd(uint32_t a, uint32_t b)
+{
+	uint32_t t;
+
+	while (b)
+	{
+		t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+/**
+ @brief      CAMERA reset stream
+ @details    Empties the camera buffer and resets the frame tracking and
+ 	 	 	 statistics for a new stream. Streaming begins on the next
+ 	 	 	 VSYNC edge. Interrupts are masked so that neither cam_ISR nor
+ 	 	 	 camera_vsync_isr sees a partly reset stream.
+ **/
+static void camera_reset_stream(void)
+{
+	CRITICAL_SECTION_BEGIN
+	vsync = 0;
+	camera_rd_buffer = 0;
+	camera_wr_buffer = 0;
+	camera_rd_pending = 0;
+	camera_rd_length = 0;
+	camera_rd_total = 0;
+	camera_wr_total = 0;
+	camera_wrap_count = 0;
+	camera_frame_lines = frame_height * camera_scale;
+	camera_frame_line = 0;
+	camera_frame_overrun = 0;
+	camera_skip_count = 0;
+	camera_skip_frame = 0;
+	memset((void *)&camera_stats, 0, sizeof(camera_stats));
+	camera_ts_wr = 0;
+	camera_ts_rd = 0;
+	camera_timestamp = 0;
+#ifdef CAMERA_OVERRUN_DROP_FRAME
+	camera_resync = 0;
+	camera_abort_wr = 0;
+	camera_abort_rd = 0;
+	camera_abort_flag = 0;
+#endif // CAMERA_OVERRUN_DROP_FRAME
+#ifdef CAMERA_PASSTHROUGH
+	camera_pass_fn = NULL;
+	camera_pass_skip = 0;
+#endif // CAMERA_PASSTHROUGH
+
+	// Streaming begins on the next VSYNC edge. The caller does not wait.
+	camera_state = CAMERA_STREAMING_SYNC;
+	CRITICAL_SECTION_END
 }
 
 /**
@@ -416,11 +884,23 @@ uint16_t camera_mode_get_sample_size(int8_t format, int8_t count, uint16_t max_s
  */
 void camera_start(void)
 {
-	// Make the buffer large enough to handle:
-	// 1) As many samples of data from the camera module as possible.
-	// 2) An amount to align an additional read sample at the end of the buffer.
-	camera_buffer_size = ((CAMERA_BUFFER_LENGTH - read_sample_length) / camera_sample_length) * camera_sample_length;
-	tfp_printf("camera buffer size: %d\r\n", camera_buffer_size);
+	uint32_t ring_unit;
+
+	// The buffer size must be a multiple of both the line size written
+	// by cam_ISR and the sample size returned by camera_read.
+	// Then neither a write nor a read can straddle the end of the buffer
+	// and camera_read never has to copy data to make a sample contiguous.
+	// A read sample must also divide the line so that the end of a frame
+	// is always on a read sample boundary.
+	ring_unit = (camera_line_length / cam_gcd(camera_line_length, read_sample_length)) * read_sample_length;
+	if ((ring_unit != camera_line_length) || (ring_unit > camera_buffer_length))
+	{
+		CAMERA_DEBUG_PRINTF("Read sample %d does not fit camera buffer\r\n", read_sample_length);
+		read_sample_length = camera_line_length;
+		ring_unit = camera_line_length;
+	}
+	camera_buffer_size = (camera_buffer_length / ring_unit) * ring_unit;
+	tfp_printf("camera buffer size: %ld\r\n", camera_buffer_size);
 	vsync = 0;
 
 	/* Clock data in when VREF is low and HREF is high */
@@ -429,20 +909,34 @@ void camera_start(void)
 
 	//camera_buffer_ptr = (uint8_t *)buffer;
 	//camera_buffer_size = size;
+	camera_reset_stream();
+
 	cam_set_threshold(camera_sample_length);
 	cam_start(camera_sample_length);
 	cam_enable_interrupt();
 
-	camera_rd_buffer = 0;
-	camera_wr_buffer = 0;
-	camera_rx_data_avail = 0;
-
-	camera_state = CAMERA_STREAMING_STARTED;
-
 	if (CAMERA_start_fn)
 		return CAMERA_start_fn();
 }
 
+/**
+ * @brief CAMERA set decimation.
+ */
+void camera_set_decimation(uint8_t decimation)
+{
+	camera_decimation = decimation ? decimation : 1;
+}
+
+/**
+ * @brief CAMERA restart.
+ */
+void camera_restart(void)
+{
+	// The camera interface and module keep running. Data arriving before
+	// the next VSYNC edge is flushed by cam_ISR.
+	camera_reset_stream();
+}
+
 /**
  * @brief CAMERA stop.
  */
@@ -450,6 +944,16 @@ void camera_stop(void)
 {
 	cam_stop();
 	cam_disable_interrupt();
+#ifdef CAMERA_PASSTHROUGH
+	camera_pass_fn = NULL;
+#endif // CAMERA_PASSTHROUGH
+
+	CAMERA_DEBUG_PRINTF("Camera buffer wrapped %ld times\r\n", camera_wrap_count);
+	CAMERA_DEBUG_PRINTF("Camera dropped %ld lines %ld frames, %ld flushes\r\n",
+			camera_stats.lines_dropped, camera_stats.frames_dropped,
+			camera_stats.fifo_flushes);
+	CAMERA_DEBUG_PRINTF("Camera FIFO peak %ld bytes, line %d bytes\r\n",
+			camera_stats.fifo_peak, camera_sample_length);
 
 	camera_state = CAMERA_STREAMING_STOPPED;
 
@@ -459,7 +963,7 @@ void camera_stop(void)
 
 uint8_t *camera_read(void)
 {
-	int16_t camera_tx_data_avail;
+	uint32_t camera_tx_data_avail;
 	uint8_t *pstart;
 
 	if (camera_state != CAMERA_STREAMING_STARTED)
@@ -467,36 +971,65 @@ uint8_t *camera_read(void)
 
 	if (vsync != 0)
 	{
-		cam_disable_interrupt();
-		/* Number of lines buffered.
-		 * This is usually called frequently enough to keep up with camera
-		 * data being written by cam_ISR. The image processing which follows
-		 * will work behind this data. */
-		camera_tx_data_avail = camera_rx_data_avail;
-		if (camera_rx_data_avail >= read_sample_length)
+		/* Release the sample returned by the previous call. The data in it
+		 * remains valid until then so the caller can transmit directly from
+		 * the camera_buffer. */
+		camera_rd_total += camera_rd_pending;
+		camera_rd_pending = 0;
+
+#ifdef CAMERA_OVERRUN_DROP_FRAME
+		/* Stop at the end of the stored data for an aborted frame. The
+		 * data following it is the start of a new frame. */
+		if ((camera_abort_wr != camera_abort_rd) &&
+				(camera_abort_pos[camera_abort_rd & (CAMERA_ABORT_QUEUE_LENGTH - 1)] == camera_rd_total))
 		{
-			camera_rx_data_avail -= read_sample_length;
+			camera_abort_rd++;
+			camera_abort_flag = 1;
+			return NULL;
 		}
-		cam_enable_interrupt();
+#endif // CAMERA_OVERRUN_DROP_FRAME
+
+		/* Number of bytes buffered.
+		 * This is usually called frequently enough to keep up with camera
+		 * data being written by cam_ISR. The image processing which follows
+		 * will work behind this data. A single read of camera_wr_total is
+		 * atomic so there is no need to disable the camera interrupt. */
+		camera_tx_data_avail = camera_wr_total - camera_rd_total;
 
 		if (camera_tx_data_avail >= read_sample_length)
 		{
+			/* Find the timestamp of the frame this sample belongs to. It is
+			 * the last one queued which starts at or before the sample. */
+			while ((camera_ts_wr != camera_ts_rd) &&
+					((int32_t)(camera_rd_total - camera_ts_pos[camera_ts_rd & (CAMERA_TIMESTAMP_QUEUE_LENGTH - 1)]) >= 0))
+			{
+				camera_timestamp = camera_ts_value[camera_ts_rd & (CAMERA_TIMESTAMP_QUEUE_LENGTH - 1)];
+				camera_ts_rd++;
+			}
+
+			camera_rd_pending = read_sample_length;
+			camera_rd_length = read_sample_length;
 			pstart = &camera_buffer_ptr[camera_rd_buffer];
-			camera_rd_buffer += read_sample_length;
-			/* If the end of the read buffer is past the end of the camera
-			 * buffer then enact a special case. Copy the start of the next
-			 * sample to the end of the current one. That way the calling
-			 * program will get contiguous data. The calculations for
-			 * camera_buffer_size ensure this is safe within camera_buffer[].
-			 */
-			if (camera_rd_buffer == camera_buffer_size)
+#ifdef CAMERA_PASSTHROUGH
+			if (camera_pass_skip)
 			{
-				camera_rd_buffer = 0;
+				/* The start of this line was written to the endpoint by
+				 * cam_ISR. Return the rest of the line in one piece. */
+				camera_rd_pending = camera_line_length;
+				camera_rd_length = camera_line_length - camera_pass_skip;
+				pstart += camera_pass_skip;
+				camera_pass_skip = 0;
 			}
-			else if (camera_rd_buffer > camera_buffer_size)
+#endif // CAMERA_PASSTHROUGH
+			camera_rd_buffer += camera_rd_pending;
+			/* The calculations for camera_buffer_size in camera_start
+			 * ensure that a sample never straddles the end of the buffer
+			 * so the calling program always gets contiguous data.
+			 */
+			if (camera_rd_buffer >= camera_buffer_size)
 			{
-				memcpy(camera_buffer + camera_buffer_size, camera_buffer, read_sample_length);
-				camera_rd_buffer = read_sample_length - (camera_rd_buffer - camera_buffer_size);
+				camera_rd_buffer = 0;
+				camera_wrap_count++;
 			}
 			return pstart;
 		}
@@ -529,6 +1062,34 @@ int8_t camera_set(uint16_t width, uint16_t height, int8_t frame_rate, int8_t for
 		ret = CAMERA_set_fn(width, height, format, &frame_rate,
 				&module_sample, &frame);
 
+		// The camera module may send larger lines than the image requested.
+		// Work out the ratio to scale the image down in cam_ISR. Only
+		// ratios of 1, 2 and 4 are supported. The camera module always
+		// sends YUYV data so a luma line is compared at 2 bytes per pixel.
+		if ((ret == 0) && (height))
+		{
+			camera_bpp = (format == CAMERA_FORMAT_LUMA)?1:2;
+			camera_line_length = frame / height;
+			camera_scale = 0;
+			if ((camera_line_length) && ((camera_line_length & 3) == 0)
+					&& (module_sample <= CAMERA_LINE_BUFFER_LENGTH)
+					&& ((module_sample % (camera_line_length / camera_bpp * 2)) == 0))
+			{
+				camera_scale = module_sample / (camera_line_length / camera_bpp * 2);
+			}
+			if ((camera_scale != 1) && (camera_scale != 2) && (camera_scale != 4))
+			{
+				CAMERA_DEBUG_PRINTF("Camera cannot scale line %d to %d\r\n", module_sample, camera_line_length);
+				ret = -1;
+			}
+			camera_scale_shift = camera_scale >> 1;
+
+			// The window is the whole image until camera_set_window is called.
+			camera_window_offset = 0;
+			camera_window_top = 0;
+			camera_window_bottom = height;
+		}
+
 		if (ret == 0)
 		{
 			camera_sample_length = module_sample;
@@ -536,7 +1097,7 @@ int8_t camera_set(uint16_t width, uint16_t height, int8_t frame_rate, int8_t for
 			frame_size = frame;
 
 			CAMERA_DEBUG_PRINTF("Camera frame size %ld\r\n", frame_size);
-			CAMERA_DEBUG_PRINTF("Camera module sample %d read samples %d\r\n", camera_sample_length, read_sample_length);
+			CAMERA_DEBUG_PRINTF("Camera module sample %d read samples %d scale %d\r\n", camera_sample_length, read_sample_length, camera_scale);
 
 			frame_width = width;
 			frame_height = height;
@@ -548,9 +1109,40 @@ int8_t camera_set(uint16_t width, uint16_t height, int8_t frame_rate, int8_t for
 	}
 
 	camera_sample_length = 0;
+	camera_line_length = 0;
+	camera_scale = 1;
+	camera_scale_shift = 0;
+	camera_bpp = 2;
 	return -1;
 }
 
+/**
+ * @brief CAMERA set window.
+ */
+int8_t camera_set_window(uint16_t x, uint16_t y, uint16_t width, uint16_t height)
+{
+	// The window must be inside the image and start and end on a pixel
+	// pair so that each line in the camera buffer is longword aligned.
+	// Luma lines have half the bytes so need a multiple of 4 pixels.
+	if ((camera_sample_length == 0) || (width == 0) || (height == 0) ||
+			(x + width > frame_width) || (y + height > frame_height) ||
+			(x & 1) || ((width * camera_bpp) & 3))
+	{
+		return -1;
+	}
+
+	// The offset is into the scaled YUYV line for both formats.
+	camera_window_offset = x * 2;
+	camera_window_top = y;
+	camera_window_bottom = y + height;
+	camera_line_length = width * camera_bpp;
+	frame_size = (uint32_t)camera_line_length * height;
+
+	CAMERA_DEBUG_PRINTF("Camera window %dx%d at %d,%d frame size %ld\r\n", width, height, x, y, frame_size);
+
+	return 0;
+}
+
 /**
  @brief      CAMERA get format
  @details    Will return the current format of the camera.
@@ -579,12 +1171,13 @@ uint8_t camera_get_frame_rate()
 
 /**
  @brief      CAMERA get resolution
- @details    Will return the current resolution of the camera.
+ @details    Will return the current resolution of the camera. This is
+ 	 	 	 the size of the window if one has been set.
  **/
 uint8_t camera_get_resolution(uint16_t *width, uint16_t *height)
 {
-	*width = frame_width;
-	*height = frame_height;
+	*width = camera_line_length / camera_bpp;
+	*height = camera_window_bottom - camera_window_top;
 	if (camera_state == CAMERA_STREAMING_STARTED)
 	{
 		return 1;
@@ -638,21 +1231,131 @@ uint16_t camera_get_sample()
 	return read_sample_length;
 }
 
+uint16_t camera_get_read_length(void)
+{
+	return camera_rd_length;
+}
+
 /**
- @brief      CAMERA VSYNC detected
- @details    Tells the camera interface code that VSYNC event has been
- 	 	 	 detected.
+ @brief      CAMERA buffer wrap count
+ @details    Gets the number of times camera_read has wrapped around the
+ 	 	 	 camera buffer since the camera was started.
  **/
-void camera_vsync(volatile uint8_t *signal)
+uint32_t camera_get_wrap_count()
 {
-	cam_flush();
-	*signal = 0;
-	camera_wr_buffer = 0;
-	camera_rx_data_avail = 0;
-	camera_rd_buffer = 0;
-	while (!*signal){
+	return camera_wrap_count;
+}
+
+/**
+ @brief      CAMERA capture statistics
+ @details    Copies the capture statistics for the current stream. Each
+ 	 	 	 counter is read atomically but may be updated by cam_ISR
+ 	 	 	 between counters.
+ **/
+void camera_get_stats(CAMERA_stats *stats)
+{
+	stats->lines_dropped = camera_stats.lines_dropped;
+	stats->frames_dropped = camera_stats.frames_dropped;
+	stats->fifo_flushes = camera_stats.fifo_flushes;
+	stats->fifo_peak = camera_stats.fifo_peak;
+}
+
+/**
+ @brief      CAMERA frame timestamp
+ @details    Gets the timestamp of the frame for the data last returned
+ 	 	 	 by camera_read.
+ **/
+uint32_t camera_get_timestamp(void)
+{
+	return camera_timestamp;
+}
+
+#ifdef CAMERA_PASSTHROUGH
+/**
+ @brief      CAMERA passthrough start
+ @details    Sets the function cam_ISR uses to write lines straight to
+ 	 	 	 the endpoint and clears the passthrough byte count.
+ **/
+void camera_passthrough_start(CAMERA_passthrough fn)
+{
+	camera_pass_total = 0;
+	camera_pass_fn = fn;
+}
+
+/**
+ @brief      CAMERA passthrough active
+ @details    Returns non-zero until cam_ISR or camera_passthrough_stop
+ 	 	 	 has cleared the passthrough function.
+ **/
+uint8_t camera_passthrough_active(void)
+{
+	return (camera_pass_fn != NULL);
+}
+
+/**
+ @brief      CAMERA passthrough stop
+ @details    Clears the passthrough function and returns the number of
+ 	 	 	 bytes written through it.
+ **/
+uint32_t camera_passthrough_stop(void)
+{
+	camera_pass_fn = NULL;
+	return camera_pass_total;
+}
+#endif // CAMERA_PASSTHROUGH
+
+/**
+ @brief      CAMERA frame aborted
+ @details    Returns non-zero once when camera_read has reached the end
+ 	 	 	 of the stored data for a frame aborted by an overrun.
+ **/
+uint8_t camera_frame_aborted(void)
+{
+#ifdef CAMERA_OVERRUN_DROP_FRAME
+	if (camera_abort_flag)
+	{
+		camera_abort_flag = 0;
+		return 1;
+	}
+#endif // CAMERA_OVERRUN_DROP_FRAME
+	return 0;
+}
+
+/**
+ @brief      CAMERA VSYNC interrupt
+ @details    Called on each VSYNC edge from the VSYNC interrupt handler.
+ **/
+void camera_vsync_isr(uint32_t timestamp)
+{
+	// Synchronise a newly started camera on the start of this frame.
+	if (camera_state == CAMERA_STREAMING_SYNC)
+	{
 		cam_flush();
-	};
+		vsync = 1;
+		camera_state = CAMERA_STREAMING_STARTED;
+	}
+
+	// Skip the frames which follow a kept frame for decimation.
+	camera_skip_frame = 0;
+	if (camera_skip_count)
+	{
+		camera_skip_frame = 1;
+		camera_skip_count--;
+	}
+
+	// Record when this frame started. If camera_read has fallen a whole
+	// queue of frames behind then the timestamp is lost and the previous
+	// frame's timestamp is reused.
+	if ((vsync != 0) && (camera_skip_frame == 0) &&
+			((uint8_t)(camera_ts_wr - camera_ts_rd) < CAMERA_TIMESTAMP_QUEUE_LENGTH))
+	{
+		camera_ts_pos[camera_ts_wr & (CAMERA_TIMESTAMP_QUEUE_LENGTH - 1)] = camera_wr_total;
+		camera_ts_value[camera_ts_wr & (CAMERA_TIMESTAMP_QUEUE_LENGTH - 1)] = timestamp;
+		camera_ts_wr++;
+	}
 
-	vsync = 1;
+#ifdef CAMERA_OVERRUN_DROP_FRAME
+	// Resume storing lines at the start of this frame.
+	camera_resync = 0;
+#endif // CAMERA_OVERRUN_DROP_FRAME
 }
@@ -43,11 +43,32 @@ int8_t epuck_supports(uint16_t width, uint16_t height, int8_t frame_rate, int8_t
 	// Check the camera module supports the requested
 	// resolution, frame rate and format. If it is not
 	// supported then return an indicator.
-	if (format == CAMERA_FORMAT_UNCOMPRESSED)
+	// Luma is made by the camera interface from uncompressed data.
+	if ((format == CAMERA_FORMAT_UNCOMPRESSED) || (format == CAMERA_FORMAT_LUMA))
 	{
-		// VGA supports uncompressed and MJPEG at 15 fps.
-		if ((width == CAMERA_FRAME_WIDTH_VGA)
+		// VGA supports uncompressed and luma at 15 fps.
+		// QVGA and QQVGA are scaled down from VGA by the camera interface.
+		if (((width == CAMERA_FRAME_WIDTH_VGA)
 				&& (height == CAMERA_FRAME_HEIGHT_VGA))
+				|| ((width == CAMERA_FRAME_WIDTH_QVGA)
+				&& (height == CAMERA_FRAME_HEIGHT_QVGA))
+				|| ((width == CAMERA_FRAME_WIDTH_QQVGA)
+				&& (height == CAMERA_FRAME_HEIGHT_QQVGA)))
+		{
+			if ((frame_rate == 15) || (frame_rate == CAMERA_FRAME_RATE_ANY))
+			{
+				ret = 0;
+			}
+		}
+	}
+	// MJPEG is encoded in firmware from uncompressed data. The encoder
+	// can only hold a band of QVGA lines.
+	else if (format == CAMERA_FORMAT_MJPEG)
+	{
+		if (((width == CAMERA_FRAME_WIDTH_QVGA)
+				&& (height == CAMERA_FRAME_HEIGHT_QVGA))
+				|| ((width == CAMERA_FRAME_WIDTH_QQVGA)
+				&& (height == CAMERA_FRAME_HEIGHT_QQVGA)))
 		{
 			if ((frame_rate == 15) || (frame_rate == CAMERA_FRAME_RATE_ANY))
 			{
@@ -62,25 +83,37 @@ int8_t epuck_supports(uint16_t width, uint16_t height, int8_t frame_rate, int8_t
 int8_t epuck_set(uint16_t width, uint16_t height, int8_t format,
 		int8_t *frame_rate, uint16_t *sample_size, uint32_t *frame_size)
 {
-	int8_t ret = 0;
+	int8_t ret = -1;
 
 	CAMERA_DEBUG_PRINTF("epuck");
 
-	if (format == CAMERA_FORMAT_UNCOMPRESSED)
+	if ((format == CAMERA_FORMAT_UNCOMPRESSED) || (format == CAMERA_FORMAT_LUMA)
+			|| (format == CAMERA_FORMAT_MJPEG))
 	{
-		CAMERA_DEBUG_PRINTF(" uncompressed");
-
-		// VGA supports uncompressed at 15 fps.
-		if ((width == CAMERA_FRAME_WIDTH_VGA)
-				&& (height == CAMERA_FRAME_HEIGHT_VGA))
+		CAMERA_DEBUG_PRINTF((format == CAMERA_FORMAT_LUMA)?" luma":
+				((format == CAMERA_FORMAT_MJPEG)?" mjpeg":" uncompressed"));
+
+		// VGA supports uncompressed and luma at 15 fps. The MJPEG encoder
+		// can only hold a band of QVGA lines.
+		// The camera module always sends VGA. QVGA and QQVGA frames are
+		// scaled down from this by the camera interface. For MJPEG the
+		// frame size is the YUYV data stored for the encoder.
+		if (((width == CAMERA_FRAME_WIDTH_VGA)
+				&& (height == CAMERA_FRAME_HEIGHT_VGA)
+				&& (format != CAMERA_FORMAT_MJPEG))
+				|| ((width == CAMERA_FRAME_WIDTH_QVGA)
+				&& (height == CAMERA_FRAME_HEIGHT_QVGA))
+				|| ((width == CAMERA_FRAME_WIDTH_QQVGA)
+				&& (height == CAMERA_FRAME_HEIGHT_QQVGA)))
 		{
-			CAMERA_DEBUG_PRINTF(" VGA");
+			CAMERA_DEBUG_PRINTF(" %dx%d", width, height);
 			if ((*frame_rate == 15) || (*frame_rate == CAMERA_FRAME_RATE_ANY))
 			{
 				CAMERA_DEBUG_PRINTF(" 15fps");
-				// Sample size is 1 complete line - 1280 bytes.
+				// Sample size is 1 complete line from the module - 1280 bytes.
 				*sample_size = ((CAMERA_FRAME_WIDTH_VGA * EPUCK_BBP));
-				*frame_size = CAMERA_FRAME_WIDTH_VGA * CAMERA_FRAME_HEIGHT_VGA * EPUCK_BBP;
+				*frame_size = width * height *
+						((format == CAMERA_FORMAT_LUMA)?EPUCK_LUMA_BBP:EPUCK_BBP);
 				*frame_rate = 15;
 				ret = 0;
 			}
@@ -61,6 +61,8 @@
 #include "tinyprintf.h"
 
 #include "camera.h"
+#include "mjpeg.h"
+#include "usbd_stream.h"
 
 #define BRIDGE_DEBUG
 #ifdef BRIDGE_DEBUG
@@ -88,40 +90,18 @@
  */
 uint16_t module;
 
-/** @brief Current threshold for data received from the camera module.
+/** @brief Start and end of static data in RAM. Defined by the linker script.
+ *  @details Linker scripts which do not define __data_start put .data at
+ *  the start of RAM, where the weak reference resolves to zero.
  */
-static uint16_t sample_threshold;
+//@{
+extern char __data_start[] __attribute__((weak));
+extern char _end[];
+//@}
 
-/** @brief Used to wait for vsync (GPIO)
- */
-static volatile uint8_t gpio_vsync = 0;
-
-/**
- @brief Stream Properties
- @details A list of file/resource names which indicate the type of
- stream requested. A check is made to the camera interface to see if a
- particular stream is supported. Properties of the stream are used in
- setting up the camera when a stream is started.
+/** @brief Current threshold for data received from the camera module.
  */
-static struct stream_properties {
-	char *stream_name; /// Name of resource or file for this stream.
-	int8_t supported; /// Flag whether stream is supported by camera.
-	int8_t format; /// Format of the stream, MJPEG or RAW.
-	int8_t rate; /// Frame rate.
-	uint16_t width; /// Frame width of stream.
-	uint16_t height; /// Frame height of stream.
-} streams[] = {
-		{
-				"qvga.raw", 0,
-				CAMERA_FORMAT_UNCOMPRESSED,
-				15, 320, 240,
-		},
-		{
-				"vga.raw", 0,
-				CAMERA_FORMAT_UNCOMPRESSED,
-				15, 640, 480,
-		},
-};
+static uint16_t sample_threshold;
 
 /* GLOBAL VARIABLES ****************************************************************/
 
@@ -131,7 +111,16 @@ static struct stream_properties {
  @brief Millisecond counter
  @details Count-up timer to provide the elapsed time for network operations.
  */
-static uint32_t milliseconds = 0;
+static volatile uint32_t milliseconds = 0;
+
+#if defined(CAMERA_PASSTHROUGH) && !defined(USB_ENDPOINT_USE_ISOC)
+/**
+ @brief Passthrough packet offset
+ @details Offset in the current packet of the video endpoint of the next
+ data written by cam_ISR when it passes lines straight to the endpoint.
+ */
+static volatile uint16_t passthrough_offset = 0;
+#endif // CAMERA_PASSTHROUGH && !USB_ENDPOINT_USE_ISOC
 
 /* MACROS **************************************************************************/
 
@@ -155,6 +144,36 @@ uint32_t millis(void)
 	return milliseconds;
 }
 
+/** @brief Returns the source time clock
+ *  @details The source time clock for UVC PTS and SCR values counts at
+ *  CLK_FREQ_SOURCE_CLOCK (100 kHz). It is made from the millisecond
+ *  counter and the count of timer A within the current millisecond.
+ *  @returns A count of 10 microsecond ticks
+ */
+uint32_t stc_read(void)
+{
+	uint32_t ms;
+	uint16_t count;
+
+	// Timer A counts down from 100 to 0 every millisecond. Read again if
+	// the millisecond counter changed while the timer was read.
+	do
+	{
+		ms = milliseconds;
+		timer_read(timer_select_a, &count);
+		// Count a reload which timer_ISR has not seen yet. This happens
+		// when called from another interrupt handler as timer_ISR cannot
+		// run until that returns. Checking clears the interrupt so it is
+		// only counted once. The loop then reads the reloaded timer.
+		if (timer_is_interrupted(timer_select_a))
+		{
+			milliseconds++;
+		}
+	} while (ms != milliseconds);
+
+	return (ms * 100) + (100 - count);
+}
+
 /**
  * I2C Slave
  */
@@ -312,20 +331,36 @@ void powermanagement_ISR(void)
 	}
 }
 
-void vsync_ISR(void)
+#if defined(CAMERA_PASSTHROUGH) && !defined(USB_ENDPOINT_USE_ISOC)
+/** @name passthrough_write
+ *  @details Called from cam_ISR to write camera data straight to the video
+ *  endpoint. Writes only what fits in the free endpoint buffers.
+ *  @param port Camera FIFO register.
+ *  @param length Length of the line of data in the camera FIFO.
+ *  @returns The number of bytes taken from the camera FIFO.
+ */
+static uint16_t passthrough_write(volatile uint32_t *port, uint16_t length)
 {
-	if (gpio_is_interrupted(8))
+	int32_t sent;
+
+	sent = USBD_stream_from_port(UVC_EP_DATA_IN, port, length, passthrough_offset);
+	if (sent < 0)
 	{
-		// Signal start of frame received. Will now wait for line data.
-		gpio_vsync = 1;
+		return 0;
 	}
+	passthrough_offset = (passthrough_offset + sent) % USBD_ep_max_size(UVC_EP_DATA_IN);
+
+	return sent;
 }
+#endif // CAMERA_PASSTHROUGH && !USB_ENDPOINT_USE_ISOC
 
-void wait_for_vsync()
+void vsync_ISR(void)
 {
-	// Flush all waiting data in the camera buffer.
-	gpio_vsync = 0;
-	camera_vsync(&gpio_vsync);
+	if (gpio_is_interrupted(8))
+	{
+		// Signal start of frame received. Will now wait for line data.
+		camera_vsync_isr(stc_read());
+	}
 }
 
 uint8_t usbd_testing(void)
@@ -338,21 +373,48 @@ uint8_t usbd_testing(void)
 	uint16_t len;
 	// Length of line data left to send.
 	uint16_t remain_len = 0;
+	// Length of data in the current payload.
+	uint16_t payload_len = 0;
+	// Offset of the next data in the current packet.
+	size_t packet_offset = 0;
+	// Header and data fragments written to the video endpoint.
+	USBD_stream_fragment frag[2];
+#ifdef USB_ENDPOINT_USE_ISOC
+	// Header info bits for the last packet of the current payload.
+	uint8_t payload_info = 0;
+#else // !USB_ENDPOINT_USE_ISOC
+	// A payload header has been sent and the payload is not yet ended.
+	uint8_t payload_open = 0;
+	// How the current packet is ended.
+	USBD_STREAM_IN_MODE end;
+#ifdef CAMERA_PASSTHROUGH
+	// The camera ISR has been allowed to write to the endpoint.
+	uint8_t passthrough = 0;
+#endif // CAMERA_PASSTHROUGH
+#endif // USB_ENDPOINT_USE_ISOC
+	// Endpoint was full, wait for the endpoint interrupt or the next SOF.
+	uint8_t ep_waiting = 0;
 	// Packet length.
 	uint16_t packet_len;
-	// Part transfer required.
-	uint8_t part;
 	// Frame ID toggle
 	uint8_t frame_toggle = 0;
+	// Time the camera was started and flag to report the first frame.
+	uint32_t start_ms = 0;
+	uint8_t first_frame = 0;
+	// The stream was restarted without setting up the camera again.
+	uint8_t warm_start = 0;
 
 	// Current USB alternate interface
 	uint8_t alt = 0;
 
 	// Header for UVC sample transfer.
-	static USB_UVC_Payload_Header hdr;
+	// Aligned so that it is written to the endpoint FIFO with longword
+	// stream writes. The image data which follows it is then also on a
+	// longword boundary.
+	static USB_UVC_Payload_Header_PTS_SCR hdr __attribute__((aligned(4)));
 
 	// Header length always stays the same.
-	hdr.bHeaderLength = sizeof(USB_UVC_Payload_Header);
+	hdr.bHeaderLength = sizeof(USB_UVC_Payload_Header_PTS_SCR);
 
 	usb_uvc_setup();
 
@@ -395,22 +457,80 @@ uint8_t usbd_testing(void)
 									// Start or stop the camera.
 #ifdef USB_ENDPOINT_USE_ISOC
 									// Interface for non-zero-bandwith interface selected.
-									if (alt == 1)
+									// A started camera is left to synchronise.
+									if ((alt != 0) && (camera_get_state() != CAMERA_STREAMING_SYNC))
 #else // !USB_ENDPOINT_USE_ISOC
 										// Streaming commit received.
-										if (camera_get_state() == CAMERA_STREAMING_START)
+										if ((camera_get_state() == CAMERA_STREAMING_START) ||
+												(camera_get_state() == CAMERA_STREAMING_RESTART))
 #endif // USB_ENDPOINT_USE_ISOC
 										{
-											/* Start the camera. */
-											camera_start();
+#ifndef USB_ENDPOINT_USE_ISOC
+											// End a payload left open by the last stream.
+											if (payload_open)
+											{
+#ifdef CAMERA_PASSTHROUGH
+												if (passthrough)
+												{
+													camera_passthrough_stop();
+													packet_offset = passthrough_offset;
+												}
+#endif // CAMERA_PASSTHROUGH
+												USBD_stream_in(UVC_EP_DATA_IN, NULL, 0,
+														&packet_offset, USBD_STREAM_IN_END_ZLP);
+											}
+#endif // USB_ENDPOINT_USE_ISOC
+
+											if (camera_get_state() == CAMERA_STREAMING_RESTART)
+											{
+												/* The committed mode is already running. Keep
+												 * capturing and resume at the next frame. */
+												camera_restart();
+												warm_start = 1;
+
+												tfp_printf("Camera restarting\r\n");
+
+												if (usb_uvc_is_mjpeg())
+												{
+													mjpeg_abort();
+												}
+											}
+											else
+											{
+												/* Start the camera. */
+												camera_start();
+												warm_start = 0;
+
+												sample_threshold = camera_get_sample();
+												tfp_printf("Camera starting (sample length %d frame %ld)\r\n", sample_threshold, camera_get_frame_size());
 
-											sample_threshold = camera_get_sample();
-											tfp_printf("Camera starting (sample length %d frame %ld)\r\n", sample_threshold, camera_get_frame_size());
+												if (usb_uvc_is_mjpeg())
+												{
+													uint16_t width, height;
+
+													camera_get_resolution(&width, &height);
+													mjpeg_start(width, height, MJPEG_QUALITY);
+												}
+											}
 
-											wait_for_vsync();
+											// The camera will synchronise on the next VSYNC
+											// edge. Carry on servicing USB until then.
+											start_ms = millis();
+											first_frame = 1;
 
 											camera_tx_frame_size = 0;
-#ifndef USB_ENDPOINT_USE_ISOC
+											remain_len = 0;
+											ep_waiting = 0;
+											packet_offset = 0;
+#ifdef USB_ENDPOINT_USE_ISOC
+											// Each alternate setting has its own packet size.
+											packet_len = usb_uvc_get_packet_size();
+											usb_uvc_set_data_pending(0);
+#else // !USB_ENDPOINT_USE_ISOC
+											payload_open = 0;
+#ifdef CAMERA_PASSTHROUGH
+											passthrough = 0;
+#endif // CAMERA_PASSTHROUGH
 											alt = 1;
 #endif // USB_ENDPOINT_USE_ISOC
 										}
@@ -425,6 +545,10 @@ uint8_t usbd_testing(void)
 												cam_stop();
 
 												tfp_printf("Camera stopping\r\n");
+												tfp_printf("Stack never used %ld bytes\r\n", camera_get_stack_unused());
+#ifdef USB_ENDPOINT_USE_ISOC
+												tfp_printf("Missed microframes %ld\r\n", usb_uvc_get_missed_microframes());
+#endif // USB_ENDPOINT_USE_ISOC
 #ifndef USB_ENDPOINT_USE_ISOC
 												alt = 0;
 #endif // USB_ENDPOINT_USE_ISOC
@@ -432,96 +556,327 @@ uint8_t usbd_testing(void)
 										}
 								}
 
-								if (alt == 1)
+								if (alt != 0)
 								{
-									if (!USBD_ep_buffer_full(UVC_EP_DATA_IN))
+#ifndef USB_ENDPOINT_USE_ISOC
+									// The endpoint interrupt reports when the host has taken
+									// a packet so there is space to write another.
+									if (usb_uvc_data_ep_event())
 									{
-										/* If we need to get more data for a payload.
-										 */
-										if (remain_len == 0)
-										{
-											// Set the header info frame toggle bit.
-											hdr.bmHeaderInfo = frame_toggle | 0x80;
+										ep_waiting = 0;
+									}
 
-											// Send a full line of data if there is data available.
-											pstart = camera_read();
-											if (pstart)
+									// Stay here while there is camera data to send so that both
+									// halves of the double buffered bulk endpoint are kept full.
+									// Return to the main loop when the camera buffer is empty,
+									// the endpoint is full or a control request needs to start
+									// or stop the stream.
+#else // USB_ENDPOINT_USE_ISOC
+									// The host takes one packet from the double buffered
+									// isochronous endpoint in each (micro)frame. Refill it
+									// after each SOF so that the packet for the next
+									// (micro)frame is loaded while this one is sent.
+									if (usb_uvc_sof_event())
+									{
+										ep_waiting = 0;
+									}
+#endif // USB_ENDPOINT_USE_ISOC
+									while (!ep_waiting)
+									{
+										if (!USBD_ep_buffer_full(UVC_EP_DATA_IN))
+										{
+											/* If we need to get more data for a payload.
+											 */
+											if (remain_len == 0)
 											{
-												len = camera_get_sample();
+#ifndef USB_ENDPOINT_USE_ISOC
+												if (!payload_open)
+#endif // USB_ENDPOINT_USE_ISOC
+												{
+													// Set the header info frame toggle bit.
+													hdr.bmHeaderInfo = frame_toggle | PAYLOAD_HEADER_INFO_EOH |
+															PAYLOAD_HEADER_INFO_PTS | PAYLOAD_HEADER_INFO_SCR;
+												}
 
-												if (usb_uvc_is_uncompressed())
+												// Send a full line of data if there is data available.
+#if defined(CAMERA_PASSTHROUGH) && !defined(USB_ENDPOINT_USE_ISOC)
+												// The camera ISR owns the endpoint until it stops
+												// writing lines to it. Then carry on from where it
+												// left off in the current packet.
+												if ((passthrough) && (!camera_passthrough_active()))
 												{
-													camera_tx_frame_size += len;
-													if (camera_tx_frame_size >= camera_get_frame_size())
+													passthrough = 0;
+													camera_tx_frame_size += camera_passthrough_stop();
+													packet_offset = passthrough_offset;
+												}
+												pstart = passthrough ? NULL : camera_read();
+#else // !CAMERA_PASSTHROUGH || USB_ENDPOINT_USE_ISOC
+												pstart = camera_read();
+#endif // CAMERA_PASSTHROUGH && !USB_ENDPOINT_USE_ISOC
+												if (pstart)
+												{
+#ifdef USB_ENDPOINT_USE_ISOC
+													usb_uvc_set_data_pending(1);
+#endif // USB_ENDPOINT_USE_ISOC
+													len = camera_get_read_length();
+
+													if (first_frame)
 													{
-														// END of frame
-														hdr.bmHeaderInfo |= 2;
-														frame_toggle++; frame_toggle &= 1;
+														BRIDGE_DEBUG_PRINTF("First frame data after %ld ms (%s start)\r\n",
+																millis() - start_ms, warm_start ? "warm" : "cold");
+														first_frame = 0;
+													}
 
-														len -= (camera_tx_frame_size - camera_get_frame_size());
-														camera_tx_frame_size = 0;
+													if ((usb_uvc_is_uncompressed()) || (usb_uvc_is_luma()))
+													{
+														camera_tx_frame_size += len;
+														if (camera_tx_frame_size >= camera_get_frame_size())
+														{
+															// END of frame
+															hdr.bmHeaderInfo |= PAYLOAD_HEADER_INFO_EOF;
+															frame_toggle++; frame_toggle &= 1;
+
+															len -= (camera_tx_frame_size - camera_get_frame_size());
+															camera_tx_frame_size = 0;
+														}
+
+														remain_len = len;
+													}
+													else if (usb_uvc_is_mjpeg())
+													{
+														// Lines are encoded a band at a time. There is
+														// only data to send when a band is complete.
+														len = mjpeg_encode_line(pstart);
+														pstart = mjpeg_get_output();
+
+														camera_tx_frame_size += len;
+														if ((len) && (mjpeg_frame_end()))
+														{
+															// END of frame
+															hdr.bmHeaderInfo |= PAYLOAD_HEADER_INFO_EOF;
+															if (mjpeg_frame_error())
+															{
+																hdr.bmHeaderInfo |= PAYLOAD_HEADER_INFO_ERR;
+															}
+															frame_toggle++; frame_toggle &= 1;
+															camera_tx_frame_size = 0;
+														}
+
+														remain_len = len;
 													}
 
-													remain_len = len;
-												}
+													payload_len = remain_len;
 
-												if (remain_len)
+#ifdef USB_ENDPOINT_USE_ISOC
+													if (remain_len)
+													{
+														// Time the frame started and the time now.
+														hdr.dwPresentationTime = camera_get_timestamp();
+														hdr.dwSourceClock = stc_read();
+														hdr.wSofCounter = usb_uvc_get_sof();
+
+														// Only the last payload of an MJPEG band can end
+														// the frame.
+														payload_info = hdr.bmHeaderInfo;
+														if (len > (packet_len - sizeof(USB_UVC_Payload_Header_PTS_SCR)))
+														{
+															hdr.bmHeaderInfo &= ~(PAYLOAD_HEADER_INFO_EOF | PAYLOAD_HEADER_INFO_ERR);
+														}
+
+														// Send follow-on data for payload.
+														// Calculate the size of the remaining data for this
+														// packet. It may all be able to be sent in one packet.
+														if (len > (packet_len - sizeof(USB_UVC_Payload_Header_PTS_SCR)))
+														{
+															len = (packet_len - sizeof(USB_UVC_Payload_Header_PTS_SCR));
+														}
+
+														// Send the header and data as one packet.
+														frag[0].data = (uint8_t *)&hdr;
+														frag[0].length = sizeof(USB_UVC_Payload_Header_PTS_SCR);
+														frag[1].data = pstart;
+														frag[1].length = len;
+														USBD_stream_in(UVC_EP_DATA_IN, frag, 2,
+																&packet_offset, USBD_STREAM_IN_END);
+
+														remain_len -= len;
+													}
+#else // !USB_ENDPOINT_USE_ISOC
+													if ((remain_len) && (!payload_open))
+													{
+														// Time the frame started and the time now.
+														hdr.dwPresentationTime = camera_get_timestamp();
+														hdr.dwSourceClock = stc_read();
+														hdr.wSofCounter = usb_uvc_get_sof();
+#ifdef USB_BULK_PAYLOAD_FRAME
+														// This is the only payload in an uncompressed
+														// frame. MJPEG has a payload for each band.
+														if (!usb_uvc_is_mjpeg())
+														{
+															hdr.bmHeaderInfo |= PAYLOAD_HEADER_INFO_EOF;
+														}
+#endif // USB_BULK_PAYLOAD_FRAME
+
+														// Add header to USB endpoint buffer.
+														// The data follows it in the same packet.
+														frag[0].data = (uint8_t *)&hdr;
+														frag[0].length = sizeof(USB_UVC_Payload_Header_PTS_SCR);
+														USBD_stream_in(UVC_EP_DATA_IN, frag, 1,
+																&packet_offset, USBD_STREAM_IN_PART);
+														payload_open = 1;
+													}
+#endif // USB_ENDPOINT_USE_ISOC
+												}
+												else if (camera_frame_aborted())
 												{
-													// Add header to USB endpoint buffer.
-													// Set flag to allow follow-on data.
-													USBD_transfer_ex(UVC_EP_DATA_IN,
-															(uint8_t *)&hdr,
-															sizeof(USB_UVC_Payload_Header),
-															USBD_TRANSFER_EX_PART_NO_SEND,
-															0);
-
-													part = USBD_TRANSFER_EX_PART_NORMAL;
-													// Send follow-on data for payload.
-													// Calculate the size of the remaining data for this
-													// packet. It may all be able to be sent in one packet.
-													if (len > (packet_len - sizeof(USB_UVC_Payload_Header)))
+													// The rest of this frame was lost to a camera
+													// buffer overrun. End the frame with the error
+													// bit set so that the host discards it, then
+													// start the next frame with a new frame ID.
+													if (usb_uvc_is_mjpeg())
 													{
-														len = (packet_len - sizeof(USB_UVC_Payload_Header));
-														part = USBD_TRANSFER_EX_PART_NO_SEND;
+														mjpeg_abort();
 													}
+#ifndef USB_ENDPOINT_USE_ISOC
+													if (payload_open)
+													{
+														// The header for this payload has already been
+														// sent. End the payload with a short packet. The
+														// frame is too small so the host will discard it.
+														// Only uncompressed frames are sent as one payload
+														// as the host does not check the size of MJPEG
+														// frames.
+														USBD_stream_in(UVC_EP_DATA_IN, NULL, 0,
+																&packet_offset, USBD_STREAM_IN_END_ZLP);
+														payload_open = 0;
+														frame_toggle++; frame_toggle &= 1;
+														camera_tx_frame_size = 0;
+													}
+													else
+#endif // USB_ENDPOINT_USE_ISOC
+													if (camera_tx_frame_size)
+													{
+														hdr.bmHeaderInfo |= PAYLOAD_HEADER_INFO_ERR | PAYLOAD_HEADER_INFO_EOF;
+														frame_toggle++; frame_toggle &= 1;
+														camera_tx_frame_size = 0;
 
-													USBD_transfer_ex(UVC_EP_DATA_IN,
-															pstart,
-															len,
-															part,
-															sizeof(USB_UVC_Payload_Header));
+														hdr.dwSourceClock = stc_read();
+														hdr.wSofCounter = usb_uvc_get_sof();
 
-													remain_len -= len;
+														frag[0].data = (uint8_t *)&hdr;
+														frag[0].length = sizeof(USB_UVC_Payload_Header_PTS_SCR);
+														USBD_stream_in(UVC_EP_DATA_IN, frag, 1,
+																&packet_offset, USBD_STREAM_IN_END);
+													}
 												}
 											}
-										}
 #ifndef USB_ENDPOINT_USE_ISOC
-										// This is only relevant for bulk mode.
-										// We can send multiple USB packets with a single header
-										// to form a transfer of UVC data. This cannot be done with
-										// an isochronous endpoint.
-										if (remain_len)
-										{
-											part = USBD_TRANSFER_EX_PART_NORMAL;
-											len = remain_len;
-
-											// Do not send the header on all subsequent packets.
-											// Send only one packet at a time.
-											if (len >= (packet_len))
+											// This is only relevant for bulk mode.
+											// We can send multiple USB packets with a single header
+											// to form a transfer of UVC data. This cannot be done with
+											// an isochronous endpoint.
+											if (remain_len)
 											{
-												len = packet_len;
-												part = USBD_TRANSFER_EX_PART_NO_SEND;
+												// Fill the rest of the current packet.
+												// Send only one packet at a time.
+												end = USBD_STREAM_IN_PART;
+												len = packet_len - packet_offset;
+												if (remain_len <= len)
+												{
+													len = remain_len;
+#ifdef USB_BULK_PAYLOAD_FRAME
+													// The payload continues with the next sample
+													// until the end of an uncompressed frame.
+													if ((camera_tx_frame_size == 0) || (usb_uvc_is_mjpeg()))
+#endif // USB_BULK_PAYLOAD_FRAME
+													{
+														payload_open = 0;
+														// End the payload with a short packet. A
+														// variable size MJPEG payload which ends on a
+														// packet boundary is ended with a zero length
+														// packet.
+														end = USBD_STREAM_IN_END;
+														if (usb_uvc_is_mjpeg())
+														{
+															end = USBD_STREAM_IN_END_ZLP;
+														}
+													}
+												}
+
+												frag[0].data = &pstart[payload_len - remain_len];
+												frag[0].length = len;
+												USBD_stream_in(UVC_EP_DATA_IN, frag, 1,
+														&packet_offset, end);
+
+												remain_len -= len;
 											}
+#else // USB_ENDPOINT_USE_ISOC
+											// An isochronous payload is limited to one packet.
+											// The rest of an MJPEG band is sent in following
+											// payloads each with its own header.
+											else
+											{
+												len = remain_len;
+												if (len > (packet_len - sizeof(USB_UVC_Payload_Header_PTS_SCR)))
+												{
+													len = (packet_len - sizeof(USB_UVC_Payload_Header_PTS_SCR));
+												}
+												else
+												{
+													hdr.bmHeaderInfo = payload_info;
+												}
+
+												hdr.dwSourceClock = stc_read();
+												hdr.wSofCounter = usb_uvc_get_sof();
+
+												frag[0].data = (uint8_t *)&hdr;
+												frag[0].length = sizeof(USB_UVC_Payload_Header_PTS_SCR);
+												frag[1].data = &pstart[payload_len - remain_len];
+												frag[1].length = len;
+												USBD_stream_in(UVC_EP_DATA_IN, frag, 2,
+														&packet_offset, USBD_STREAM_IN_END);
 
-											USBD_transfer_ex(UVC_EP_DATA_IN,
-													&pstart[sample_threshold - remain_len],
-													len,
-													part,
-													packet_len);
+												remain_len -= len;
+											}
+#endif // USB_ENDPOINT_USE_ISOC
 
-											remain_len -= len;
+											// Nothing left in the camera buffer.
+											if ((remain_len == 0) && (pstart == NULL))
+											{
+#ifdef USB_ENDPOINT_USE_ISOC
+												usb_uvc_set_data_pending(0);
+#else // !USB_ENDPOINT_USE_ISOC
+#ifdef CAMERA_PASSTHROUGH
+												// Let the camera ISR write the following lines
+												// of this frame straight to the endpoint.
+												if ((!passthrough) && (payload_open) && (usb_uvc_is_uncompressed()))
+												{
+													passthrough_offset = packet_offset;
+													camera_passthrough_start(passthrough_write);
+													passthrough = 1;
+												}
+#endif // CAMERA_PASSTHROUGH
+#endif // USB_ENDPOINT_USE_ISOC
+												break;
+											}
 										}
+										else
+										{
+											// Do not poll the endpoint until the host has
+											// taken a packet from it.
+											ep_waiting = 1;
+#ifdef USB_ENDPOINT_USE_ISOC
+											usb_uvc_set_data_pending(1);
 #endif // USB_ENDPOINT_USE_ISOC
+										}
+
+										if ((camera_get_state() == CAMERA_STREAMING_START) ||
+												(camera_get_state() == CAMERA_STREAMING_RESTART) ||
+												(camera_get_state() == CAMERA_STREAMING_STOP) ||
+												(USBD_get_state() != USBD_STATE_CONFIGURED))
+										{
+											break;
+										}
 									}
 								}
 							}
@@ -688,31 +1043,65 @@ int main(void)
 	module = camera_init();
 	if (module > 0)
 	{
+		uint8_t *buffer;
+		uint32_t buffer_length;
+
 		interrupt_enable_globally();
 
+		// Report where RAM is used. Everything below the end of static data
+		// is placed by the linker, the camera buffer follows it and the
+		// stack is above that.
+		buffer = camera_get_buffer(&buffer_length);
+		BRIDGE_DEBUG_PRINTF("RAM map:\r\n");
+		BRIDGE_DEBUG_PRINTF(" 0x%05lx static data (%ld bytes)\r\n",
+				(uint32_t)__data_start, (uint32_t)_end - (uint32_t)__data_start);
+		BRIDGE_DEBUG_PRINTF(" 0x%05lx camera buffer (%ld bytes)\r\n",
+				(uint32_t)buffer, buffer_length);
+		BRIDGE_DEBUG_PRINTF(" 0x%05lx free (%ld bytes)\r\n",
+				(uint32_t)buffer + buffer_length,
+				(uint32_t)__builtin_frame_address(0) - ((uint32_t)buffer + buffer_length));
+		BRIDGE_DEBUG_PRINTF(" 0x%05lx stack\r\n",
+				(uint32_t)__builtin_frame_address(0));
+		BRIDGE_DEBUG_PRINTF("Stack never used %ld bytes\r\n",
+				camera_get_stack_unused());
+
 		BRIDGE_DEBUG_PRINTF("UVC supports:\r\n");
-		for (int i = 0; i < sizeof(streams)/sizeof(struct stream_properties); i++)
+		for (uint8_t i = 0, frame = 0; i < camera_mode_table_count(); i++)
 		{
-			if (camera_supports(streams[i].width, streams[i].height,
-					streams[i].rate, streams[i].format) == 0)
-			{
-				int8_t supports = 1;
-				char *fmt = "None";
+			const CAMERA_mode *mode = camera_mode_table_get(i);
+			char *fmt = (mode->format == CAMERA_FORMAT_LUMA)?"LUMA":
+					((mode->format == CAMERA_FORMAT_MJPEG)?"MJPEG":"UNCOMPRESSED");
 
-				fmt = "UNCOMPRESSED";
-				// Check USB bandwidth constraints on
-				supports = usb_uvc_bandwidth_ok(streams[i].width, streams[i].height,
-						streams[i].rate);
+			// Frame index of the mode within its format. The table holds
+			// each format's modes in frame index order.
+			if ((i == 0) || (camera_mode_table_get(i - 1)->format != mode->format))
+			{
+				frame = 0;
+			}
+			frame++;
 
-				if (supports)
-				{
-					camera_mode_add(streams[i].width, streams[i].height,
-							streams[i].rate, streams[i].format);
-					streams[i].supported = 1;
+			BRIDGE_DEBUG_PRINTF("%dx%d at %d,%d of %dx%d at %dfps %s\r\n",
+					mode->width, mode->height, mode->x, mode->y,
+					mode->image_width, mode->image_height,
+					mode->frame_rate, fmt);
 
-					BRIDGE_DEBUG_PRINTF("%s: %dx%d at %dfps %s\r\n", streams[i].stream_name,
-							streams[i].width, streams[i].height, streams[i].rate, fmt);
-				}
+			// The modes are fixed in the configuration descriptors at
+			// compile time. Warn about any which cannot be streamed.
+			if (camera_supports(mode->image_width, mode->image_height,
+					mode->frame_rate, mode->format) != 0)
+			{
+				BRIDGE_DEBUG_PRINTF(" not supported by camera module\r\n");
+			}
+			else if (!usb_uvc_bandwidth_ok(USBD_SPEED_HIGH, mode->width, mode->height,
+					mode->frame_rate, mode->format))
+			{
+				BRIDGE_DEBUG_PRINTF(" exceeds USB bandwidth at full frame rate\r\n");
+			}
+			else if ((frame <= usb_uvc_get_frame_count_fs(mode->format)) &&
+					(!usb_uvc_bandwidth_ok(USBD_SPEED_FULL, mode->width, mode->height,
+					mode->frame_rate, mode->format)))
+			{
+				BRIDGE_DEBUG_PRINTF(" exceeds Full Speed USB bandwidth at full frame rate\r\n");
 			}
 		}
 
@@ -0,0 +1,776 @@
+/**
+  @file mjpeg.c
+ */
+/*
+ * ============================================================================
+ * History
+ * =======
+ * 2026-10-17 : Created
+ *
+ * (C) Copyright Bridgetek Pte Ltd
+ * ============================================================================
+ *
+ * This source code ("the Software") is provided by Bridgetek Pte Ltd
+ * ("Bridgetek") subject to the licence terms set out
+ * http://www.ftdichip.com/FTSourceCodeLicenceTerms.htm ("the Licence Terms").
+ * You must read the Licence Terms before downloading or using the Software.
+ * By installing or using the Software you agree to the Licence Terms. If you
+ * do not agree to the Licence Terms then do not download or use the Software.
+ *
+ * Without prejudice to the Licence Terms, here is a summary of some of the key
+ * terms of the Licence Terms (and in the event of any conflict between this
+ * summary and the Licence Terms then the text of the Licence Terms will
+ * prevail).
+ *
+ * The Software is provided "as is".
+ * There are no warranties (or similar) in relation to the quality of the
+ * Software. You use it at your own risk.
+ * The Software should not be used in, or for, any medical device, system or
+ * appliance. There are exclusions of Bridgetek liability for certain types of loss
+ * such as: special loss or damage; incidental loss or damage; indirect or
+ * consequential loss or damage; loss of income; loss of business; loss of
+ * profits; loss of revenue; loss of contracts; business interruption; loss of
+ * the use of money or anticipated savings; loss of information; loss of
+ * opportunity; loss of goodwill or reputation; and/or loss of, damage to or
+ * corruption of data.
+ * There is a monetary cap on Bridgetek's liability.
+ * The Software may have subsequently been amended by another user and then
+ * distributed by that other user ("Adapted Software").  If so that user may
+ * have additional licence terms that apply to those amendments. However, Bridgetek
+ * has no liability in relation to those amendments.
+ * ============================================================================
+ */
+
+/* INCLUDES ************************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+
+#include "mjpeg.h"
+
+/* CONSTANTS ***********************************************************************/
+
+/**
+ @name    JPEG markers
+ */
+//@{
+#define MJPEG_MARKER_SOI 0xD8
+#define MJPEG_MARKER_EOI 0xD9
+#define MJPEG_MARKER_SOF0 0xC0
+#define MJPEG_MARKER_DHT 0xC4
+#define MJPEG_MARKER_DQT 0xDB
+#define MJPEG_MARKER_SOS 0xDA
+//@}
+
+/**
+ @name    Integer DCT constants
+ @details Fixed point constants for the accurate integer forward DCT
+ 	 from the IJG libjpeg jfdctint.c. The output of the DCT is scaled up
+ 	 by 8 which is removed during quantisation.
+ */
+//@{
+#define DCT_CONST_BITS 13
+#define DCT_PASS1_BITS 2
+#define DCT_FIX_0_298631336 2446
+#define DCT_FIX_0_390180644 3196
+#define DCT_FIX_0_541196100 4433
+#define DCT_FIX_0_765366865 6270
+#define DCT_FIX_0_899976223 7373
+#define DCT_FIX_1_175875602 9633
+#define DCT_FIX_1_501321110 12299
+#define DCT_FIX_1_847759065 15137
+#define DCT_FIX_1_961570560 16069
+#define DCT_FIX_2_053119869 16819
+#define DCT_FIX_2_562915447 20995
+#define DCT_FIX_3_072711026 25172
+#define DCT_DESCALE(x, n) (((x) + (1 << ((n) - 1))) >> (n))
+//@}
+
+/**
+ @brief Bits of precision in the quantisation reciprocals.
+ @details Quantisation multiplies by a reciprocal of the divisor rather
+ 	 than dividing each coefficient.
+ */
+#define MJPEG_RECIP_BITS 16
+
+/** @brief Zig-zag order of coefficients in a block.
+ */
+static const uint8_t mjpeg_zigzag[64] = {
+		0, 1, 8, 16, 9, 2, 3, 10,
+		17, 24, 32, 25, 18, 11, 4, 5,
+		12, 19, 26, 33, 40, 48, 41, 34,
+		27, 20, 13, 6, 7, 14, 21, 28,
+		35, 42, 49, 56, 57, 50, 43, 36,
+		29, 22, 15, 23, 30, 37, 44, 51,
+		58, 59, 52, 45, 38, 31, 39, 46,
+		53, 60, 61, 54, 47, 55, 62, 63,
+};
+
+/** @brief Luminance and chrominance quantisation tables.
+ * @details From Annex K.1 of the JPEG specification in natural order.
+ */
+static const uint8_t mjpeg_std_quant[2][64] = {
+		{
+				16, 11, 10, 16, 24, 40, 51, 61,
+				12, 12, 14, 19, 26, 58, 60, 55,
+				14, 13, 16, 24, 40, 57, 69, 56,
+				14, 17, 22, 29, 51, 87, 80, 62,
+				18, 22, 37, 56, 68, 109, 103, 77,
+				24, 35, 55, 64, 81, 104, 113, 92,
+				49, 64, 78, 87, 103, 121, 120, 101,
+				72, 92, 95, 98, 112, 100, 103, 99,
+		},
+		{
+				17, 18, 24, 47, 99, 99, 99, 99,
+				18, 21, 26, 66, 99, 99, 99, 99,
+				24, 26, 56, 99, 99, 99, 99, 99,
+				47, 66, 99, 99, 99, 99, 99, 99,
+				99, 99, 99, 99, 99, 99, 99, 99,
+				99, 99, 99, 99, 99, 99, 99, 99,
+				99, 99, 99, 99, 99, 99, 99, 99,
+				99, 99, 99, 99, 99, 99, 99, 99,
+		},
+};
+
+/**
+ @name    Huffman tables
+ @details Standard tables from Annex K.3 of the JPEG specification. Each
+ 	 is a count of codes of each length from 1 to 16 bits followed by the
+ 	 symbol values in order of code.
+ */
+//@{
+static const uint8_t mjpeg_dc_lum_bits[16] = {
+		0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0,
+};
+static const uint8_t mjpeg_dc_chrom_bits[16] = {
+		0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0,
+};
+static const uint8_t mjpeg_dc_vals[12] = {
+		0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11,
+};
+static const uint8_t mjpeg_ac_lum_bits[16] = {
+		0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d,
+};
+static const uint8_t mjpeg_ac_lum_vals[162] = {
+		0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12,
+		0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+		0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08,
+		0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+		0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16,
+		0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+		0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39,
+		0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+		0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59,
+		0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+		0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79,
+		0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+		0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98,
+		0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+		0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6,
+		0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+		0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4,
+		0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+		0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea,
+		0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+		0xf9, 0xfa,
+};
+static const uint8_t mjpeg_ac_chrom_bits[16] = {
+		0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77,
+};
+static const uint8_t mjpeg_ac_chrom_vals[162] = {
+		0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21,
+		0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+		0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91,
+		0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+		0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34,
+		0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+		0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38,
+		0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+		0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58,
+		0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+		0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78,
+		0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+		0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96,
+		0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+		0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4,
+		0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+		0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2,
+		0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+		0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9,
+		0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+		0xf9, 0xfa,
+};
+//@}
+
+/* LOCAL VARIABLES *****************************************************************/
+
+/** @brief Frame size set by mjpeg_start.
+ */
+//@{
+static uint16_t mjpeg_width = 0;
+static uint16_t mjpeg_height = 0;
+//@}
+
+/** @brief Line within the frame of the next line to encode.
+ */
+static uint16_t mjpeg_line = 0;
+
+/** @brief Current quality. The tables are rebuilt when it changes.
+ */
+static uint8_t mjpeg_quality = 0;
+
+/** @brief Quantisation tables in zig-zag order as written in the DQT.
+ */
+static uint8_t mjpeg_quant[2][64];
+
+/** @brief Quantisation reciprocals in zig-zag order.
+ * @details Reciprocal of 8 times the quantisation value to also remove
+ * the scaling from the DCT.
+ */
+static uint16_t mjpeg_recip[2][64];
+
+/** @brief Huffman tables for luminance and chrominance.
+ * @details Code and code length for each symbol value. DC symbols are
+ * only 0 to 11.
+ */
+//@{
+static uint16_t mjpeg_dc_code[2][12];
+static uint8_t mjpeg_dc_size[2][12];
+static uint16_t mjpeg_ac_code[2][256];
+static uint8_t mjpeg_ac_size[2][256];
+static uint8_t mjpeg_huff_ready = 0;
+//@}
+
+/** @brief Band of lines split into planar components.
+ * @details The chrominance is already subsampled horizontally in YUYV so
+ * each chrominance row is half the width of the luminance row.
+ */
+//@{
+static uint8_t mjpeg_band_y[MJPEG_BAND_LINES][MJPEG_MAX_WIDTH] __attribute__((aligned(4)));
+static uint8_t mjpeg_band_cb[MJPEG_BAND_LINES][MJPEG_MAX_WIDTH / 2] __attribute__((aligned(4)));
+static uint8_t mjpeg_band_cr[MJPEG_BAND_LINES][MJPEG_MAX_WIDTH / 2] __attribute__((aligned(4)));
+//@}
+
+/** @brief Output buffer for encoded data.
+ * @details Aligned so that it can be streamed to the USB endpoint.
+ */
+static uint8_t mjpeg_output[MJPEG_OUTPUT_LENGTH] __attribute__((aligned(4)));
+static uint16_t mjpeg_output_len = 0;
+
+/** @brief Entropy coder state.
+ * @details Bits not yet written to the output and the DC value of the
+ * previous block of each component.
+ */
+//@{
+static uint32_t mjpeg_bit_buffer = 0;
+static uint8_t mjpeg_bit_count = 0;
+static int16_t mjpeg_last_dc[3];
+//@}
+
+/** @brief Frame status flags.
+ */
+//@{
+static uint8_t mjpeg_end = 0;
+static uint8_t mjpeg_error = 0;
+//@}
+
+/* LOCAL FUNCTIONS / INLINES *******************************************************/
+
+/** @brief Build a Huffman code table from a bits/values specification.
+ * @details Generates codes as in Annex C of the JPEG specification.
+ */
+static void mjpeg_build_huffman(uint16_t *huff_code, uint8_t *huff_size,
+		const uint8_t *bits, const uint8_t *vals)
+{
+	uint16_t code = 0;
+	uint8_t len;
+	uint8_t i;
+	uint8_t k = 0;
+
+	for (len = 1; len <= 16; len++)
+	{
+		for (i = 0; i < bits[len - 1]; i++)
+		{
+			huff_code[vals[k]] = code;
+			huff_size[vals[k]] = len;
+			code++;
+			k++;
+		}
+		code <<= 1;
+	}
+}
+
+static inline void mjpeg_put_byte(uint8_t b)
+{
+	if (mjpeg_output_len < MJPEG_OUTPUT_LENGTH)
+	{
+		mjpeg_output[mjpeg_output_len++] = b;
+	}
+	else
+	{
+		mjpeg_error = 1;
+	}
+}
+
+static void mjpeg_put_word(uint16_t w)
+{
+	mjpeg_put_byte(w >> 8);
+	mjpeg_put_byte(w & 0xff);
+}
+
+static void mjpeg_put_marker(uint8_t marker)
+{
+	mjpeg_put_byte(0xff);
+	mjpeg_put_byte(marker);
+}
+
+/** @brief Add bits to the entropy coded data.
+ * @details A 0xFF byte in the entropy coded data is followed by a 0x00
+ * byte so that it is not taken as a marker.
+ * @param code Value to write in the low bits.
+ * @param size Number of bits to write. No more than 16.
+ */
+static inline void mjpeg_put_bits(uint32_t code, uint8_t size)
+{
+	uint8_t b;
+
+	mjpeg_bit_buffer = (mjpeg_bit_buffer << size) | (code & ((1UL << size) - 1));
+	mjpeg_bit_count += size;
+	while (mjpeg_bit_count >= 8)
+	{
+		mjpeg_bit_count -= 8;
+		b = mjpeg_bit_buffer >> mjpeg_bit_count;
+		mjpeg_put_byte(b);
+		if (b == 0xff)
+		{
+			mjpeg_put_byte(0x00);
+		}
+	}
+}
+
+/** @brief Pad the entropy coded data to a byte with one bits.
+ */
+static void mjpeg_flush_bits(void)
+{
+	if (mjpeg_bit_count)
+	{
+		mjpeg_put_bits(0x7f, 8 - mjpeg_bit_count);
+	}
+	mjpeg_bit_count = 0;
+}
+
+static void mjpeg_put_dht(uint8_t class_id, const uint8_t *bits, const uint8_t *vals)
+{
+	uint8_t i;
+	uint16_t count = 0;
+
+	mjpeg_put_byte(class_id);
+	for (i = 0; i < 16; i++)
+	{
+		mjpeg_put_byte(bits[i]);
+		count += bits[i];
+	}
+	for (i = 0; i < count; i++)
+	{
+		mjpeg_put_byte(vals[i]);
+	}
+}
+
+/** @brief Write the JPEG headers for a frame.
+ * @details Baseline JPEG with 4:2:2 sampling. The Huffman tables are
+ * always included so that the frame can be decoded on its own.
+ */
+static void mjpeg_put_headers(void)
+{
+	uint8_t i;
+
+	mjpeg_put_marker(MJPEG_MARKER_SOI);
+
+	// Quantisation tables.
+	mjpeg_put_marker(MJPEG_MARKER_DQT);
+	mjpeg_put_word(2 + (2 * 65));
+	for (i = 0; i < 2; i++)
+	{
+		mjpeg_put_byte(i);
+		memcpy(&mjpeg_output[mjpeg_output_len], mjpeg_quant[i], 64);
+		mjpeg_output_len += 64;
+	}
+
+	// Frame header. Luminance is sampled 2x1 and chrominance 1x1.
+	mjpeg_put_marker(MJPEG_MARKER_SOF0);
+	mjpeg_put_word(17);
+	mjpeg_put_byte(8);
+	mjpeg_put_word(mjpeg_height);
+	mjpeg_put_word(mjpeg_width);
+	mjpeg_put_byte(3);
+	mjpeg_put_byte(1); mjpeg_put_byte(0x21); mjpeg_put_byte(0);
+	mjpeg_put_byte(2); mjpeg_put_byte(0x11); mjpeg_put_byte(1);
+	mjpeg_put_byte(3); mjpeg_put_byte(0x11); mjpeg_put_byte(1);
+
+	// Huffman tables.
+	mjpeg_put_marker(MJPEG_MARKER_DHT);
+	mjpeg_put_word(2 + (4 * 17) + (2 * sizeof(mjpeg_dc_vals)) +
+			sizeof(mjpeg_ac_lum_vals) + sizeof(mjpeg_ac_chrom_vals));
+	mjpeg_put_dht(0x00, mjpeg_dc_lum_bits, mjpeg_dc_vals);
+	mjpeg_put_dht(0x10, mjpeg_ac_lum_bits, mjpeg_ac_lum_vals);
+	mjpeg_put_dht(0x01, mjpeg_dc_chrom_bits, mjpeg_dc_vals);
+	mjpeg_put_dht(0x11, mjpeg_ac_chrom_bits, mjpeg_ac_chrom_vals);
+
+	// Scan header.
+	mjpeg_put_marker(MJPEG_MARKER_SOS);
+	mjpeg_put_word(12);
+	mjpeg_put_byte(3);
+	mjpeg_put_byte(1); mjpeg_put_byte(0x00);
+	mjpeg_put_byte(2); mjpeg_put_byte(0x11);
+	mjpeg_put_byte(3); mjpeg_put_byte(0x11);
+	mjpeg_put_byte(0);
+	mjpeg_put_byte(63);
+	mjpeg_put_byte(0);
+}
+
+/** @brief Forward DCT of a block.
+ * @details Accurate integer DCT. Output is scaled up by 8.
+ * @param data Block of 64 level shifted samples in natural order.
+ */
+static void mjpeg_fdct(int32_t *data)
+{
+	int32_t tmp0, tmp1, tmp2, tmp3, tmp4, tmp5, tmp6, tmp7;
+	int32_t tmp10, tmp11, tmp12, tmp13;
+	int32_t z1, z2, z3, z4, z5;
+	int32_t *p;
+	uint8_t i;
+
+	// Pass 1: process rows. Results are scaled up by 2^PASS1_BITS.
+	for (p = data, i = 0; i < 8; i++, p += 8)
+	{
+		tmp0 = p[0] + p[7];
+		tmp7 = p[0] - p[7];
+		tmp1 = p[1] + p[6];
+		tmp6 = p[1] - p[6];
+		tmp2 = p[2] + p[5];
+		tmp5 = p[2] - p[5];
+		tmp3 = p[3] + p[4];
+		tmp4 = p[3] - p[4];
+
+		tmp10 = tmp0 + tmp3;
+		tmp13 = tmp0 - tmp3;
+		tmp11 = tmp1 + tmp2;
+		tmp12 = tmp1 - tmp2;
+
+		p[0] = (tmp10 + tmp11) << DCT_PASS1_BITS;
+		p[4] = (tmp10 - tmp11) << DCT_PASS1_BITS;
+
+		z1 = (tmp12 + tmp13) * DCT_FIX_0_541196100;
+		p[2] = DCT_DESCALE(z1 + tmp13 * DCT_FIX_0_765366865, DCT_CONST_BITS - DCT_PASS1_BITS);
+		p[6] = DCT_DESCALE(z1 - tmp12 * DCT_FIX_1_847759065, DCT_CONST_BITS - DCT_PASS1_BITS);
+
+		z1 = tmp4 + tmp7;
+		z2 = tmp5 + tmp6;
+		z3 = tmp4 + tmp6;
+		z4 = tmp5 + tmp7;
+		z5 = (z3 + z4) * DCT_FIX_1_175875602;
+
+		tmp4 *= DCT_FIX_0_298631336;
+		tmp5 *= DCT_FIX_2_053119869;
+		tmp6 *= DCT_FIX_3_072711026;
+		tmp7 *= DCT_FIX_1_501321110;
+		z1 *= -DCT_FIX_0_899976223;
+		z2 *= -DCT_FIX_2_562915447;
+		z3 *= -DCT_FIX_1_961570560;
+		z4 *= -DCT_FIX_0_390180644;
+
+		z3 += z5;
+		z4 += z5;
+
+		p[7] = DCT_DESCALE(tmp4 + z1 + z3, DCT_CONST_BITS - DCT_PASS1_BITS);
+		p[5] = DCT_DESCALE(tmp5 + z2 + z4, DCT_CONST_BITS - DCT_PASS1_BITS);
+		p[3] = DCT_DESCALE(tmp6 + z2 + z3, DCT_CONST_BITS - DCT_PASS1_BITS);
+		p[1] = DCT_DESCALE(tmp7 + z1 + z4, DCT_CONST_BITS - DCT_PASS1_BITS);
+	}
+
+	// Pass 2: process columns. Removes the PASS1_BITS scaling but leaves
+	// the results scaled up by 8.
+	for (p = data, i = 0; i < 8; i++, p++)
+	{
+		tmp0 = p[8 * 0] + p[8 * 7];
+		tmp7 = p[8 * 0] - p[8 * 7];
+		tmp1 = p[8 * 1] + p[8 * 6];
+		tmp6 = p[8 * 1] - p[8 * 6];
+		tmp2 = p[8 * 2] + p[8 * 5];
+		tmp5 = p[8 * 2] - p[8 * 5];
+		tmp3 = p[8 * 3] + p[8 * 4];
+		tmp4 = p[8 * 3] - p[8 * 4];
+
+		tmp10 = tmp0 + tmp3;
+		tmp13 = tmp0 - tmp3;
+		tmp11 = tmp1 + tmp2;
+		tmp12 = tmp1 - tmp2;
+
+		p[8 * 0] = DCT_DESCALE(tmp10 + tmp11, DCT_PASS1_BITS);
+		p[8 * 4] = DCT_DESCALE(tmp10 - tmp11, DCT_PASS1_BITS);
+
+		z1 = (tmp12 + tmp13) * DCT_FIX_0_541196100;
+		p[8 * 2] = DCT_DESCALE(z1 + tmp13 * DCT_FIX_0_765366865, DCT_CONST_BITS + DCT_PASS1_BITS);
+		p[8 * 6] = DCT_DESCALE(z1 - tmp12 * DCT_FIX_1_847759065, DCT_CONST_BITS + DCT_PASS1_BITS);
+
+		z1 = tmp4 + tmp7;
+		z2 = tmp5 + tmp6;
+		z3 = tmp4 + tmp6;
+		z4 = tmp5 + tmp7;
+		z5 = (z3 + z4) * DCT_FIX_1_175875602;
+
+		tmp4 *= DCT_FIX_0_298631336;
+		tmp5 *= DCT_FIX_2_053119869;
+		tmp6 *= DCT_FIX_3_072711026;
+		tmp7 *= DCT_FIX_1_501321110;
+		z1 *= -DCT_FIX_0_899976223;
+		z2 *= -DCT_FIX_2_562915447;
+		z3 *= -DCT_FIX_1_961570560;
+		z4 *= -DCT_FIX_0_390180644;
+
+		z3 += z5;
+		z4 += z5;
+
+		p[8 * 7] = DCT_DESCALE(tmp4 + z1 + z3, DCT_CONST_BITS + DCT_PASS1_BITS);
+		p[8 * 5] = DCT_DESCALE(tmp5 + z2 + z4, DCT_CONST_BITS + DCT_PASS1_BITS);
+		p[8 * 3] = DCT_DESCALE(tmp6 + z2 + z3, DCT_CONST_BITS + DCT_PASS1_BITS);
+		p[8 * 1] = DCT_DESCALE(tmp7 + z1 + z4, DCT_CONST_BITS + DCT_PASS1_BITS);
+	}
+}
+
+/** @brief Number of bits needed for the magnitude of a coefficient.
+ */
+static inline uint8_t mjpeg_bit_size(uint16_t value)
+{
+	uint8_t size = 0;
+
+	while (value)
+	{
+		size++;
+		value >>= 1;
+	}
+	return size;
+}
+
+/** @brief Encode one 8x8 block from a planar band.
+ * @param src Top left sample of the block in the band.
+ * @param stride Length of a row of the band in bytes.
+ * @param comp Component number. 0 for luminance, 1 and 2 for chrominance.
+ */
+static void mjpeg_encode_block(const uint8_t *src, uint16_t stride, uint8_t comp)
+{
+	int32_t block[64];
+	uint8_t table = (comp == 0)?0:1;
+	const uint16_t *recip = mjpeg_recip[table];
+	const uint16_t *dc_code = mjpeg_dc_code[table];
+	const uint8_t *dc_size = mjpeg_dc_size[table];
+	const uint16_t *ac_code = mjpeg_ac_code[table];
+	const uint8_t *ac_size = mjpeg_ac_size[table];
+	int32_t value;
+	uint32_t mag;
+	uint8_t size;
+	uint8_t run = 0;
+	uint8_t i, j;
+
+	// Level shift the samples.
+	for (i = 0; i < 8; i++)
+	{
+		for (j = 0; j < 8; j++)
+		{
+			block[(i * 8) + j] = (int32_t)src[j] - 128;
+		}
+		src += stride;
+	}
+
+	mjpeg_fdct(block);
+
+	// DC coefficient is coded as the difference from the last block.
+	for (i = 0; i < 64; i++)
+	{
+		value = block[mjpeg_zigzag[i]];
+		mag = (value < 0)?-value:value;
+		mag = ((mag * recip[i]) + (1UL << (MJPEG_RECIP_BITS - 1))) >> MJPEG_RECIP_BITS;
+		value = (value < 0)?-(int32_t)mag:(int32_t)mag;
+
+		if (i == 0)
+		{
+			int16_t diff = value - mjpeg_last_dc[comp];
+
+			mjpeg_last_dc[comp] = value;
+			mag = (diff < 0)?-diff:diff;
+			size = mjpeg_bit_size(mag);
+			mjpeg_put_bits(dc_code[size], dc_size[size]);
+			if (size)
+			{
+				mjpeg_put_bits((diff < 0)?(diff - 1):diff, size);
+			}
+			run = 0;
+		}
+		else if (mag == 0)
+		{
+			run++;
+		}
+		else
+		{
+			// Runs of more than 15 zeros are coded with ZRL symbols.
+			while (run > 15)
+			{
+				mjpeg_put_bits(ac_code[0xf0], ac_size[0xf0]);
+				run -= 16;
+			}
+			size = mjpeg_bit_size(mag);
+			mjpeg_put_bits(ac_code[(run << 4) | size], ac_size[(run << 4) | size]);
+			mjpeg_put_bits((value < 0)?(value - 1):value, size);
+			run = 0;
+		}
+	}
+
+	// End of block if the last coefficients were zero.
+	if (run)
+	{
+		mjpeg_put_bits(ac_code[0x00], ac_size[0x00]);
+	}
+}
+
+/** @brief Encode the band of lines.
+ * @details Each 4:2:2 MCU is two luminance blocks followed by one block of
+ * each chrominance component.
+ */
+static void mjpeg_encode_band(void)
+{
+	uint16_t x;
+
+	for (x = 0; x < mjpeg_width; x += 16)
+	{
+		mjpeg_encode_block(&mjpeg_band_y[0][x], MJPEG_MAX_WIDTH, 0);
+		mjpeg_encode_block(&mjpeg_band_y[0][x + 8], MJPEG_MAX_WIDTH, 0);
+		mjpeg_encode_block(&mjpeg_band_cb[0][x / 2], MJPEG_MAX_WIDTH / 2, 1);
+		mjpeg_encode_block(&mjpeg_band_cr[0][x / 2], MJPEG_MAX_WIDTH / 2, 2);
+	}
+}
+
+/* FUNCTIONS ***********************************************************************/
+
+int8_t mjpeg_start(uint16_t width, uint16_t height, uint8_t quality)
+{
+	uint32_t scale;
+	uint32_t q;
+	uint8_t t, i;
+
+	if ((width == 0) || (width > MJPEG_MAX_WIDTH) || (width & 15) ||
+			(height == 0) || (height & (MJPEG_BAND_LINES - 1)))
+	{
+		return -1;
+	}
+
+	mjpeg_width = width;
+	mjpeg_height = height;
+	mjpeg_abort();
+
+	if (mjpeg_huff_ready == 0)
+	{
+		mjpeg_build_huffman(mjpeg_dc_code[0], mjpeg_dc_size[0], mjpeg_dc_lum_bits, mjpeg_dc_vals);
+		mjpeg_build_huffman(mjpeg_dc_code[1], mjpeg_dc_size[1], mjpeg_dc_chrom_bits, mjpeg_dc_vals);
+		mjpeg_build_huffman(mjpeg_ac_code[0], mjpeg_ac_size[0], mjpeg_ac_lum_bits, mjpeg_ac_lum_vals);
+		mjpeg_build_huffman(mjpeg_ac_code[1], mjpeg_ac_size[1], mjpeg_ac_chrom_bits, mjpeg_ac_chrom_vals);
+		mjpeg_huff_ready = 1;
+	}
+
+	if (quality != mjpeg_quality)
+	{
+		// Scale the standard tables as libjpeg does for its quality setting.
+		if (quality < 1) quality = 1;
+		if (quality > 100) quality = 100;
+		scale = (quality < 50)?(5000 / quality):(200 - (quality * 2));
+
+		for (t = 0; t < 2; t++)
+		{
+			for (i = 0; i < 64; i++)
+			{
+				q = ((mjpeg_std_quant[t][mjpeg_zigzag[i]] * scale) + 50) / 100;
+				if (q < 1) q = 1;
+				if (q > 255) q = 255;
+				mjpeg_quant[t][i] = q;
+				mjpeg_recip[t][i] = (1UL << MJPEG_RECIP_BITS) / (q * 8);
+			}
+		}
+		mjpeg_quality = quality;
+	}
+
+	return 0;
+}
+
+uint16_t mjpeg_encode_line(const uint8_t *line)
+{
+	const uint32_t *src = (const uint32_t *)line;
+	uint8_t row = mjpeg_line & (MJPEG_BAND_LINES - 1);
+	uint8_t *y = mjpeg_band_y[row];
+	uint8_t *cb = mjpeg_band_cb[row];
+	uint8_t *cr = mjpeg_band_cr[row];
+	uint32_t pair;
+	uint16_t i;
+
+	// Split a line of YUYV pixel pairs into the band.
+	for (i = mjpeg_width / 2; i > 0; i--)
+	{
+		pair = *src++;
+		*y++ = pair;
+		*cb++ = pair >> 8;
+		*y++ = pair >> 16;
+		*cr++ = pair >> 24;
+	}
+
+	mjpeg_line++;
+	if (row != (MJPEG_BAND_LINES - 1))
+	{
+		return 0;
+	}
+
+	mjpeg_output_len = 0;
+	mjpeg_end = 0;
+	if (mjpeg_line == MJPEG_BAND_LINES)
+	{
+		// First band of the frame.
+		mjpeg_error = 0;
+		mjpeg_bit_buffer = 0;
+		mjpeg_bit_count = 0;
+		mjpeg_last_dc[0] = 0;
+		mjpeg_last_dc[1] = 0;
+		mjpeg_last_dc[2] = 0;
+		mjpeg_put_headers();
+	}
+
+	mjpeg_encode_band();
+
+	if (mjpeg_line >= mjpeg_height)
+	{
+		mjpeg_flush_bits();
+		mjpeg_put_marker(MJPEG_MARKER_EOI);
+		mjpeg_end = 1;
+		mjpeg_line = 0;
+	}
+
+	return mjpeg_output_len;
+}
+
+uint8_t *mjpeg_get_output(void)
+{
+	return mjpeg_output;
+}
+
+uint8_t mjpeg_frame_end(void)
+{
+	return mjpeg_end;
+}
+
+uint8_t mjpeg_frame_error(void)
+{
+	return mjpeg_error;
+}
+
+void mjpeg_abort(void)
+{
+	mjpeg_line = 0;
+	mjpeg_end = 0;
+	mjpeg_output_len = 0;
+}
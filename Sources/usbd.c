@@ -60,6 +60,7 @@
 #include <ft900_interrupt.h>
 #include <ft900_usb.h>
 #include <ft900_usbd.h>
+#include "usbd_stream.h"
 
 /* CONSTANTS ***********************************************************************/
 
@@ -102,6 +103,10 @@
  the FIFOs.
  */
 #define USBD_USE_STREAMS
+#ifndef __FT32__
+// Host builds of the tests have no stream instructions.
+#undef USBD_USE_STREAMS
+#endif // __FT32__
 
 /**
  @brief Enable checking of endpoint configurations.
@@ -433,6 +438,11 @@ __attribute__((weak)) void USBD_pipe_isr(uint16_t pipe_bitfields)
 		if (pipe_bitfields & MASK_USBD_EPIF_IRQ(i))
 		{
 			USBD_ep[i].process++;
+			// Notify the endpoint owner that data has been sent or received.
+			if (USBD_ep[i].cb)
+			{
+				USBD_ep[i].cb(i);
+			}
 		}
 	}
 }
@@ -1126,79 +1136,170 @@ static void usbd_hw_disable(void)
 	delayms(1);
 }
 
+#ifdef USBD_USE_STREAMS
 /**
- @brief \par USB IN Request
+ @brief \par USB IN Request unaligned data
+ @details Writes data which can not be aligned to a longword boundary
+ 	 to the USB hardware a byte at a time. This is kept out of line as it
+ 	 is not expected on the data path for streaming endpoints.
+ **/
+static void __attribute__((noinline)) usbd_in_request_bytes(volatile uint8_t *data_reg,
+		const uint8_t *buffer, size_t length)
+{
+	__asm__ volatile ("streamout.b %0,%1,%2" : :"r"
+			(data_reg), "r"(buffer), "r"(length));
+}
+
+/**
+ @brief \par USB IN stream write
+ @details Writes data to an endpoint FIFO with stream instructions.
+ 	 When the data and the position in the endpoint FIFO are on the
+ 	 same alignment, up to 3 bytes are written to reach a longword
+ 	 boundary and the rest is written with longword stream writes.
+ @param[in] data_reg Endpoint FIFO register.
+ @param[in] buffer Data to write.
+ @param[in] length Number of bytes to write. Must not be zero.
+ @param[in] offset Position of the data in the current packet.
+ **/
+static inline void usbd_in_stream(volatile uint8_t *data_reg,
+		const uint8_t *buffer, size_t length, size_t offset)
+{
+	uint16_t lead = (0 - offset) & 3;
+
+	if (__builtin_expect(((((uint32_t)buffer) + lead) & 3) == 0, 1))
+	{
+		uint16_t aligned;
+		uint16_t left;
+
+		if (lead > length)
+		{
+			lead = length;
+		}
+		if (lead)
+		{
+			__asm__ volatile ("streamout.b %0,%1,%2" : :
+					"r"(data_reg), "r"(buffer), "r"(lead));
+			buffer += lead;
+		}
+
+		aligned = (length - lead) & (~3);
+		left = (length - lead) & 3;
+
+		if (aligned)
+		{
+			__asm__ volatile ("streamout.l %0,%1,%2" : :
+					"r"(data_reg), "r"(buffer), "r"(aligned));
+			buffer += aligned;
+		}
+		if (left)
+		{
+			__asm__ volatile ("streamout.b %0,%1,%2" : :
+					"r"(data_reg), "r"(buffer), "r"(left));
+		}
+	}
+	else
+	{
+		usbd_in_request_bytes(data_reg, buffer, length);
+	}
+}
+#endif // USBD_USE_STREAMS
+
+/**
+ @brief \par USB IN FIFO fill
  @details Writes the data to the USB hardware.
  @param[in] ep Endpoint to send the IN request to.
- @param[in] buffer The command to write to FT122_CMD.
- @param[in] length Number of bytes to read.
+ @param[in] buffer The data to write.
+ @param[in] length Number of bytes to write.
+ @param[in] offset Position of the data in the current packet.
  @return The actual number of bytes written.
  **/
-static int32_t usbd_in_request(uint8_t ep_number, const uint8_t *buffer, size_t length, size_t offset)
+static inline int32_t usbd_in_fill(uint8_t ep_number, const uint8_t *buffer, size_t length, size_t offset)
 {
 	volatile uint8_t *data_reg;
 	int32_t bytes_read = 0;
 
-	CRITICAL_SECTION_BEGIN
-	{
-
 #ifdef USBD_DEBUG_IN_PACKET
-		tfp_printf("IN %d: ", length);
+	tfp_printf("IN %d: ", length);
 #endif // USBD_DEBUG_IN_PACKET
 
 #ifdef USBD_USE_STREAMS
-		data_reg = (uint8_t *)&(USBD->ep[ep_number].epxfifo);
-		if (length)
-		{
-			if (((((uint32_t)buffer) & 3) == 0) && ((offset & 3) == 0))
-			{
-				uint16_t aligned = length & (~3);
-				uint16_t left = length & 3;
-
-				if (aligned)
-				{
-					__asm__ volatile ("streamout.l %0,%1,%2" : :
-							"r"(data_reg), "r"(buffer), "r"(aligned));
-					buffer += aligned;
-				}
-				if (left)
-				{
-					__asm__ volatile ("streamout.b %0,%1,%2" : :
-							"r"(data_reg), "r"(buffer), "r"(left));
-				}
-			}
-			else
-			{
-				__asm__ volatile ("streamout.b %0,%1,%2" : :"r"
-						(data_reg), "r"(buffer), "r"(length));
-			}
-			bytes_read = length;
-		}
+	data_reg = (uint8_t *)&(USBD->ep[ep_number].epxfifo);
+	if (length)
+	{
+		usbd_in_stream(data_reg, buffer, length, offset);
+		bytes_read = length;
+	}
 #else // USBD_USE_STREAMS
 
-	    while (length--)
-		{
+	while (length--)
+	{
 #ifdef USBD_DEBUG_IN_PACKET
-			USBD_EP_FIFO_REG(ep_number) = *buffer;
-			tfp_printf("%x ", *buffer);
-			buffer++;
+		USBD_EP_FIFO_REG(ep_number) = *buffer;
+		tfp_printf("%x ", *buffer);
+		buffer++;
 #else // USBD_DEBUG_IN_PACKET
-			USBD_EP_FIFO_REG(ep_number) = *buffer++;
+		USBD_EP_FIFO_REG(ep_number) = *buffer++;
 #endif // USBD_DEBUG_IN_PACKET
-			bytes_read++;
-		};
+		bytes_read++;
+	};
 
 #endif // USBD_USE_STREAMS
 
 #ifdef USBD_DEBUG_IN_PACKET
-		tfp_printf("\r\n");
+	tfp_printf("\r\n");
 #endif // USBD_DEBUG_IN_PACKET
+
+	return bytes_read;
+}
+
+/**
+ @brief \par USB IN Request
+ @details Writes the data to the USB hardware.
+ 	 Control endpoint data is written with interrupts masked as it is
+ 	 also handled from the USB interrupt. Other endpoints are only
+ 	 written from one context so their FIFO writes can be interrupted.
+ 	 This keeps the camera interrupt from being held off for a whole
+ 	 packet. Only the INPRDY handoff is done with interrupts masked.
+ @param[in] ep Endpoint to send the IN request to.
+ @param[in] buffer The data to write.
+ @param[in] length Number of bytes to write.
+ @param[in] offset Position of the data in the current packet.
+ @return The actual number of bytes written.
+ **/
+static int32_t usbd_in_request(uint8_t ep_number, const uint8_t *buffer, size_t length, size_t offset)
+{
+	int32_t bytes_read;
+
+	if (ep_number != USBD_EP_0)
+	{
+		return usbd_in_fill(ep_number, buffer, length, offset);
+	}
+
+	CRITICAL_SECTION_BEGIN
+	{
+		bytes_read = usbd_in_fill(ep_number, buffer, length, offset);
 	}
 	CRITICAL_SECTION_END;
 
 	return bytes_read;
 }
 
+/**
+ @brief \par USB IN packet ready
+ @details Hands a filled packet buffer to the USB hardware. This is the
+ 	 only part of an IN transfer on a data endpoint which is done with
+ 	 interrupts masked.
+ @param[in] ep Endpoint to send the packet on.
+ **/
+static inline void usbd_in_ready(uint8_t ep_number)
+{
+	CRITICAL_SECTION_BEGIN
+	{
+		USBD_EP_SR_REG(ep_number) = (MASK_USBD_EPxSR_INPRDY);
+	}
+	CRITICAL_SECTION_END;
+}
+
 /**
  @brief \par USB OUT Request
  @details Reads data from the USB hardware.
@@ -2145,7 +2246,7 @@ int32_t /*__attribute__((optimize("O0")))*/ USBD_transfer_ex(USBD_ENDPOINT_NUMBE
 					// endpoint. This is not required.
 					if (USBD_ep[ep_number].type != USBD_EP_INT)
 					{
-						USBD_EP_SR_REG(ep_number) = (MASK_USBD_EPxSR_INPRDY);
+						usbd_in_ready(ep_number);
 						if (part == USBD_TRANSFER_EX_PART_NORMAL)
 						{
 							// Wait for packet to be transmitted, before sending
@@ -2166,13 +2267,13 @@ int32_t /*__attribute__((optimize("O0")))*/ USBD_transfer_ex(USBD_ENDPOINT_NUMBE
 				if (part == USBD_TRANSFER_EX_PART_NORMAL)
 				{
 					// Acknowledge end of packet if flag is set.
-					USBD_EP_SR_REG(ep_number) = (MASK_USBD_EPxSR_INPRDY);
+					usbd_in_ready(ep_number);
 				}
 				break;
 			}
 
 			// There are still more data to send so just set the INPRDY bit.
-			USBD_EP_SR_REG(ep_number) = (MASK_USBD_EPxSR_INPRDY);
+			usbd_in_ready(ep_number);
 		}
 		// Move pointer to next chunk of data to send.
 		pdata += (max_bytes - offset);
@@ -2186,6 +2287,142 @@ int32_t /*__attribute__((optimize("O0")))*/ USBD_transfer_ex(USBD_ENDPOINT_NUMBE
 	return transferred;
 }
 
+int32_t USBD_stream_from_port(USBD_ENDPOINT_NUMBER ep_number,
+		volatile uint32_t *port,
+		size_t length,
+		size_t offset)
+{
+	volatile uint32_t *data_reg;
+	size_t packetLen;
+	size_t max_bytes;
+	size_t i;
+	int32_t transferred = 0;
+
+	CHECK_EP(ep_number);
+
+	// Only whole longwords can be moved from the port.
+	if ((length | offset) & (sizeof(uint32_t) - 1))
+	{
+		return USBD_ERR_INVALID_PARAMETER;
+	}
+
+	max_bytes = USBD_ep_size_bytes(USBD_ep[ep_number].max_packet_size);
+	data_reg = (volatile uint32_t *)&(USBD->ep[ep_number].epxfifo);
+	offset = offset % max_bytes;
+
+	// Fill packet buffers only while one is free.
+	while ((length) && (!(USBD_EP_SR_REG(ep_number) & MASK_USBD_EPxSR_INPRDY)))
+	{
+		packetLen = length;
+		if (packetLen > (max_bytes - offset))
+		{
+			packetLen = (max_bytes - offset);
+		}
+
+		// There is no stream instruction from one port to another so
+		// each longword is moved through a register.
+		for (i = packetLen / sizeof(uint32_t); i > 0; i--)
+		{
+			*data_reg = *port;
+		}
+
+		transferred += packetLen;
+		length -= packetLen;
+		offset += packetLen;
+
+		// Send the packet when it is full.
+		if (offset == max_bytes)
+		{
+			USBD_EP_SR_REG(ep_number) = (MASK_USBD_EPxSR_INPRDY);
+			offset = 0;
+		}
+	}
+
+	return transferred;
+}
+
+int32_t USBD_stream_in(USBD_ENDPOINT_NUMBER ep_number,
+		const USBD_stream_fragment *fragments,
+		uint8_t count,
+		size_t *offset,
+		USBD_STREAM_IN_MODE end)
+{
+	volatile uint8_t *data_reg;
+	const uint8_t *pdata;
+	size_t length;
+	size_t packetLen;
+	size_t max_bytes;
+	size_t pos;
+	int32_t transferred = 0;
+
+	CHECK_EP(ep_number);
+
+	max_bytes = USBD_ep_size_bytes(USBD_ep[ep_number].max_packet_size);
+	data_reg = (volatile uint8_t *)&(USBD->ep[ep_number].epxfifo);
+	pos = *offset;
+
+	for (; count; count--, fragments++)
+	{
+		pdata = fragments->data;
+		length = fragments->length;
+
+		while (length)
+		{
+			// Wait for a free packet buffer before starting a packet.
+			if (pos == 0)
+			{
+				usbd_wait_epx_in_ready(ep_number);
+			}
+
+			packetLen = length;
+			if (packetLen > (max_bytes - pos))
+			{
+				packetLen = (max_bytes - pos);
+			}
+
+#ifdef USBD_USE_STREAMS
+			usbd_in_stream(data_reg, pdata, packetLen, pos);
+#else // USBD_USE_STREAMS
+			for (size_t i = 0; i < packetLen; i++)
+			{
+				USBD_EP_FIFO_REG(ep_number) = pdata[i];
+			}
+#endif // USBD_USE_STREAMS
+
+			pdata += packetLen;
+			length -= packetLen;
+			transferred += packetLen;
+			pos += packetLen;
+
+			// Send the packet when it is full.
+			if (pos == max_bytes)
+			{
+				usbd_in_ready(ep_number);
+				pos = 0;
+			}
+		}
+	}
+
+	if (end != USBD_STREAM_IN_PART)
+	{
+		// A partly filled packet is sent as a short packet. A payload
+		// which ended on a packet boundary may need a zero length packet.
+		if ((pos) || (end == USBD_STREAM_IN_END_ZLP))
+		{
+			if (pos == 0)
+			{
+				usbd_wait_epx_in_ready(ep_number);
+			}
+			usbd_in_ready(ep_number);
+		}
+		pos = 0;
+	}
+
+	*offset = pos;
+
+	return transferred;
+}
+
 int32_t /*__attribute__((optimize("O0")))*/ USBD_transfer_ep0(USBD_ENDPOINT_DIR dir,
 		uint8_t *buffer,
 		size_t dataLength,
@@ -62,6 +62,7 @@
 
 #include "usbd_uvc_v1_1.h"
 #include "camera.h"
+#include "mjpeg.h"
 
 #define BRIDGE_DEBUG
 #ifdef BRIDGE_DEBUG
@@ -72,9 +73,12 @@
 
 /* For MikroC const qualifier will place variables in Flash
  * not just make them constant.
+ * GCC copies const data to RAM at startup. The __flash__ address space
+ * leaves the descriptors in program memory and they are copied to
+ * descriptor_buffer with memcpy_pm2dat when sent to the host.
  */
 #if defined(__GNUC__)
-#define DESCRIPTOR_QUALIFIER const
+#define DESCRIPTOR_QUALIFIER const __flash__
 #elif defined(__MIKROC_PRO_FOR_FT90x__)
 #define DESCRIPTOR_QUALIFIER data
 #endif
@@ -180,6 +184,602 @@ struct UVC_VC_config_descriptor {
 	USB_UVC_VC_ProcessingUnitDescriptor(2) camera_proc_unit;
 };
 
+/**
+ @brief Format indexes and number of formats in the configuration.
+ @details Each output format with one or more camera modes gets a format
+ descriptor. Format indexes are given in the order uncompressed, luma then
+ MJPEG. A format with no modes has a format index of zero.
+ */
+//@{
+#define UVC_FORMAT_INDEX_UNCOMPRESSED (CAMERA_FRAME_COUNT_UNCOMPRESSED > 0)
+#define UVC_FORMAT_INDEX_LUMA ((CAMERA_FRAME_COUNT_LUMA > 0) ? \
+		(UVC_FORMAT_INDEX_UNCOMPRESSED + 1) : 0)
+#define UVC_FORMAT_INDEX_MJPEG ((CAMERA_FRAME_COUNT_MJPEG > 0) ? \
+		(UVC_FORMAT_INDEX_UNCOMPRESSED + (CAMERA_FRAME_COUNT_LUMA > 0) + 1) : 0)
+#define UVC_FORMAT_COUNT (UVC_FORMAT_INDEX_UNCOMPRESSED + \
+		(CAMERA_FRAME_COUNT_LUMA > 0) + (CAMERA_FRAME_COUNT_MJPEG > 0))
+//@}
+
+/**
+ @brief Frame indexes for each camera mode.
+ @details Frame indexes for each format count up from 1 in the order of
+ the CAMERA_MODES_* lists. Each camera mode is named from its format,
+ image size and window.
+ */
+//@{
+#define UVC_FRAME_NAME(format, iw, ih, x, y, w, h) UVC_FRAME_##format##_##iw##_##ih##_##x##_##y##_##w##_##h
+#define UVC_FRAME_ENUM_UNCOMPRESSED(iw, ih, x, y, w, h, frame_rate) UVC_FRAME_NAME(UNCOMPRESSED, iw, ih, x, y, w, h),
+#define UVC_FRAME_ENUM_LUMA(iw, ih, x, y, w, h, frame_rate) UVC_FRAME_NAME(LUMA, iw, ih, x, y, w, h),
+#define UVC_FRAME_ENUM_MJPEG(iw, ih, x, y, w, h, frame_rate) UVC_FRAME_NAME(MJPEG, iw, ih, x, y, w, h),
+
+enum {
+	UVC_FRAME_UNCOMPRESSED_NONE = 0,
+	CAMERA_MODES_UNCOMPRESSED(UVC_FRAME_ENUM_UNCOMPRESSED)
+	UVC_FRAME_LUMA_NONE = 0,
+	CAMERA_MODES_LUMA(UVC_FRAME_ENUM_LUMA)
+	UVC_FRAME_MJPEG_NONE = 0,
+	CAMERA_MODES_MJPEG(UVC_FRAME_ENUM_MJPEG)
+};
+//@}
+
+/**
+ @brief Frame intervals and bit rates for frame descriptors.
+ @details The frame interval is in 100 ns units. Each camera mode is offered
+ at one discrete frame interval for each decimation factor. The minimum bit
+ rate is at the largest decimation factor and the maximum bit rate is at
+ the camera module frame rate.
+ */
+//@{
+#define UVC_FRAME_INTERVAL(decimation, frame_rate) ((10000000UL * (decimation)) / (frame_rate))
+#define UVC_FRAME_INTERVAL_ENTRY(decimation, frame_rate) UVC_FRAME_INTERVAL(decimation, frame_rate),
+#define UVC_FRAME_BIT_RATE(width, height, bbp, interval) \
+		((uint32_t)(((uint64_t)(width) * (height) * (bbp) * 8 * 10000000) / (interval)))
+//@}
+
+/**
+ @brief VideoStreaming frame descriptor.
+ @details MJPEG frame descriptors have the same layout as uncompressed
+ frame descriptors.
+ */
+typedef USB_UVC_VS_UncompressedVideoFrameDescriptorDiscrete(CAMERA_FRAME_DECIMATION_COUNT) UVC_VS_frame_descriptor;
+
+#define UVC_FRAME_DESCRIPTOR(subtype, index, bbp, width, height, frame_rate) \
+		{ \
+				sizeof(UVC_VS_frame_descriptor), /* frame.bLength */ \
+				USB_UVC_DESCRIPTOR_TYPE_CS_INTERFACE, /* frame.bDescriptorType */ \
+				subtype, /* frame.bDescriptorSubType */ \
+				index, /* frame.bFrameIndex */ \
+				0x00, /* frame.bmCapabilities */ \
+				width, /* frame.wWidth */ \
+				height, /* frame.wHeight */ \
+				UVC_FRAME_BIT_RATE(width, height, bbp, \
+						UVC_FRAME_INTERVAL(CAMERA_FRAME_DECIMATION_MAX, frame_rate)), /* frame.dwMinBitRate */ \
+				UVC_FRAME_BIT_RATE(width, height, bbp, \
+						UVC_FRAME_INTERVAL(1, frame_rate)), /* frame.dwMaxBitRate */ \
+				(width) * (height) * (bbp), /* frame.dwMaxVideoFrameBufferSize */ \
+				UVC_FRAME_INTERVAL(1, frame_rate), /* frame.dwDefaultFrameInterval */ \
+				CAMERA_FRAME_DECIMATION_COUNT, /* frame.bFrameIntervalType */ \
+				{CAMERA_FRAME_DECIMATION(UVC_FRAME_INTERVAL_ENTRY, frame_rate)}, /* frame.dwFrameInterval */ \
+		},
+#define UVC_FRAME_UNCOMPRESSED(iw, ih, x, y, w, h, frame_rate) \
+		UVC_FRAME_DESCRIPTOR(USB_UVC_DESCRIPTOR_SUBTYPE_VS_FRAME_UNCOMPRESSED, \
+				UVC_FRAME_NAME(UNCOMPRESSED, iw, ih, x, y, w, h), FORMAT_UC_BBP, w, h, frame_rate)
+#define UVC_FRAME_LUMA(iw, ih, x, y, w, h, frame_rate) \
+		UVC_FRAME_DESCRIPTOR(USB_UVC_DESCRIPTOR_SUBTYPE_VS_FRAME_UNCOMPRESSED, \
+				UVC_FRAME_NAME(LUMA, iw, ih, x, y, w, h), FORMAT_LUMA_BBP, w, h, frame_rate)
+#define UVC_FRAME_MJPEG(iw, ih, x, y, w, h, frame_rate) \
+		UVC_FRAME_DESCRIPTOR(USB_UVC_DESCRIPTOR_SUBTYPE_VS_FRAME_MJPEG, \
+				UVC_FRAME_NAME(MJPEG, iw, ih, x, y, w, h), FORMAT_MJPEG_BBP, w, h, frame_rate)
+
+#define UVC_COLOR_MATCHING_DESCRIPTOR \
+		{ \
+				sizeof(USB_UVC_ColorMatchingDescriptor),  /* desc.bLength */ \
+				USB_UVC_DESCRIPTOR_TYPE_CS_INTERFACE, /* desc.bDescriptorType */ \
+				USB_UVC_DESCRIPTOR_SUBTYPE_VS_COLORFORMAT, /* desc.bDescriptorSubType */ \
+				1, /* desc.bColorPrimaries */ \
+				1, /* desc.bTransferCharacteristics */ \
+				4, /* desc.bMatrixCoefficients */ \
+		}
+
+#define UVC_VS_INTERFACE_DESCRIPTOR(num_endpoints) \
+		{ \
+				sizeof(USB_UVC_VS_StandardInterfaceDescriptor), /* interface_video_stream.bLength */ \
+				USB_DESCRIPTOR_TYPE_INTERFACE, /* interface_video_stream.bDescriptorType */ \
+				1, /* interface_video_stream.bInterfaceNumber */ \
+				0x00, /* interface_video_stream.bAlternateSetting */ \
+				num_endpoints, /* interface_video_stream.bNumEndpoints */ \
+				USB_CLASS_VIDEO, /* interface_video_stream.bInterfaceClass */ \
+				USB_SUBCLASS_VIDEO_VIDEOSTREAMING, /* interface_video_stream.bInterfaceSubClass */ \
+				USB_PROTOCOL_VIDEO_UNDEFINED, /* interface_video_stream.bInterfaceProtocol */ \
+				0x00 /* interface_video_stream.iInterface */ \
+		}
+
+#define UVC_VS_HEADER_DESCRIPTOR(total_length) \
+		{ \
+				sizeof(USB_UVC_VS_CSInterfaceInputHeaderDescriptor(UVC_FORMAT_COUNT)), /* vs_header.bLength */ \
+				USB_UVC_DESCRIPTOR_TYPE_CS_INTERFACE, /* vs_header.bDescriptorType */ \
+				USB_UVC_DESCRIPTOR_SUBTYPE_VS_INPUT_HEADER, /* vs_header.bDescriptorSubType */ \
+				UVC_FORMAT_COUNT, /* vs_header.bNumFormats */ \
+				total_length, /* vs_header.wTotalLength */ \
+				USB_ENDPOINT_DESCRIPTOR_EPADDR_IN | UVC_EP_DATA_IN, /* vs_header.bEndpointAddress */ \
+				0x00, /* vs_header.bmInfo */ \
+				0x03, /* vs_header.bTerminalLink */ \
+				0x00, /* vs_header.bStillCaptureMethod */ \
+				0x00, /* vs_header.bTriggerSupport */ \
+				0x00, /* vs_header.bTriggerUsage */ \
+				0x01, /* vs_header.bControlSize */ \
+				{0x00,}, /* vs_header.bmaControls */ \
+		}
+
+#define UVC_FORMAT_UNCOMPRESSED_DESCRIPTOR(frame_count) \
+		{ \
+				sizeof(USB_UVC_VS_UncompressedVideoFormatDescriptor), /* format.bLength */ \
+				USB_UVC_DESCRIPTOR_TYPE_CS_INTERFACE, /* format.bDescriptorType */ \
+				USB_UVC_DESCRIPTOR_SUBTYPE_VS_FORMAT_UNCOMPRESSED, /* format.bDescriptorSubType */ \
+				UVC_FORMAT_INDEX_UNCOMPRESSED, /* format.bFormatIndex */ \
+				frame_count, /* format.bNumFrameDescriptors */ \
+				PAYLOAD_FORMAT_UNCOMPRESSED, /* format.guidFormat[16] */ \
+				PAYLOAD_BBP_UNCOMPRESSED, /* format.bBitsPerPixel */ \
+				1, /* format.bDefaultFrameIndex */ \
+				FRAME_RATIO_X, /* format.bAspectRatioX */ \
+				FRAME_RATIO_Y, /* format.bAspectRatioY */ \
+				0x00, /* format.bmInterlaceFlags */ \
+				0x00, /* format.bCopyProtect */ \
+		}
+
+#define UVC_FORMAT_LUMA_DESCRIPTOR(frame_count) \
+		{ \
+				sizeof(USB_UVC_VS_UncompressedVideoFormatDescriptor), /* format.bLength */ \
+				USB_UVC_DESCRIPTOR_TYPE_CS_INTERFACE, /* format.bDescriptorType */ \
+				USB_UVC_DESCRIPTOR_SUBTYPE_VS_FORMAT_UNCOMPRESSED, /* format.bDescriptorSubType */ \
+				UVC_FORMAT_INDEX_LUMA, /* format.bFormatIndex */ \
+				frame_count, /* format.bNumFrameDescriptors */ \
+				PAYLOAD_FORMAT_LUMA, /* format.guidFormat[16] */ \
+				PAYLOAD_BBP_LUMA, /* format.bBitsPerPixel */ \
+				1, /* format.bDefaultFrameIndex */ \
+				FRAME_RATIO_X, /* format.bAspectRatioX */ \
+				FRAME_RATIO_Y, /* format.bAspectRatioY */ \
+				0x00, /* format.bmInterlaceFlags */ \
+				0x00, /* format.bCopyProtect */ \
+		}
+
+#define UVC_FORMAT_MJPEG_DESCRIPTOR(frame_count) \
+		{ \
+				sizeof(USB_UVC_VS_MJPEGVideoFormatDescriptor), /* format.bLength */ \
+				USB_UVC_DESCRIPTOR_TYPE_CS_INTERFACE, /* format.bDescriptorType */ \
+				USB_UVC_DESCRIPTOR_SUBTYPE_VS_FORMAT_MJPEG, /* format.bDescriptorSubType */ \
+				UVC_FORMAT_INDEX_MJPEG, /* format.bFormatIndex */ \
+				frame_count, /* format.bNumFrameDescriptors */ \
+				0x00, /* format.bmFlags */ \
+				1, /* format.bDefaultFrameIndex */ \
+				FRAME_RATIO_X, /* format.bAspectRatioX */ \
+				FRAME_RATIO_Y, /* format.bAspectRatioY */ \
+				0x00, /* format.bmInterlaceFlags */ \
+				0x00, /* format.bCopyProtect */ \
+		}
+
+#define UVC_BULK_ENDPOINT_DESCRIPTOR(size) \
+		{ \
+				sizeof(USB_UVC_VS_BulkVideoDataEndpointDescriptor), /* endpoint_bulk_in.bLength */ \
+				USB_DESCRIPTOR_TYPE_ENDPOINT, /* endpoint_bulk_in.bDescriptorType */ \
+				USB_ENDPOINT_DESCRIPTOR_EPADDR_IN | UVC_EP_DATA_IN, /* endpoint_bulk_in.bEndpointAddress */ \
+				USB_ENDPOINT_DESCRIPTOR_ATTR_BULK, /* endpoint_bulk_in.bmAttributes */ \
+				size, /* endpoint_bulk_in.wMaxPacketSize */ \
+				0x00, /* endpoint_bulk_in.bInterval */ \
+		}
+
+/**
+ @brief Class specific VideoStreaming descriptors for Run Time mode.
+ @details The input header is followed by a format descriptor, the frame
+ descriptors and a color matching descriptor for each format which has
+ camera modes.
+ */
+struct PACK UVC_VS_config_descriptor {
+	USB_UVC_VS_CSInterfaceInputHeaderDescriptor(UVC_FORMAT_COUNT) vs_header;
+#if CAMERA_FRAME_COUNT_UNCOMPRESSED > 0
+	USB_UVC_VS_UncompressedVideoFormatDescriptor uncompressed_format;
+	UVC_VS_frame_descriptor uncompressed_frame[CAMERA_FRAME_COUNT_UNCOMPRESSED];
+	USB_UVC_ColorMatchingDescriptor uncompressed_color;
+#endif
+#if CAMERA_FRAME_COUNT_LUMA > 0
+	USB_UVC_VS_UncompressedVideoFormatDescriptor luma_format;
+	UVC_VS_frame_descriptor luma_frame[CAMERA_FRAME_COUNT_LUMA];
+	USB_UVC_ColorMatchingDescriptor luma_color;
+#endif
+#if CAMERA_FRAME_COUNT_MJPEG > 0
+	USB_UVC_VS_MJPEGVideoFormatDescriptor mjpeg_format;
+	UVC_VS_frame_descriptor mjpeg_frame[CAMERA_FRAME_COUNT_MJPEG];
+	USB_UVC_ColorMatchingDescriptor mjpeg_color;
+#endif
+};
+
+/**
+ @brief Class specific VideoStreaming descriptors for Full Speed.
+ @details The same formats as High Speed with only the Full Speed camera
+ modes. The format indexes must be the same at both speeds.
+ */
+#if ((CAMERA_FRAME_COUNT_UNCOMPRESSED > 0) != (CAMERA_FRAME_COUNT_UNCOMPRESSED_FS > 0)) || \
+	((CAMERA_FRAME_COUNT_LUMA > 0) != (CAMERA_FRAME_COUNT_LUMA_FS > 0)) || \
+	((CAMERA_FRAME_COUNT_MJPEG > 0) != (CAMERA_FRAME_COUNT_MJPEG_FS > 0))
+#error Every format with camera modes needs at least one Full Speed mode.
+#endif
+struct PACK UVC_VS_config_descriptor_fs {
+	USB_UVC_VS_CSInterfaceInputHeaderDescriptor(UVC_FORMAT_COUNT) vs_header;
+#if CAMERA_FRAME_COUNT_UNCOMPRESSED_FS > 0
+	USB_UVC_VS_UncompressedVideoFormatDescriptor uncompressed_format;
+	UVC_VS_frame_descriptor uncompressed_frame[CAMERA_FRAME_COUNT_UNCOMPRESSED_FS];
+	USB_UVC_ColorMatchingDescriptor uncompressed_color;
+#endif
+#if CAMERA_FRAME_COUNT_LUMA_FS > 0
+	USB_UVC_VS_UncompressedVideoFormatDescriptor luma_format;
+	UVC_VS_frame_descriptor luma_frame[CAMERA_FRAME_COUNT_LUMA_FS];
+	USB_UVC_ColorMatchingDescriptor luma_color;
+#endif
+#if CAMERA_FRAME_COUNT_MJPEG_FS > 0
+	USB_UVC_VS_MJPEGVideoFormatDescriptor mjpeg_format;
+	UVC_VS_frame_descriptor mjpeg_frame[CAMERA_FRAME_COUNT_MJPEG_FS];
+	USB_UVC_ColorMatchingDescriptor mjpeg_color;
+#endif
+};
+
+#ifdef USB_ENDPOINT_USE_ISOC
+/**
+ @brief Isochronous alternate setting of the VideoStreaming interface.
+ */
+struct PACK UVC_VS_isoc_alt_descriptor {
+	USB_UVC_VS_StandardInterfaceDescriptor interface_video_stream;
+	USB_UVC_VS_IsochronousVideoDataEndpointDescriptor endpoint_isoc_in;
+};
+
+#define UVC_ISOC_ALT_DESCRIPTOR(alt, size) \
+		{ \
+				{ \
+						sizeof(USB_UVC_VS_StandardInterfaceDescriptor), /* interface_video_stream.bLength */ \
+						USB_DESCRIPTOR_TYPE_INTERFACE, /* interface_video_stream.bDescriptorType */ \
+						1, /* interface_video_stream.bInterfaceNumber */ \
+						alt, /* interface_video_stream.bAlternateSetting */ \
+						0x01, /* interface_video_stream.bNumEndpoints */ \
+						USB_CLASS_VIDEO, /* interface_video_stream.bInterfaceClass */ \
+						USB_SUBCLASS_VIDEO_VIDEOSTREAMING, /* interface_video_stream.bInterfaceSubClass */ \
+						USB_PROTOCOL_VIDEO_UNDEFINED, /* interface_video_stream.bInterfaceProtocol */ \
+						0x00 /* interface_video_stream.iInterface */ \
+				}, \
+				{ \
+						sizeof(USB_UVC_VS_IsochronousVideoDataEndpointDescriptor), /* endpoint_isoc_in.bLength */ \
+						USB_DESCRIPTOR_TYPE_ENDPOINT, /* endpoint_isoc_in.bDescriptorType */ \
+						USB_ENDPOINT_DESCRIPTOR_EPADDR_IN | UVC_EP_DATA_IN, /* endpoint_isoc_in.bEndpointAddress */ \
+						USB_ENDPOINT_DESCRIPTOR_ATTR_ISOCHRONOUS, /* endpoint_isoc_in.bmAttributes */ \
+						size, /* endpoint_isoc_in.wMaxPacketSize */ \
+						0x01, /* endpoint_isoc_in.bInterval */ \
+				}, \
+		},
+#endif // USB_ENDPOINT_USE_ISOC
+
+/**
+ @brief VideoControl part of the configuration descriptor.
+ @details This is the same for High Speed and Full Speed.
+ */
+struct PACK UVC_config_descriptor_vc {
+	USB_configuration_descriptor configuration;
+	USB_UVC_interface_association_descriptor interface_association;
+	USB_UVC_VC_StandardInterfaceDescriptor interface_video_control;
+	struct UVC_VC_config_descriptor vc;
+	USB_UVC_VC_StandardInterruptEndpointDescriptor endpoint_int_in;
+	USB_UVC_VC_CSEndpointDescriptor endpoint_int_descriptor;
+};
+
+#ifdef USB_INTERFACE_USE_DFU
+#define UVC_CONFIG_INTERFACES 0x03
+#else // !USB_INTERFACE_USE_DFU
+#define UVC_CONFIG_INTERFACES 0x02
+#endif // USB_INTERFACE_USE_DFU
+
+#define UVC_CONFIG_DESCRIPTOR_VC(total_length) \
+		{ \
+				{ \
+						sizeof(USB_configuration_descriptor), /* configuration.bLength */ \
+						USB_DESCRIPTOR_TYPE_CONFIGURATION, /* configuration.bDescriptorType */ \
+						total_length, /* configuration.wTotalLength */ \
+						UVC_CONFIG_INTERFACES, /* configuration.bNumInterfaces */ \
+						0x01, /* configuration.bConfigurationValue */ \
+						0x00, /* configuration.iConfiguration */ \
+						USB_CONFIG_BMATTRIBUTES_VALUE, /* configuration.bmAttributes */ \
+						0x00, /* configuration.bMaxPower */ /* 0mA */ \
+				}, \
+				{ \
+						sizeof(USB_UVC_interface_association_descriptor), /* interface_association.bLength */ \
+						USB_DESCRIPTOR_TYPE_INTERFACE_ASSOCIATION, /* interface_association.bDescriptorType */ \
+						0, /* interface_association.bFirstInterface */ \
+						2, /* interface_association.bInterfaceCount */ \
+						USB_CLASS_VIDEO, /* interface_association.bFunctionClass */ \
+						USB_SUBCLASS_VIDEO_INTERFACE_COLLECTION, /* interface_association.bFunctionSubClass */ \
+						USB_PROTOCOL_VIDEO_UNDEFINED, /* interface_association.bFunctionProtocol */ \
+						2, /* interface_association.iFunction */ \
+				}, \
+				{ \
+						sizeof(USB_UVC_VC_StandardInterfaceDescriptor), /* interface_video_control.bLength */ \
+						USB_DESCRIPTOR_TYPE_INTERFACE, /* interface_video_control.bDescriptorType */ \
+						0, /* interface_video_control.bInterfaceNumber */ \
+						0x00, /* interface_video_control.bAlternateSetting */ \
+						0x01, /* interface_video_control.bNumEndpoints */ \
+						USB_CLASS_VIDEO, /* interface_video_control.bInterfaceClass */ \
+						USB_SUBCLASS_VIDEO_VIDEOCONTROL, /* interface_video_control.bInterfaceSubClass */ \
+						USB_PROTOCOL_VIDEO_UNDEFINED, /* interface_video_control.bInterfaceProtocol */ \
+						2, /* interface_video_control.iInterface */ /* Same as IAD iFunction. */ \
+				}, \
+				{ \
+						{ \
+								sizeof(USB_UVC_VC_CSInterfaceHeaderDescriptor(1)), /* vc_header.bLength */ \
+								USB_UVC_DESCRIPTOR_TYPE_CS_INTERFACE, /* vc_header.bDescriptorType */ \
+								USB_UVC_DESCRIPTOR_SUBTYPE_VC_HEADER, /* vc_header.bDescriptorSubtype */ \
+								(USB_VIDEO_CLASS_VERSION_MAJOR << 8) | (USB_VIDEO_CLASS_VERSION_MINOR << 4), /* vc_header.bcdUVC */ \
+								sizeof(struct UVC_VC_config_descriptor), /* vc_header.wTotalLength */ \
+								CLK_FREQ_SOURCE_CLOCK, /* vc_header.dwClockFrequency */ \
+								0x01, /* vc_header.bInCollection */ \
+								{0x01,} /* vc_header.baInterfaceNr */ \
+						}, \
+						{ \
+								sizeof(USB_UVC_VC_CameraTerminalDescriptor(2)), /* camera_input.bLength */ \
+								USB_UVC_DESCRIPTOR_TYPE_CS_INTERFACE, /* camera_input.bDescriptorType */ \
+								USB_UVC_DESCRIPTOR_SUBTYPE_VC_INPUT_TERMINAL, /* camera_input.bDescriptorSubtype */ \
+								ENTITY_ID_CAMERA, /* camera_input.bTerminalID */ \
+								USB_UVC_ITT_CAMERA, /* camera_input.wTerminalType */ \
+								0x00, /* camera_input.bAssocTerminal */ \
+								0x00, /* camera_input.iTerminal */ \
+								0x0000, /* camera_input.wObjectiveFocalLengthMin */ \
+								0x0000, /* camera_input.wObjectiveFocalLengthMax */ \
+								0x0000, /* camera_input.wOcularFocalLength */ \
+								0x02, /* camera_input.bControlSize */ \
+								{0x00, 0x00,}, /* camera_input.bmControls[2] */ \
+						}, \
+						{ \
+								sizeof(USB_UVC_VC_OutputTerminalDescriptor), /* camera_output.bLength */ \
+								USB_UVC_DESCRIPTOR_TYPE_CS_INTERFACE, /* camera_output.bDescriptorType */ \
+								USB_UVC_DESCRIPTOR_SUBTYPE_VC_OUTPUT_TERMINAL, /* camera_output.bDescriptorSubtype */ \
+								ENTITY_ID_OUTPUT, /* camera_output.bTerminalID */ \
+								USB_UVC_TT_STREAMING, /* camera_output.wTerminalType */ \
+								0x00, /* camera_output.bAssocTerminal */ \
+								ENTITY_ID_PROCESSING, /* camera_output.bSourceID */ \
+								0x00, /* camera_output.iTerminal */ \
+						}, \
+						{ \
+								sizeof(USB_UVC_VC_ProcessingUnitDescriptor(2)), /* camera_proc_unit.bLength */ \
+								USB_UVC_DESCRIPTOR_TYPE_CS_INTERFACE, /* camera_proc_unit.bDescriptorType */ \
+								USB_UVC_DESCRIPTOR_SUBTYPE_VC_PROCESSING_UNIT, /* camera_proc_unit.bDescriptorSubtype */ \
+								ENTITY_ID_PROCESSING, /* camera_proc_unit.bUnitID */ \
+								ENTITY_ID_CAMERA, /* camera_proc_unit.bSourceID */ \
+								0x0000, /* camera_proc_unit.wMaxMultiplier */ \
+								0x02, /* camera_proc_unit.bControlSize */ \
+								{0x00, 0x00,}, /* camera_proc_unit.bmControls[2] */ \
+								0x00, /* camera_proc_unit.iProcessing */ \
+						}, \
+				}, \
+				{ \
+						sizeof(USB_UVC_VC_StandardInterruptEndpointDescriptor), /* endpoint_int_in.bLength */ \
+						USB_DESCRIPTOR_TYPE_ENDPOINT, /* endpoint_int_in.bDescriptorType */ \
+						USB_ENDPOINT_DESCRIPTOR_EPADDR_IN | UVC_EP_INTERRUPT, /* endpoint_int_in.bEndpointAddress */ \
+						USB_ENDPOINT_DESCRIPTOR_ATTR_INTERRUPT, /* endpoint_int_in.bmAttributes */ \
+						UVC_INTERRUPT_EP_SIZE, /* endpoint_int_in.wMaxPacketSize */ \
+						0x08, /* endpoint_int_in.bInterval */ \
+				}, \
+				{ \
+						sizeof(USB_UVC_VC_CSEndpointDescriptor), /* endpoint_int_descriptor.bLength */ \
+						USB_UVC_DESCRIPTOR_TYPE_CS_ENDPOINT, /* endpoint_int_descriptor.bDescriptorType */ \
+						USB_UVC_DESCRIPTOR_SUBTYPE_EP_INTERRUPT, /* endpoint_int_descriptor.bDescriptorSubType */ \
+						UVC_INTERRUPT_EP_SIZE, /* endpoint_int_descriptor.wMaxTransferSize */ \
+				}, \
+		}
+
+#ifdef USB_INTERFACE_USE_DFU
+#define UVC_CONFIG_DESCRIPTOR_DFU \
+		{ \
+				sizeof(USB_interface_descriptor), /* dfu_interface.bLength */ \
+				USB_DESCRIPTOR_TYPE_INTERFACE, /* dfu_interface.bDescriptorType */ \
+				DFU_USB_INTERFACE_RUNTIME, /* dfu_interface.bInterfaceNumber */ \
+				0x00, /* dfu_interface.bAlternateSetting */ \
+				0x00, /* dfu_interface.bNumEndpoints */ \
+				USB_CLASS_APPLICATION, /* dfu_interface.bInterfaceClass */ \
+				USB_SUBCLASS_DFU, /* dfu_interface.bInterfaceSubClass */ \
+				USB_PROTOCOL_DFU_RUNTIME, /* dfu_interface.bInterfaceProtocol */ \
+				0x05 /* dfu_interface.iInterface */ /* "DFU Interface" */ \
+		}, \
+		{ \
+				sizeof(USB_dfu_functional_descriptor), /* dfu_functional.bLength */ \
+				USB_DESCRIPTOR_TYPE_DFU_FUNCTIONAL, /* dfu_functional.bDescriptorType */ \
+				DFU_ATTRIBUTES, /* dfu_functional.bmAttributes */ \
+				DFU_TIMEOUT, /* dfu_functional.wDetatchTimeOut */ \
+				DFU_TRANSFER_SIZE, /* dfu_functional.wTransferSize */ \
+				USB_BCD_VERSION_DFU_1_1 /* dfu_functional.bcdDfuVersion */ \
+		},
+#endif // USB_INTERFACE_USE_DFU
+
+/**
+ @brief Configuration descriptors for Run Time mode.
+ @details These are made at compile time from the camera mode lists. The
+ Full Speed configuration offers only the Full Speed camera modes on a
+ smaller data endpoint.
+ Both are left unchanged. The descriptor for the other speed has its
+ bDescriptorType changed in the copy in descriptor_buffer.
+ */
+//@{
+struct PACK UVC_config_descriptor_hs {
+	struct UVC_config_descriptor_vc control;
+	USB_UVC_VS_StandardInterfaceDescriptor interface_video_stream;
+	struct UVC_VS_config_descriptor vs;
+#ifndef USB_ENDPOINT_USE_ISOC
+	USB_UVC_VS_BulkVideoDataEndpointDescriptor endpoint_bulk_in;
+#else // !USB_ENDPOINT_USE_ISOC
+	struct UVC_VS_isoc_alt_descriptor isoc_alt[UVC_ISOC_ALT_COUNT];
+#endif // USB_ENDPOINT_USE_ISOC
+#ifdef USB_INTERFACE_USE_DFU
+	USB_interface_descriptor dfu_interface;
+	USB_dfu_functional_descriptor dfu_functional;
+#endif // USB_INTERFACE_USE_DFU
+};
+
+struct PACK UVC_config_descriptor_fs {
+	struct UVC_config_descriptor_vc control;
+	USB_UVC_VS_StandardInterfaceDescriptor interface_video_stream;
+	struct UVC_VS_config_descriptor_fs vs;
+#ifndef USB_ENDPOINT_USE_ISOC
+	USB_UVC_VS_BulkVideoDataEndpointDescriptor endpoint_bulk_in;
+#else // !USB_ENDPOINT_USE_ISOC
+	struct UVC_VS_isoc_alt_descriptor isoc_alt[UVC_ISOC_ALT_COUNT];
+#endif // USB_ENDPOINT_USE_ISOC
+#ifdef USB_INTERFACE_USE_DFU
+	USB_interface_descriptor dfu_interface;
+	USB_dfu_functional_descriptor dfu_functional;
+#endif // USB_INTERFACE_USE_DFU
+};
+
+DESCRIPTOR_QUALIFIER struct UVC_config_descriptor_hs config_descriptor_hs =
+{
+		UVC_CONFIG_DESCRIPTOR_VC(sizeof(struct UVC_config_descriptor_hs)),
+
+		// ---- Standard Video Streaming Interface Descriptor ----
+#ifdef USB_ENDPOINT_USE_ISOC
+		UVC_VS_INTERFACE_DESCRIPTOR(0x00),
+#else // !USB_ENDPOINT_USE_ISOC
+		UVC_VS_INTERFACE_DESCRIPTOR(0x01),
+#endif // USB_ENDPOINT_USE_ISOC
+
+		{
+				// ---- Class-specific Video Streaming Input Header Descriptor ----
+				UVC_VS_HEADER_DESCRIPTOR(sizeof(struct UVC_VS_config_descriptor)),
+
+#if CAMERA_FRAME_COUNT_UNCOMPRESSED > 0
+				// ---- Class specific Uncompressed VS Format Descriptor ----
+				UVC_FORMAT_UNCOMPRESSED_DESCRIPTOR(CAMERA_FRAME_COUNT_UNCOMPRESSED),
+				// ---- Class specific VS Frame Descriptors ----
+				{
+						CAMERA_MODES_UNCOMPRESSED(UVC_FRAME_UNCOMPRESSED)
+				},
+				// ---- Class specific Color Matching Descriptor ----
+				UVC_COLOR_MATCHING_DESCRIPTOR,
+#endif
+
+#if CAMERA_FRAME_COUNT_LUMA > 0
+				// ---- Class specific Luma VS Format Descriptor ----
+				UVC_FORMAT_LUMA_DESCRIPTOR(CAMERA_FRAME_COUNT_LUMA),
+				// ---- Class specific VS Frame Descriptors ----
+				{
+						CAMERA_MODES_LUMA(UVC_FRAME_LUMA)
+				},
+				// ---- Class specific Color Matching Descriptor ----
+				UVC_COLOR_MATCHING_DESCRIPTOR,
+#endif
+
+#if CAMERA_FRAME_COUNT_MJPEG > 0
+				// ---- Class specific MJPEG VS Format Descriptor ----
+				UVC_FORMAT_MJPEG_DESCRIPTOR(CAMERA_FRAME_COUNT_MJPEG),
+				// ---- Class specific VS Frame Descriptors ----
+				{
+						CAMERA_MODES_MJPEG(UVC_FRAME_MJPEG)
+				},
+				// ---- Class specific Color Matching Descriptor ----
+				UVC_COLOR_MATCHING_DESCRIPTOR,
+#endif
+		},
+
+#ifndef USB_ENDPOINT_USE_ISOC
+		// ---- ENDPOINT DESCRIPTOR ----
+		UVC_BULK_ENDPOINT_DESCRIPTOR(UVC_DATA_EP_SIZE_HS),
+#else // !USB_ENDPOINT_USE_ISOC
+		// One alternate setting for each isochronous bandwidth.
+		{
+				UVC_ISOC_ALT_SIZES(UVC_ISOC_ALT_DESCRIPTOR)
+		},
+#endif // USB_ENDPOINT_USE_ISOC
+
+#ifdef USB_INTERFACE_USE_DFU
+		// ---- INTERFACE and FUNCTIONAL DESCRIPTORS for DFU Interface ----
+		UVC_CONFIG_DESCRIPTOR_DFU
+#endif // USB_INTERFACE_USE_DFU
+};
+
+DESCRIPTOR_QUALIFIER struct UVC_config_descriptor_fs config_descriptor_fs =
+{
+		UVC_CONFIG_DESCRIPTOR_VC(sizeof(struct UVC_config_descriptor_fs)),
+
+		// ---- Standard Video Streaming Interface Descriptor ----
+#ifdef USB_ENDPOINT_USE_ISOC
+		UVC_VS_INTERFACE_DESCRIPTOR(0x00),
+#else // !USB_ENDPOINT_USE_ISOC
+		UVC_VS_INTERFACE_DESCRIPTOR(0x01),
+#endif // USB_ENDPOINT_USE_ISOC
+
+		{
+				// ---- Class-specific Video Streaming Input Header Descriptor ----
+				UVC_VS_HEADER_DESCRIPTOR(sizeof(struct UVC_VS_config_descriptor_fs)),
+
+#if CAMERA_FRAME_COUNT_UNCOMPRESSED_FS > 0
+				// ---- Class specific Uncompressed VS Format Descriptor ----
+				UVC_FORMAT_UNCOMPRESSED_DESCRIPTOR(CAMERA_FRAME_COUNT_UNCOMPRESSED_FS),
+				// ---- Class specific VS Frame Descriptors ----
+				{
+						CAMERA_MODES_UNCOMPRESSED_FS(UVC_FRAME_UNCOMPRESSED)
+				},
+				// ---- Class specific Color Matching Descriptor ----
+				UVC_COLOR_MATCHING_DESCRIPTOR,
+#endif
+
+#if CAMERA_FRAME_COUNT_LUMA_FS > 0
+				// ---- Class specific Luma VS Format Descriptor ----
+				UVC_FORMAT_LUMA_DESCRIPTOR(CAMERA_FRAME_COUNT_LUMA_FS),
+				// ---- Class specific VS Frame Descriptors ----
+				{
+						CAMERA_MODES_LUMA_FS(UVC_FRAME_LUMA)
+				},
+				// ---- Class specific Color Matching Descriptor ----
+				UVC_COLOR_MATCHING_DESCRIPTOR,
+#endif
+
+#if CAMERA_FRAME_COUNT_MJPEG_FS > 0
+				// ---- Class specific MJPEG VS Format Descriptor ----
+				UVC_FORMAT_MJPEG_DESCRIPTOR(CAMERA_FRAME_COUNT_MJPEG_FS),
+				// ---- Class specific VS Frame Descriptors ----
+				{
+						CAMERA_MODES_MJPEG_FS(UVC_FRAME_MJPEG)
+				},
+				// ---- Class specific Color Matching Descriptor ----
+				UVC_COLOR_MATCHING_DESCRIPTOR,
+#endif
+		},
+
+#ifndef USB_ENDPOINT_USE_ISOC
+		// ---- ENDPOINT DESCRIPTOR ----
+		UVC_BULK_ENDPOINT_DESCRIPTOR(UVC_DATA_EP_SIZE_FS),
+#else // !USB_ENDPOINT_USE_ISOC
+		// One alternate setting for each isochronous bandwidth.
+		{
+				UVC_ISOC_ALT_SIZES_FS(UVC_ISOC_ALT_DESCRIPTOR)
+		},
+#endif // USB_ENDPOINT_USE_ISOC
+
+#ifdef USB_INTERFACE_USE_DFU
+		// ---- INTERFACE and FUNCTIONAL DESCRIPTORS for DFU Interface ----
+		UVC_CONFIG_DESCRIPTOR_DFU
+#endif // USB_INTERFACE_USE_DFU
+};
+//@}
+
+/**
+ @brief Descriptor being sent to the host.
+ @details Descriptors are in program memory and are copied here before
+ they are sent. Only the bytes requested by the host are copied. It is
+ large enough for the largest configuration descriptor.
+ */
+static uint8_t descriptor_buffer[
+		(sizeof(config_descriptor_hs) > sizeof(config_descriptor_fs)) ?
+				sizeof(config_descriptor_hs) : sizeof(config_descriptor_fs)] __attribute__((aligned(4)));
+
+/**
+ @brief Camera module ID shown in the serial number string.
+ @details The serial number string descriptor is in program memory so
+ the ID is written into the copy sent to the host.
+ */
+static uint16_t serial_module = 0;
+
 #ifdef USB_INTERFACE_USE_DFU
 /**
  @name wcid_feature_runtime
@@ -297,22 +897,76 @@ DESCRIPTOR_QUALIFIER USB_WCID_feature_descriptor wcid_feature_dfumode =
 
 /* LOCAL VARIABLES *****************************************************************/
 
-/**
- @brief Configuration Descriptors.
- @details Configuration descriptors may need to be modified to turn from type
- USB_DESCRIPTOR_TYPE_CONFIGURATION to USB_DESCRIPTOR_TYPE_OTHER_SPEED_CONFIGURATION.
- These structures are defined programmatically depending on the modes that the
- camera interface adds.
- */
-char *config_descriptor_buffer_hs;
-char *config_descriptor_buffer_fs;
-
 /**
  @brief Active Alternate Setting
  @details Current active alternate setting for the USB interface.
  */
 static uint8_t usb_alt = 0;
 
+#ifdef USB_ENDPOINT_USE_ISOC
+/**
+ @brief Isochronous alternate setting packet sizes
+ @details Entry n is the wMaxPacketSize of the endpoint in alternate
+ setting n + 1 of the video streaming interface. There is one table for
+ each bus speed.
+ */
+//@{
+#define UVC_ISOC_ALT_SIZE_ENTRY(alt, size) (size),
+static const uint16_t uvc_isoc_alt_size_hs[UVC_ISOC_ALT_COUNT] = {
+		UVC_ISOC_ALT_SIZES(UVC_ISOC_ALT_SIZE_ENTRY)
+};
+static const uint16_t uvc_isoc_alt_size_fs[UVC_ISOC_ALT_COUNT] = {
+		UVC_ISOC_ALT_SIZES_FS(UVC_ISOC_ALT_SIZE_ENTRY)
+};
+/// Table for the current bus speed. Set when the device connects.
+static const uint16_t *uvc_isoc_alt_size = uvc_isoc_alt_size_hs;
+//@}
+#endif // USB_ENDPOINT_USE_ISOC
+
+/**
+ @brief Video data endpoint interrupt count
+ @details Incremented by the endpoint callback each time the host takes
+ a packet from the video data endpoint. Read by the main loop to tell
+ when there is space to write more data to the endpoint.
+ */
+//@{
+static volatile uint8_t uvc_data_ep_count = 0;
+static uint8_t uvc_data_ep_seen = 0;
+//@}
+
+/**
+ @brief Mode the camera was last set up for
+ @details Recorded by class_vs_set_commit when the camera is set up. A
+ commit of the same mode while the camera is running restarts the stream
+ without setting up the camera again. With isochronous endpoints the
+ camera module is also not set up again when alternate setting zero has
+ stopped the camera.
+ */
+//@{
+static uint8_t uvc_running_format = CAMERA_FORMAT_ANY;
+static uint8_t uvc_running_frame = 0;
+static uint32_t uvc_running_interval = 0;
+static uint16_t uvc_running_sample = 0;
+//@}
+
+#ifdef USB_ENDPOINT_USE_ISOC
+/**
+ @brief Isochronous service interval tracking
+ @details The SOF callback counts each SOF so that the main loop can
+ refill the endpoint once per (micro)frame. If the host took no packet
+ from the video data endpoint during the last (micro)frame while the
+ main loop had data waiting to be sent then the service interval was
+ missed.
+ */
+//@{
+static volatile uint8_t uvc_sof_count = 0;
+static uint8_t uvc_sof_seen = 0;
+static uint8_t uvc_sof_ep_count = 0;
+static volatile uint8_t uvc_data_pending = 0;
+static volatile uint32_t uvc_missed_microframes = 0;
+//@}
+#endif // USB_ENDPOINT_USE_ISOC
+
 /** @brief Error control generated from UVC requests.
  */
 uint8_t uvc_error_control = USB_UVC_REQUEST_ERROR_CODE_CONTROL_NO_ERROR;
@@ -331,9 +985,10 @@ USB_UVC_VideoProbeAndCommitControls uvc_probe;
  */
 USB_UVC_VideoProbeAndCommitControls uvc_commit;
 
-/** @brief Default state used at start of negotiation. High-speed.
+/** @brief Default state used at start of negotiation.
+ *  @details Set up for the current bus speed when the device connects.
  */
-USB_UVC_VideoProbeAndCommitControls uvc_probe_def_hs = {
+USB_UVC_VideoProbeAndCommitControls uvc_probe_def = {
 		USB_UVC_VS_PROBE_COMMIT_CONTROL_BMHINT_FRAMINGINFO, /* bmHint */
 		1, /*  bFormatIndex */
 		1, /*  bFrameIndex */
@@ -344,8 +999,8 @@ USB_UVC_VideoProbeAndCommitControls uvc_probe_def_hs = {
 		0, /*  wCompWindowSize */
 		0, /*  wDelay */
 		0, /*  dwMaxVideoFrameSize */
-		sizeof(USB_UVC_Payload_Header), /*  dwMaxPayloadTransferSize */
-		CLK_FREQ_48MHz,    /*  dwClockFrequency */
+		sizeof(USB_UVC_Payload_Header_PTS_SCR), /*  dwMaxPayloadTransferSize */
+		CLK_FREQ_SOURCE_CLOCK,    /*  dwClockFrequency */
 		USB_UVC_VS_PROBE_COMMIT_CONTROL_BMFRAMINGINFO_FRAMEIDFIELD |
 		USB_UVC_VS_PROBE_COMMIT_CONTROL_BMFRAMINGINFO_EOFFIELD, /*  bmFramingInfo */
 		USB_VIDEO_CLASS_VERSION_MINOR, /*  bPreferedVersion */
@@ -358,14 +1013,185 @@ USB_UVC_VideoProbeAndCommitControls uvc_probe_def_hs = {
  */
 USBD_DEVICE_SPEED usb_speed;
 
-/** @brief Format index for uncompressed streams.
- */
-uint8_t uvc_format_index_uncompressed = 0;
-
 /* MACROS **************************************************************************/
 
 /* LOCAL FUNCTIONS / INLINES *******************************************************/
 
+/**
+ @brief      Map a format index to a camera format
+ @details    Returns the CAMERA_FORMAT_* value for a bFormatIndex from a
+ 	 	 	 probe or commit request or CAMERA_FORMAT_ANY if the format
+ 	 	 	 index is not valid.
+ **/
+static uint8_t class_vs_camera_format(uint8_t bFormatIndex)
+{
+	if (bFormatIndex)
+	{
+		if (bFormatIndex == UVC_FORMAT_INDEX_UNCOMPRESSED)
+		{
+			return CAMERA_FORMAT_UNCOMPRESSED;
+		}
+		if (bFormatIndex == UVC_FORMAT_INDEX_LUMA)
+		{
+			return CAMERA_FORMAT_LUMA;
+		}
+		if (bFormatIndex == UVC_FORMAT_INDEX_MJPEG)
+		{
+			return CAMERA_FORMAT_MJPEG;
+		}
+	}
+	return CAMERA_FORMAT_ANY;
+}
+
+/**
+ @brief      Number of frame indexes for a camera format
+ @details    At Full Speed only the first frame indexes of each format
+ 	 	 	 are offered.
+ **/
+static uint8_t class_vs_frame_count(uint8_t format)
+{
+	if (usb_speed == USBD_SPEED_HIGH)
+	{
+		return camera_mode_get_frame_count(format);
+	}
+	return usb_uvc_get_frame_count_fs(format);
+}
+
+/**
+ @brief      Bytes per pixel for a camera format
+ **/
+static uint8_t class_vs_format_bbp(uint8_t format)
+{
+	if (format == CAMERA_FORMAT_LUMA)
+	{
+		return FORMAT_LUMA_BBP;
+	}
+	if (format == CAMERA_FORMAT_MJPEG)
+	{
+		return FORMAT_MJPEG_BBP;
+	}
+	return FORMAT_UC_BBP;
+}
+
+#ifdef USB_ENDPOINT_USE_ISOC
+/**
+ @brief      Isochronous alternate setting for a frame
+ @details    Finds the smallest alternate setting which can carry the
+ 	 	 	 frame at the frame rate. One payload is sent in each
+ 	 	 	 (micro)frame so each payload must carry the average data rate
+ 	 	 	 with 25% headroom to drain the camera buffer.
+ @param[out] sample Camera buffer sample size sent in each payload. This
+ 	 	 	 is not used for MJPEG.
+ @returns    Alternate setting number or zero if no alternate setting is
+ 	 	 	 large enough. The sample is then that of the largest.
+ **/
+static uint8_t class_vs_isoc_alt(uint8_t format, uint8_t frame, uint32_t interval,
+		uint16_t *sample)
+{
+	uint16_t width, height;
+	uint32_t rate;
+	uint16_t payload = 0;
+	uint8_t alt;
+
+	// Bytes per (micro)frame. The frame interval is in 100 ns units and
+	// there are 1250 of these in a microframe and 10000 in a frame.
+	camera_mode_get_frame(format, frame, &width, &height);
+	rate = (uint32_t)width * height * class_vs_format_bbp(format) *
+			((usb_speed == USBD_SPEED_HIGH) ? 1250 : 10000);
+	rate = (rate + interval - 1) / interval;
+	rate = rate + ((rate + 3) >> 2);
+
+	for (alt = 1; alt <= UVC_ISOC_ALT_COUNT; alt++)
+	{
+		payload = uvc_isoc_alt_size[alt - 1] - sizeof(USB_UVC_Payload_Header_PTS_SCR);
+		if (format != CAMERA_FORMAT_MJPEG)
+		{
+			payload = camera_mode_get_sample_size(format, frame, payload);
+		}
+		if (payload >= rate)
+		{
+			break;
+		}
+	}
+	if (alt > UVC_ISOC_ALT_COUNT)
+	{
+		alt = 0;
+	}
+
+	*sample = payload;
+	return alt;
+}
+
+/**
+ @brief      Isochronous frame rate for a frame
+ @details    Frame rates are listed fastest first. Finds the first frame
+ 	 	 	 rate from rate onwards which fits in an alternate setting.
+ @returns    Frame rate index or count if none of the frame rates fit.
+ **/
+static uint8_t class_vs_isoc_rate(uint8_t format, uint8_t frame, uint8_t rate,
+		uint8_t count)
+{
+	uint16_t sample;
+
+	for (; rate < count; rate++)
+	{
+		if (class_vs_isoc_alt(format, frame,
+				camera_mode_get_frame_interval(format, frame, rate), &sample))
+		{
+			break;
+		}
+	}
+
+	return rate;
+}
+#endif // USB_ENDPOINT_USE_ISOC
+
+/**
+ @brief      Maximum payload size for a frame
+ @details    Uncompressed payloads are one sample from the camera buffer
+ 	 	 	 with a header. MJPEG payloads are variable in size up to one
+ 	 	 	 band of encoder output or one packet for isochronous endpoints.
+ 	 	 	 When whole frame bulk payloads are used then uncompressed
+ 	 	 	 formats have a payload of one frame with a header.
+ 	 	 	 Isochronous payloads are sized for the frame rate so that the
+ 	 	 	 host can choose the smallest alternate setting.
+ **/
+static uint32_t class_vs_max_payload(uint8_t format, uint8_t frame, uint32_t interval)
+{
+#ifdef USB_ENDPOINT_USE_ISOC
+	uint16_t sample;
+	uint8_t alt;
+
+	alt = class_vs_isoc_alt(format, frame, interval, &sample);
+	if (alt == 0)
+	{
+		alt = UVC_ISOC_ALT_COUNT;
+	}
+	if (format == CAMERA_FORMAT_MJPEG)
+	{
+		return uvc_isoc_alt_size[alt - 1];
+	}
+	return sample + sizeof(USB_UVC_Payload_Header_PTS_SCR);
+#else // !USB_ENDPOINT_USE_ISOC
+	(void)interval;
+
+	if (format == CAMERA_FORMAT_MJPEG)
+	{
+		return MJPEG_OUTPUT_LENGTH + sizeof(USB_UVC_Payload_Header_PTS_SCR);
+	}
+#ifdef USB_BULK_PAYLOAD_FRAME
+	uint16_t width, height;
+
+	camera_mode_get_frame(format, frame, &width, &height);
+	return ((uint32_t)width * height * class_vs_format_bbp(format)) +
+			sizeof(USB_UVC_Payload_Header_PTS_SCR);
+#else // !USB_BULK_PAYLOAD_FRAME
+	return camera_mode_get_sample_size(format, frame, 0) +
+			sizeof(USB_UVC_Payload_Header_PTS_SCR);
+#endif // USB_BULK_PAYLOAD_FRAME
+#endif // USB_ENDPOINT_USE_ISOC
+}
+
 /**
  @brief      USB Set/Get Interface request handler
  @details    Handle standard requests from the host application
@@ -392,14 +1218,30 @@ int8_t setif_req_cb(USB_device_request *req)
 	else if (req->wIndex == 1)
 	{
 #ifdef USB_ENDPOINT_USE_ISOC
-		// Interface 1 can change Alt Settings to zero or 1 in ISOC mode.
-		if ((req->wValue == 0x00) || (req->wValue == 0x01))
+		// Interface 1 can change Alt Settings to zero or any of the
+		// isochronous bandwidth settings in ISOC mode.
+		if (req->wValue <= UVC_ISOC_ALT_COUNT)
 		{
 			usb_alt = LSB(req->wValue);
 			status = USBD_OK;
 
 			// Start or stop the camera depending on the alternate interface.
-			camera_set_state(CAMERA_STREAMING_START);
+			if (usb_alt)
+			{
+				uvc_data_pending = 0;
+				uvc_missed_microframes = 0;
+				// Keep a restart from a commit of the running mode. After
+				// alternate setting zero the camera interface is stopped
+				// and must be started again.
+				if (camera_get_state() != CAMERA_STREAMING_RESTART)
+				{
+					camera_set_state(CAMERA_STREAMING_START);
+				}
+			}
+			else
+			{
+				camera_set_state(CAMERA_STREAMING_STOP);
+			}
 		}
 		else
 		{
@@ -658,6 +1500,13 @@ int8_t class_req_interface_video_control(USB_device_request *req)
 int8_t class_vs_check_probecommit(USB_UVC_VideoProbeAndCommitControls *probecommit)
 {
 	int8_t status = USBD_ERR_NOT_SUPPORTED;
+	uint32_t interval;
+	uint16_t width, height;
+	uint8_t index = 0;
+	uint8_t format;
+	uint8_t frame;
+	uint8_t count;
+	int8_t i;
 
 	uvc_error_control = USB_UVC_REQUEST_ERROR_CODE_CONTROL_INVALID_REQUEST;
 
@@ -673,82 +1522,79 @@ int8_t class_vs_check_probecommit(USB_UVC_VideoProbeAndCommitControls *probecomm
 
 	if (probecommit->wDelay == 0)
 	{
-		probecommit->wDelay = uvc_probe_def_hs.wDelay;
+		probecommit->wDelay = uvc_probe_def.wDelay;
 	}
-	if (probecommit->dwClockFrequency == 0)
+	// The source clock for PTS and SCR values is fixed by the device.
+	probecommit->dwClockFrequency = uvc_probe_def.dwClockFrequency;
+
+	// Check for valid format index set.
+	format = class_vs_camera_format(probecommit->bFormatIndex);
+	if (format == CAMERA_FORMAT_ANY)
 	{
-		probecommit->dwClockFrequency = uvc_probe_def_hs.dwClockFrequency;
+		return USBD_ERR_NOT_SUPPORTED;
 	}
 
-	if (usb_speed == USBD_SPEED_HIGH)
+	// Match frame index to camera module reference.
+	count = class_vs_frame_count(format);
+	for (frame = 0; frame < count; frame++)
 	{
-		int8_t frame_rate;
-		uint16_t width, height;
-		uint8_t index = 0;
-		uint8_t format;
-		uint8_t frame;
-		uint8_t count;
-		int8_t i;
-
-		// Check for valid format index set.
-		if (probecommit->bFormatIndex == uvc_format_index_uncompressed)
+		index = camera_mode_get_frame(format,
+				frame, &width, &height);
+		if (index == probecommit->bFrameIndex)
 		{
-			format = CAMERA_FORMAT_UNCOMPRESSED;
-		}
-		else
-		{
-			return USBD_ERR_NOT_SUPPORTED;
+			break;
 		}
+		index = 0;
+	}
 
-		// Match frame index to camera module reference.
-		count = camera_mode_get_frame_count(format);
-		for (frame = 0; frame < count; frame++)
+	// If camera module reference found.
+	if (index)
+	{
+		// Get total number of frame rates for this frame index.
+		count = camera_mode_get_frame_rate_count(format, frame);
+		// Get default frame interval for this frame index.
+		interval = camera_mode_get_frame_interval(format, frame, 0);
+
+		// If frame interval hint is set then check the requested frame interval.
+		if (probecommit->bmFramingInfo & USB_UVC_VS_PROBE_COMMIT_CONTROL_BMHINT_FRAMINGINFO)
 		{
-			index = camera_mode_get_frame(format,
-					frame, &width, &height);
-			if (index == probecommit->bFrameIndex)
+			for (i = 0; i < count; i++)
 			{
-				break;
+				interval = camera_mode_get_frame_interval(format, frame, i);
+
+				// Check frame interval is supported.
+				if (probecommit->dwFrameInterval == interval)
+				{
+					status = USBD_OK;
+					break;
+				}
 			}
-			index = 0;
 		}
-
-		// If camera module reference found.
-		if (index)
+		else
 		{
-			// Get total number of frame rates for this frame index.
-			count = camera_mode_get_frame_rate_count(format, frame);
-			// Get default frame rate for this frame index.
-			frame_rate = camera_mode_get_frame_rate(format,	frame, 0);
+			i = 0;
+			status = USBD_OK;
+		}
+#ifdef USB_ENDPOINT_USE_ISOC
+		// Offer the next slower frame rate if this one does not fit in the
+		// largest alternate setting.
+		if (status == USBD_OK)
+		{
+			uint8_t rate = class_vs_isoc_rate(format, frame, i, count);
 
-			// If frame interval hint is set then check the requested frame interval.
-			if (probecommit->bmFramingInfo & USB_UVC_VS_PROBE_COMMIT_CONTROL_BMHINT_FRAMINGINFO)
+			if (rate >= count)
 			{
-				for (i = 0; i < count; i++)
-				{
-					frame_rate = camera_mode_get_frame_rate(format, frame, i);
-
-					// Check frame interval is supported.
-					if (probecommit->dwFrameInterval == 10000000 / frame_rate)
-					{
-						status = USBD_OK;
-						break;
-					}
-				}
+				status = USBD_ERR_NOT_SUPPORTED;
 			}
-			else
+			else if (rate != i)
 			{
-				status = USBD_OK;
+				interval = camera_mode_get_frame_interval(format, frame, rate);
+				probecommit->dwFrameInterval = interval;
 			}
-#ifdef USB_ENDPOINT_USE_ISOC
-			probecommit->dwMaxPayloadTransferSize = camera_mode_get_sample_size(format, frame,
-					UVC_DATA_EP_SIZE_HS - sizeof(USB_UVC_Payload_Header)) + sizeof(USB_UVC_Payload_Header);
-#else // !USB_ENDPOINT_USE_ISOC
-			probecommit->dwMaxPayloadTransferSize = camera_mode_get_sample_size(format, frame, 0) +
-					sizeof(USB_UVC_Payload_Header);
-#endif // USB_ENDPOINT_USE_ISOC
-			probecommit->dwMaxVideoFrameSize = width * height * FORMAT_UC_BBP;
 		}
+#endif // USB_ENDPOINT_USE_ISOC
+		probecommit->dwMaxPayloadTransferSize = class_vs_max_payload(format, frame, interval);
+		probecommit->dwMaxVideoFrameSize = width * height * class_vs_format_bbp(format);
 	}
 
 	if (status == USBD_OK)
@@ -790,20 +1636,24 @@ int8_t class_vs_set_commit(USB_UVC_VideoProbeAndCommitControls *commit)
 	int8_t status = USBD_ERR_NOT_SUPPORTED;
 	// Format bits per pixel.
 	//uint16_t bbp = 0;
+	// Committed mode is the one already running.
+	uint8_t warm = 0;
+	// Camera module is already set up for the committed mode.
+	uint8_t set_up = 0;
 
 	uvc_error_control = USB_UVC_REQUEST_ERROR_CODE_CONTROL_INVALID_REQUEST;
 
-	camera_stop();
-
 	// Check for valid format index set.
 	if ((commit->bmFramingInfo & USB_UVC_VS_PROBE_COMMIT_CONTROL_BMFRAMINGINFO_FRAMEIDFIELD) &&
 			(commit->bmFramingInfo & USB_UVC_VS_PROBE_COMMIT_CONTROL_BMFRAMINGINFO_EOFFIELD) &&
 			(commit->bPreferedVersion == USB_VIDEO_CLASS_VERSION_MINOR))
 	{
 		int8_t frame_rate;
+		uint8_t rate = 0;
+		uint32_t interval;
 		uint16_t width, height;
 		uint16_t sample;
-		uint16_t payload;
+		uint32_t payload;
 		uint8_t index = 0;
 		uint8_t format;
 		uint8_t frame;
@@ -811,17 +1661,15 @@ int8_t class_vs_set_commit(USB_UVC_VideoProbeAndCommitControls *commit)
 		int8_t i;
 
 		// Check for valid format index set.
-		if (commit->bFormatIndex == uvc_format_index_uncompressed)
-		{
-			format = CAMERA_FORMAT_UNCOMPRESSED;
-		}
-		else
+		format = class_vs_camera_format(commit->bFormatIndex);
+		if (format == CAMERA_FORMAT_ANY)
 		{
+			camera_stop();
 			return USBD_ERR_NOT_SUPPORTED;
 		}
 
 		// Match frame index to camera module reference.
-		count = camera_mode_get_frame_count(format);
+		count = class_vs_frame_count(format);
 		for (frame = 0; frame < count; frame++)
 		{
 			index = camera_mode_get_frame(format,
@@ -838,47 +1686,122 @@ int8_t class_vs_set_commit(USB_UVC_VideoProbeAndCommitControls *commit)
 		{
 			// Get total number of frame rates for this frame index.
 			count = camera_mode_get_frame_rate_count(format, frame);
-			// Get default frame rate for this frame index.
-			frame_rate = camera_mode_get_frame_rate(format,	frame, 0);
+			// If frame interval hint is set then find the requested frame
+			// interval. Otherwise use the default frame rate for this frame
+			// index. The payload size depends on the frame rate.
+			i = count;
+			if (commit->bmFramingInfo & USB_UVC_VS_PROBE_COMMIT_CONTROL_BMHINT_FRAMINGINFO)
+			{
+				for (i = 0; i < count; i++)
+				{
+					// Check frame interval is supported.
+					if (commit->dwFrameInterval == camera_mode_get_frame_interval(format, frame, i))
+					{
+						rate = i;
+						break;
+					}
+				}
+			}
+#ifdef USB_ENDPOINT_USE_ISOC
+			// Use the next slower frame rate if this one does not fit in
+			// the largest alternate setting as class_vs_check_probecommit
+			// has offered.
+			rate = class_vs_isoc_rate(format, frame, rate, count);
+			if (rate >= count)
+			{
+				camera_stop();
+				uvc_error_control = USB_UVC_REQUEST_ERROR_CODE_CONTROL_OUT_OF_RANGE;
+				return USBD_ERR_INVALID_PARAMETER;
+			}
+#endif // USB_ENDPOINT_USE_ISOC
+			// The camera module rate and the interval after decimation.
+			frame_rate = camera_mode_get_frame_rate(format, frame, rate);
+			interval = camera_mode_get_frame_interval(format, frame, rate);
+			payload = class_vs_max_payload(format, frame, interval);
+			if (payload == commit->dwMaxPayloadTransferSize)
+			{
+				// The requested frame interval must be supported.
+				if (i < count)
+				{
+					status = USBD_OK;
+				}
+			}
+			else
+			{
+				status = USBD_OK;
+			}
 			// Get the sample size for USB.
 #ifdef USB_ENDPOINT_USE_ISOC
-			sample = camera_mode_get_sample_size(format, frame,
-					UVC_DATA_EP_SIZE_HS - sizeof(USB_UVC_Payload_Header));
+			// One sample is sent in the payload of each microframe.
+			(void)class_vs_isoc_alt(format, frame, interval, &sample);
+			if (format == CAMERA_FORMAT_MJPEG)
+			{
+				sample = camera_mode_get_sample_size(format, frame, 0);
+			}
 #else // !USB_ENDPOINT_USE_ISOC
 			sample = camera_mode_get_sample_size(format, frame, 0);
 #endif // USB_ENDPOINT_USE_ISOC
-			payload = sample + sizeof(USB_UVC_Payload_Header);
-			if (payload == commit->dwMaxPayloadTransferSize)
+
+			if ((status == USBD_OK) &&
+					(format == uvc_running_format) && (frame == uvc_running_frame) &&
+					(interval == uvc_running_interval) && (sample == uvc_running_sample))
 			{
-				// If frame interval hint is set then check the requested frame interval.
-				if (commit->bmFramingInfo & USB_UVC_VS_PROBE_COMMIT_CONTROL_BMHINT_FRAMINGINFO)
+				// The camera is already running this mode.
+				if ((camera_get_state() == CAMERA_STREAMING_STARTED) ||
+						(camera_get_state() == CAMERA_STREAMING_SYNC))
 				{
-					for (i = 0; i < count; i++)
-					{
-						frame_rate = camera_mode_get_frame_rate(format, frame, i);
-
-						// Check frame interval is supported.
-						if (commit->dwFrameInterval == 10000000 / frame_rate)
-						{
-							status = USBD_OK;
-							break;
-						}
-					}
+					warm = 1;
+					set_up = 1;
 				}
+#ifdef USB_ENDPOINT_USE_ISOC
+				// Alternate setting zero stopped the camera interface but
+				// the camera module is still set up for this mode. The
+				// next alternate setting starts the camera interface again.
+				else if (camera_get_state() == CAMERA_STREAMING_STOPPED)
+				{
+					set_up = 1;
+				}
+#endif // USB_ENDPOINT_USE_ISOC
 			}
-			else
+
+			if (!set_up)
 			{
-				status = USBD_OK;
+				camera_stop();
+				uvc_running_format = CAMERA_FORMAT_ANY;
 			}
 
-			if (status == USBD_OK)
+			if ((status == USBD_OK) && (!set_up))
 			{
-				camera_set(width, height, frame_rate, format, sample);
+				uint16_t image_width, image_height;
+				uint16_t x, y;
+
+				// The camera is set up for the whole image and then the
+				// window for the frame index is applied to that image.
+				camera_mode_get_window(format, frame, &image_width, &image_height, &x, &y);
+				if ((camera_set(image_width, image_height, frame_rate, format, sample) != 0) ||
+						(camera_set_window(x, y, width, height) != 0))
+				{
+					// Cause a STALL if the configuration is illegal.
+					status = USBD_ERR_INVALID_PARAMETER;
+					uvc_error_control = USB_UVC_REQUEST_ERROR_CODE_CONTROL_OUT_OF_RANGE;
+				}
+				else
+				{
+					camera_set_decimation(camera_mode_get_frame_decimation(format, frame, rate));
+
+					uvc_running_format = format;
+					uvc_running_frame = frame;
+					uvc_running_interval = interval;
+					uvc_running_sample = sample;
+				}
 				// Check the sample length is suitable for an isochronous endpoint where it
 				// must transmit the whole sample with a header in a single packet.
 
 #ifdef USB_ENDPOINT_USE_ISOC
-				if (camera_get_sample() + sizeof(USB_UVC_Payload_Header) > UVC_DATA_EP_SIZE_HS)
+				// MJPEG payloads are split into packets as they are sent.
+				if ((format != CAMERA_FORMAT_MJPEG) &&
+						(camera_get_sample() + sizeof(USB_UVC_Payload_Header_PTS_SCR) >
+						uvc_isoc_alt_size[UVC_ISOC_ALT_COUNT - 1]))
 				{
 					// Cause a STALL if the configuration is illegal.
 					status = USBD_ERR_INVALID_PARAMETER;
@@ -886,16 +1809,33 @@ int8_t class_vs_set_commit(USB_UVC_VideoProbeAndCommitControls *commit)
 
 					camera_set_sample(0);
 					camera_set_state(CAMERA_STREAMING_STOP);
+					uvc_running_format = CAMERA_FORMAT_ANY;
 				}
 #endif // USB_ENDPOINT_USE_ISOC
 			}
 		}
+		else
+		{
+			camera_stop();
+		}
+	}
+	else
+	{
+		camera_stop();
 	}
 
 	if (status == USBD_OK)
 	{
+		if (warm)
+		{
+			// Keep capturing and restart the stream at the next frame.
+			camera_set_state(CAMERA_STREAMING_RESTART);
+		}
 #ifndef USB_ENDPOINT_USE_ISOC
-		camera_set_state(CAMERA_STREAMING_START);
+		else
+		{
+			camera_set_state(CAMERA_STREAMING_START);
+		}
 #endif // !USB_ENDPOINT_USE_ISOC
 
 		uvc_error_control = USB_UVC_REQUEST_ERROR_CODE_CONTROL_NO_ERROR;
@@ -1030,14 +1970,7 @@ int8_t class_req_interface_video_streaming(USB_device_request *req)
 			case USB_UVC_REQUEST_GET_DEF:
 				if (controlSelector == USB_UVC_VS_PROBE_CONTROL)
 				{
-					if (usb_speed == USBD_SPEED_HIGH)
-					{
-						proberesp = &uvc_probe_def_hs;
-					}
-					else
-					{
-						uvc_error_control = USB_UVC_REQUEST_ERROR_CODE_CONTROL_INVALID_REQUEST;
-					}
+					proberesp = &uvc_probe_def;
 				}
 				else
 				{
@@ -1048,17 +1981,10 @@ int8_t class_req_interface_video_streaming(USB_device_request *req)
 			case USB_UVC_REQUEST_GET_MIN:
 				if (controlSelector == USB_UVC_VS_PROBE_CONTROL)
 				{
-					if (usb_speed == USBD_SPEED_HIGH)
-					{
-						// Note that the min and max values are the same as we have exactly
-						// one configuration per frame and format.
-						proberesp = &probecommit;
-						status = class_vs_probe_min_max(&probecommit);
-					}
-					else
-					{
-						uvc_error_control = USB_UVC_REQUEST_ERROR_CODE_CONTROL_INVALID_REQUEST;
-					}
+					// Note that the min and max values are the same as we have exactly
+					// one configuration per frame and format.
+					proberesp = &probecommit;
+					status = class_vs_probe_min_max(&probecommit);
 				}
 				else
 				{
@@ -1069,17 +1995,10 @@ int8_t class_req_interface_video_streaming(USB_device_request *req)
 			case USB_UVC_REQUEST_GET_MAX:
 				if (controlSelector == USB_UVC_VS_PROBE_CONTROL)
 				{
-					if (usb_speed == USBD_SPEED_HIGH)
-					{
-						// Note that the min and max values are the same as we have exactly
-						// one configuration per frame and format.
-						proberesp = &probecommit;
-						status = class_vs_probe_min_max(&probecommit);
-					}
-					else
-					{
-						uvc_error_control = USB_UVC_REQUEST_ERROR_CODE_CONTROL_INVALID_REQUEST;
-					}
+					// Note that the min and max values are the same as we have exactly
+					// one configuration per frame and format.
+					proberesp = &probecommit;
+					status = class_vs_probe_min_max(&probecommit);
 				}
 				else
 				{
@@ -1271,10 +2190,11 @@ int8_t class_req_cb(USB_device_request *req)
  **/
 int8_t standard_req_get_descriptor(USB_device_request *req, uint8_t **buffer, uint16_t *len)
 {
-	uint8_t *src = NULL;
+	DESCRIPTOR_QUALIFIER uint8_t *src = NULL;
 	uint16_t length = req->wLength;
 	uint8_t hValue = MSB(req->wValue);
 	uint8_t lValue = LSB(req->wValue);
+	uint8_t index = lValue;
 	uint8_t i;
 	uint8_t slen;
 
@@ -1283,67 +2203,47 @@ int8_t standard_req_get_descriptor(USB_device_request *req, uint8_t **buffer, ui
 	case USB_DESCRIPTOR_TYPE_DEVICE:
 		if (USBD_DFU_is_runtime())
 		{
-			src = (uint8_t *) &device_descriptor_uvc;
+			src = (DESCRIPTOR_QUALIFIER uint8_t *) &device_descriptor_uvc;
 		}
 		else
 		{
-			src = (uint8_t *) &device_descriptor_dfumode;
+			src = (DESCRIPTOR_QUALIFIER uint8_t *) &device_descriptor_dfumode;
 		}
 		if (length > sizeof(USB_device_descriptor)) // too many bytes requested
 			length = sizeof(USB_device_descriptor); // Entire structure.
 		break;
 
 	case USB_DESCRIPTOR_TYPE_CONFIGURATION:
+	case USB_DESCRIPTOR_TYPE_OTHER_SPEED_CONFIGURATION:
 		if (USBD_DFU_is_runtime())
 		{
-			USB_configuration_descriptor *pConfigDescriptor;
+			DESCRIPTOR_QUALIFIER USB_configuration_descriptor *pConfigDescriptor;
 
-			if (usb_speed == USBD_SPEED_HIGH)
+			if ((usb_speed == USBD_SPEED_HIGH) ==
+					(hValue == USB_DESCRIPTOR_TYPE_CONFIGURATION))
 			{
-				pConfigDescriptor = (void *)config_descriptor_buffer_hs;
+				pConfigDescriptor = (DESCRIPTOR_QUALIFIER void *)&config_descriptor_hs;
 			}
 			else
 			{
-				pConfigDescriptor = (void *)config_descriptor_buffer_fs;
+				pConfigDescriptor = (DESCRIPTOR_QUALIFIER void *)&config_descriptor_fs;
 			}
 
 			if (length > pConfigDescriptor->wTotalLength) // too many bytes requested
 				length = pConfigDescriptor->wTotalLength; // Entire structure.
 
-			src = (uint8_t *)pConfigDescriptor;
-			pConfigDescriptor->bDescriptorType = USB_DESCRIPTOR_TYPE_CONFIGURATION;
+			src = (DESCRIPTOR_QUALIFIER uint8_t *)pConfigDescriptor;
 		}
-		else
+		else if (hValue == USB_DESCRIPTOR_TYPE_CONFIGURATION)
 		{
-			src = (uint8_t *) &config_descriptor_dfumode;
+			src = (DESCRIPTOR_QUALIFIER uint8_t *) &config_descriptor_dfumode;
 			if (length > sizeof(config_descriptor_dfumode)) // too many bytes requested
 				length = sizeof(config_descriptor_dfumode); // Entire structure.
 		}
 		break;
 
-	case USB_DESCRIPTOR_TYPE_OTHER_SPEED_CONFIGURATION:
-		if (USBD_DFU_is_runtime())
-		{
-			USB_configuration_descriptor *pConfigDescriptor;
-
-			if (usb_speed == USBD_SPEED_HIGH)
-			{
-				pConfigDescriptor = (void *)config_descriptor_buffer_fs;
-			}
-			else
-			{
-				pConfigDescriptor = (void *)config_descriptor_buffer_hs;
-			}
-			if (length > pConfigDescriptor->wTotalLength) // too many bytes requested
-				length = pConfigDescriptor->wTotalLength; // Entire structure.
-
-			src = (uint8_t *)pConfigDescriptor;
-			pConfigDescriptor->bDescriptorType = USB_DESCRIPTOR_TYPE_OTHER_SPEED_CONFIGURATION;
-		}
-		break;
-
 	case USB_DESCRIPTOR_TYPE_DEVICE_QUALIFIER:
-		src = (uint8_t *) &device_qualifier_descriptor_uvc;
+		src = (DESCRIPTOR_QUALIFIER uint8_t *) &device_qualifier_descriptor_uvc;
 		if (length > sizeof(USB_device_qualifier_descriptor)) // too many bytes requested
 			length = sizeof(USB_device_qualifier_descriptor); // Entire structure.
 		break;
@@ -1353,7 +2253,7 @@ int8_t standard_req_get_descriptor(USB_device_request *req, uint8_t **buffer, ui
 #ifdef USB_INTERFACE_USE_DFU
 		if (lValue == USB_MICROSOFT_WCID_STRING_DESCRIPTOR)
 		{
-			src = (uint8_t *)wcid_string_descriptor;
+			src = wcid_string_descriptor;
 			length = sizeof(wcid_string_descriptor);
 			break;
 		}
@@ -1361,12 +2261,10 @@ int8_t standard_req_get_descriptor(USB_device_request *req, uint8_t **buffer, ui
 
 		// Find the nth string in the string descriptor table
 		i = 0;
-		while ((slen = ((uint8_t *)string_descriptor)[i]) > 0)
+		while ((slen = ((DESCRIPTOR_QUALIFIER uint8_t *)string_descriptor)[i]) > 0)
 		{
-			// Point to start of string descriptor in __code segment
-			// Typecast prevents warning for losing const when USBD_transfer
-			// is called
-			src = (uint8_t *) &((uint8_t *)string_descriptor)[i];
+			// Point to start of string descriptor in program memory
+			src = &((DESCRIPTOR_QUALIFIER uint8_t *)string_descriptor)[i];
 			if (lValue == 0)
 			{
 				break;
@@ -1392,7 +2290,32 @@ int8_t standard_req_get_descriptor(USB_device_request *req, uint8_t **buffer, ui
 		return USBD_ERR_NOT_SUPPORTED;
 	}
 
-	*buffer = src;
+	if (src == NULL)
+	{
+		return USBD_ERR_NOT_SUPPORTED;
+	}
+
+	memcpy_pm2dat(descriptor_buffer, src, length);
+
+	if ((hValue == USB_DESCRIPTOR_TYPE_OTHER_SPEED_CONFIGURATION) && (length > 1))
+	{
+		((USB_configuration_descriptor *)descriptor_buffer)->bDescriptorType =
+				USB_DESCRIPTOR_TYPE_OTHER_SPEED_CONFIGURATION;
+	}
+
+#define TO_HEX(A) ((A) <= 9 ? '0' + (A) : 'A' - 10 + (A))
+
+	// The serial number is the third string. The first four characters
+	// are replaced with the camera module ID.
+	if ((hValue == USB_DESCRIPTOR_TYPE_STRING) && (index == 3))
+	{
+		for (i = 0; (i < 4) && ((i * 2) + 2 < length); i++)
+		{
+			descriptor_buffer[(i * 2) + 2] = TO_HEX((serial_module >> (12 - (i * 4))) & 0x0f);
+		}
+	}
+
+	*buffer = descriptor_buffer;
 	*len = length;
 
 	return USBD_OK;
@@ -1416,9 +2339,27 @@ int8_t standard_req_get_descriptor(USB_device_request *req, uint8_t **buffer, ui
 int8_t vendor_req_cb(USB_device_request *req)
 {
 	int8_t status = USBD_ERR_NOT_SUPPORTED;
-#ifdef USB_INTERFACE_USE_DFU
 	uint16_t length = req->wLength;
-#endif // USB_INTERFACE_USE_DFU
+
+	// Request for camera capture statistics.
+	if (req->bRequest == STATS_VENDOR_REQUEST_CODE)
+	{
+		if ((req->bmRequestType & USB_BMREQUESTTYPE_DIR_MASK) ==
+				USB_BMREQUESTTYPE_DIR_DEV_TO_HOST)
+		{
+			CAMERA_stats stats;
+
+			camera_get_stats(&stats);
+
+			if (length > sizeof(stats)) // too many bytes requested
+				length = sizeof(stats); // Entire structure.
+			USBD_transfer_ep0(USBD_DIR_IN, (uint8_t *) &stats,
+					length, length);
+			// ACK packet
+			USBD_transfer_ep0(USBD_DIR_OUT, NULL, 0, 0);
+			status = USBD_OK;
+		}
+	}
 
 	// For Microsoft WCID only.
 	// Request for Compatible ID Feature Descriptors.
@@ -1436,14 +2377,13 @@ int8_t vendor_req_cb(USB_device_request *req)
 				// Return a compatible ID feature descriptor.
 				if (USBD_DFU_is_runtime())
 				{
-					USBD_transfer_ep0(USBD_DIR_IN, (uint8_t *) &wcid_feature_runtime,
-							length, length);
+					memcpy_pm2dat(descriptor_buffer, &wcid_feature_runtime, length);
 				}
 				else
 				{
-					USBD_transfer_ep0(USBD_DIR_IN, (uint8_t *) &wcid_feature_dfumode,
-							length, length);
+					memcpy_pm2dat(descriptor_buffer, &wcid_feature_dfumode, length);
 				}
+				USBD_transfer_ep0(USBD_DIR_IN, descriptor_buffer, length, length);
 				// ACK packet
 				USBD_transfer_ep0(USBD_DIR_OUT, NULL, 0, 0);
 				status = USBD_OK;
@@ -1568,626 +2508,181 @@ int8_t usb_uvc_is_uncompressed()
 	if ((uvc_commit.bFormatIndex > FORMAT_INDEX_TYPE_NONE)
 			&& (uvc_commit.bFormatIndex < FORMAT_INDEX_MAX))
 	{
-		return (uvc_commit.bFormatIndex == uvc_format_index_uncompressed);
+		return (uvc_commit.bFormatIndex == UVC_FORMAT_INDEX_UNCOMPRESSED);
 	}
 	return 0;
 }
 
-uint8_t usb_uvc_get_alt()
+int8_t usb_uvc_is_mjpeg()
 {
-	return usb_alt;
+	if ((uvc_commit.bFormatIndex > FORMAT_INDEX_TYPE_NONE)
+			&& (uvc_commit.bFormatIndex < FORMAT_INDEX_MAX))
+	{
+		return (uvc_commit.bFormatIndex == UVC_FORMAT_INDEX_MJPEG);
+	}
+	return 0;
 }
 
-#define ADD_CONFIG_DESCRIPTOR(A, B) memcpy(A, &B, B.bLength); A += B.bLength;
-#define ADD_CONFIG_DESCRIPTOR_LEN(B, C) C += B.bLength;
-#define MIN(a,b) ((a<b)?a:b)
-
-void usb_uvc_build_configuration(uint16_t module)
+int8_t usb_uvc_is_luma()
 {
-	uint8_t *pCdEnd_hs;
-	uint16_t lenConfigDescriptor_hs = 0;
-	uint16_t lenCSInterfaceDescriptor_hs = 0;
-	uint16_t lenCSInputDescriptor_hs = 0;
-
-	USB_configuration_descriptor *pConfigDescriptor_hs;
-	/* Single interface header descriptor. */
-	USB_UVC_VC_CSInterfaceHeaderDescriptor(1) *pCSInterfaceDescriptor_hs;
-	/* Input header descriptors for Uncompressed and MJPEG. */
-	USB_UVC_VS_CSInterfaceInputHeaderDescriptor(2) *pCSInputDescriptor_hs;
-
-	uint8_t *pCdEnd_fs;
-	uint16_t lenConfigDescriptor_fs = 0;
-	uint16_t lenCSInterfaceDescriptor_fs = 0;
-
-	USB_configuration_descriptor *pConfigDescriptor_fs;
-	USB_UVC_VC_CSInterfaceHeaderDescriptor(1) *pCSInterfaceDescriptor_fs;
-
-	uint8_t countFrameUncompressed = camera_mode_get_frame_count(CAMERA_FORMAT_UNCOMPRESSED);
-	uint8_t countFormats = MIN(countFrameUncompressed, 1);
-	uint16_t countFrameRatesUncompressed = 0;
-	uint8_t defaultFormat = 1;
-	uint8_t defaultFrame = 1;
-
-	uint16_t i;
-	uint8_t slen;
-	uint8_t serial;
-	uint8_t *src;
-
-	uint16_t len_hs;
-	uint16_t len_fs;
-
-	uint16_t width, height;
-	int8_t frame_rate;
-	uint8_t frame_index;
-
-	for (i = 0; i < countFrameUncompressed; i++)
+	if ((uvc_commit.bFormatIndex > FORMAT_INDEX_TYPE_NONE)
+			&& (uvc_commit.bFormatIndex < FORMAT_INDEX_MAX))
 	{
-		countFrameRatesUncompressed += camera_mode_get_frame_rate_count(CAMERA_FORMAT_UNCOMPRESSED, i);
+		return (uvc_commit.bFormatIndex == UVC_FORMAT_INDEX_LUMA);
 	}
+	return 0;
+}
 
-	len_hs =
-			sizeof(USB_configuration_descriptor) +
-			sizeof(USB_UVC_interface_association_descriptor) +
-
-			sizeof(USB_UVC_VC_StandardInterfaceDescriptor) +
-			sizeof(struct UVC_VC_config_descriptor) +
-			sizeof(USB_UVC_VC_StandardInterruptEndpointDescriptor) +
-			sizeof(USB_UVC_VC_CSEndpointDescriptor) +
-
-			sizeof(USB_UVC_VS_StandardInterfaceDescriptor) +
-			sizeof(USB_UVC_VS_CSInterfaceInputHeaderDescriptor(countFormats)) +
-
-#ifndef USB_ENDPOINT_USE_ISOC
-			sizeof(USB_UVC_VS_BulkVideoDataEndpointDescriptor) +
-#else // !USB_ENDPOINT_USE_ISOC
-			sizeof(USB_UVC_VS_StandardInterfaceDescriptor) +
-			sizeof(USB_UVC_VS_IsochronousVideoDataEndpointDescriptor) +
-#endif // USB_ENDPOINT_USE_ISOC
-
-#ifdef USB_INTERFACE_USE_DFU
-			sizeof(USB_interface_descriptor) +
-			sizeof(USB_dfu_functional_descriptor) +
-#endif // USB_INTERFACE_USE_DFU
-			0;
+uint8_t usb_uvc_get_alt()
+{
+	return usb_alt;
+}
 
-	if (countFrameUncompressed)
+uint16_t usb_uvc_get_packet_size()
+{
+#ifdef USB_ENDPOINT_USE_ISOC
+	if ((usb_alt == 0) || (usb_alt > UVC_ISOC_ALT_COUNT))
 	{
-		len_hs += sizeof(USB_UVC_VS_UncompressedVideoFormatDescriptor) +
-				(sizeof(USB_UVC_VS_UncompressedVideoFrameDescriptorDiscrete(0)) * countFrameUncompressed) +
-				sizeof(USB_UVC_ColorMatchingDescriptor);
-		len_hs += (sizeof(unsigned long) * countFrameRatesUncompressed);
+		return 0;
 	}
+	return uvc_isoc_alt_size[usb_alt - 1];
+#else // !USB_ENDPOINT_USE_ISOC
+	return USBD_ep_max_size(UVC_EP_DATA_IN);
+#endif // USB_ENDPOINT_USE_ISOC
+}
 
-	len_fs =
-			sizeof(USB_configuration_descriptor) +
-			sizeof(USB_UVC_interface_association_descriptor) +
-
-			sizeof(USB_UVC_VC_StandardInterfaceDescriptor) +
-			sizeof(struct UVC_VC_config_descriptor) +
-			sizeof(USB_UVC_VC_StandardInterruptEndpointDescriptor) +
-			sizeof(USB_UVC_VC_CSEndpointDescriptor) +
-
-#ifdef USB_INTERFACE_USE_DFU
-			sizeof(USB_interface_descriptor dfu_interface) +
-			sizeof(USB_dfu_functional_descriptor dfu_functional) +
-#endif // USB_INTERFACE_USE_DFU
-			0;
-
-	config_descriptor_buffer_hs = (char *)malloc(len_hs);
-	config_descriptor_buffer_fs = (char *)malloc(len_fs);
-
-	memset(config_descriptor_buffer_hs, 0, len_hs);
-	memset(config_descriptor_buffer_fs, 0, len_fs);
-
-	pCdEnd_hs = (uint8_t *)config_descriptor_buffer_hs;
-	pCdEnd_fs = (uint8_t *)config_descriptor_buffer_fs;
+uint16_t usb_uvc_get_sof()
+{
+	return USBD_REG(frame) & 0x7ff;
+}
 
-	{
-		USB_configuration_descriptor c = {
-				sizeof(USB_configuration_descriptor), /* configuration.bLength */
-				USB_DESCRIPTOR_TYPE_CONFIGURATION, /* configuration.bDescriptorType */
-				len_hs, /* configuration.wTotalLength */
-#ifdef USB_INTERFACE_USE_DFU
-				0x03, /* configuration.bNumInterfaces */
-#else // !USB_INTERFACE_USE_DFU
-				0x02, /* configuration.bNumInterfaces */
-#endif // USB_INTERFACE_USE_DFU
-				0x01, /* configuration.bConfigurationValue */
-				0x00, /* configuration.iConfiguration */
-				USB_CONFIG_BMATTRIBUTES_VALUE, /* configuration.bmAttributes */
-				//0xFA, /* configuration.bMaxPower */           // 500mA
-				0x00, /* configuration.bMaxPower */           // 0mA
-		};
-		pConfigDescriptor_hs = (USB_configuration_descriptor *)pCdEnd_hs;
-		pConfigDescriptor_fs = (USB_configuration_descriptor *)pCdEnd_fs;
+/**
+ @brief      Video data endpoint callback
+ @details    Called from the USB interrupt when the host has taken a packet
+ 	 	 	 from the video data endpoint.
+ **/
+static int8_t class_vs_data_ep_cb(USBD_ENDPOINT_NUMBER ep_number)
+{
+	(void)ep_number;
 
-		ADD_CONFIG_DESCRIPTOR(pCdEnd_hs, c);
-		ADD_CONFIG_DESCRIPTOR_LEN(c, lenConfigDescriptor_hs);
+	uvc_data_ep_count++;
 
-		ADD_CONFIG_DESCRIPTOR(pCdEnd_fs, c);
-		ADD_CONFIG_DESCRIPTOR_LEN(c, lenConfigDescriptor_fs);
+	return USBD_OK;
+}
 
-	};
-	{
-		USB_UVC_interface_association_descriptor c = {
-				sizeof(USB_UVC_interface_association_descriptor), /* interface_association.bLength */
-				USB_DESCRIPTOR_TYPE_INTERFACE_ASSOCIATION, /* interface_association.bDescriptorType */
-				0, /* interface_association.bFirstInterface */
-				2, /* interface_association.bInterfaceCount */
-				USB_CLASS_VIDEO, /* interface_association.bFunctionClass */
-				USB_SUBCLASS_VIDEO_INTERFACE_COLLECTION, /* interface_association.bFunctionSubClass */
-				USB_PROTOCOL_VIDEO_UNDEFINED, /* interface_association.bFunctionProtocol */
-				2, /* interface_association.iFunction */  // "FT900 UVC"
-		};
-		ADD_CONFIG_DESCRIPTOR(pCdEnd_hs, c);
-		ADD_CONFIG_DESCRIPTOR_LEN(c, lenConfigDescriptor_hs);
-
-		ADD_CONFIG_DESCRIPTOR(pCdEnd_fs, c);
-		ADD_CONFIG_DESCRIPTOR_LEN(c, lenConfigDescriptor_fs);
-	};
-
-	// ---- INTERFACE DESCRIPTOR ----
-	{
-		USB_UVC_VC_StandardInterfaceDescriptor c = {
-				sizeof(USB_UVC_VC_StandardInterfaceDescriptor), /* interface_video_control.bLength */
-				USB_DESCRIPTOR_TYPE_INTERFACE, /* interface_video_control.bDescriptorType */
-				0, /* interface_video_control.bInterfaceNumber */
-				0x00, /* interface_video_control.bAlternateSetting */
-				0x01, /* interface_video_control.bNumEndpoints */
-				USB_CLASS_VIDEO, /* interface_video_control.bInterfaceClass */ // UVC Class
-				USB_SUBCLASS_VIDEO_VIDEOCONTROL, /* interface_video_control.bInterfaceSubClass */ // Abstract Control Model
-				USB_PROTOCOL_VIDEO_UNDEFINED, /* interface_video_control.bInterfaceProtocol */ // No built-in protocol
-				2, /* interface_video_control.iInterface */ // Same as IAD iFunction.
-		};
-		ADD_CONFIG_DESCRIPTOR(pCdEnd_hs, c);
-		ADD_CONFIG_DESCRIPTOR_LEN(c, lenConfigDescriptor_hs);
-
-		ADD_CONFIG_DESCRIPTOR(pCdEnd_fs, c);
-		ADD_CONFIG_DESCRIPTOR_LEN(c, lenConfigDescriptor_fs);
-	};
+uint8_t usb_uvc_data_ep_event()
+{
+	uint8_t count = uvc_data_ep_count;
 
+	if (count != uvc_data_ep_seen)
 	{
-		// ---- Class specific VC Interface Header Descriptor ----
-		{
-			USB_UVC_VC_CSInterfaceHeaderDescriptor(1) c = {
-					sizeof(USB_UVC_VC_CSInterfaceHeaderDescriptor(1)), /* vc_header.bLength */
-					USB_UVC_DESCRIPTOR_TYPE_CS_INTERFACE, /* vc_header.bDescriptorType */
-					USB_UVC_DESCRIPTOR_SUBTYPE_VC_HEADER, /* vc_header.bDescriptorSubtype */
-					(USB_VIDEO_CLASS_VERSION_MAJOR << 8) | (USB_VIDEO_CLASS_VERSION_MINOR << 4), /* vc_header.bpCdEndUVC */
-					sizeof(struct UVC_VC_config_descriptor), /* vc_header.wTotalLength */
-					CLK_FREQ_48MHz, /* vc_header.dwClockFrequency */
-					0x01, /* vc_header.bInCollection */
-					{0x01,} /* vc_header.baInterfaceNr */
-			};
-
-			pCSInterfaceDescriptor_hs = (void *)pCdEnd_hs;
-			pCSInterfaceDescriptor_fs = (void *)pCdEnd_fs;
-
-			ADD_CONFIG_DESCRIPTOR(pCdEnd_hs, c);
-			ADD_CONFIG_DESCRIPTOR_LEN(c, lenConfigDescriptor_hs);
-			ADD_CONFIG_DESCRIPTOR_LEN(c, lenCSInterfaceDescriptor_hs);
-
-			ADD_CONFIG_DESCRIPTOR(pCdEnd_fs, c);
-			ADD_CONFIG_DESCRIPTOR_LEN(c, lenConfigDescriptor_fs);
-			ADD_CONFIG_DESCRIPTOR_LEN(c, lenCSInterfaceDescriptor_fs);
-		};
-
-	// ---- Input Terminal Descriptor - Camera ----
-	{
-		USB_UVC_VC_CameraTerminalDescriptor(2) c = {
-				sizeof(USB_UVC_VC_CameraTerminalDescriptor(2)), /* camera_input.bLength */
-				USB_UVC_DESCRIPTOR_TYPE_CS_INTERFACE, /* camera_input.bDescriptorType */
-				USB_UVC_DESCRIPTOR_SUBTYPE_VC_INPUT_TERMINAL, /* camera_input.bDescriptorSubtype */
-				ENTITY_ID_CAMERA, /* camera_input.bTerminalID */
-				USB_UVC_ITT_CAMERA, /* camera_input.wTerminalType */
-				0x00, /* camera_input.bAssocTerminal */
-				0x00, /* camera_input.iTerminal */
-				0x0000, /* camera_input.wObjectiveFocalLengthMin */
-				0x0000, /* camera_input.wObjectiveFocalLengthMax */
-				0x0000, /* camera_input.wOcularFocalLength */
-				0x02, /* camera_input.bControlSize */
-				{0x00, 0x00,}, /* camera_input.bmControls[2] */
-		};
-
-		ADD_CONFIG_DESCRIPTOR(pCdEnd_hs, c);
-		ADD_CONFIG_DESCRIPTOR(pCdEnd_fs, c);
-
-		ADD_CONFIG_DESCRIPTOR_LEN(c, lenConfigDescriptor_hs);
-		ADD_CONFIG_DESCRIPTOR_LEN(c, lenCSInterfaceDescriptor_hs);
-
-		ADD_CONFIG_DESCRIPTOR_LEN(c, lenConfigDescriptor_fs);
-		ADD_CONFIG_DESCRIPTOR_LEN(c, lenCSInterfaceDescriptor_fs);
-	};
-
-	// ---- Output Terminal Descriptor ----
-	{
-		USB_UVC_VC_OutputTerminalDescriptor c = {
-				sizeof(USB_UVC_VC_OutputTerminalDescriptor), /* camera_output.bLength */
-				USB_UVC_DESCRIPTOR_TYPE_CS_INTERFACE, /* camera_output.bDescriptorType */
-				USB_UVC_DESCRIPTOR_SUBTYPE_VC_OUTPUT_TERMINAL, /* camera_output.bDescriptorSubtype */
-				ENTITY_ID_OUTPUT, /* camera_output.bTerminalID */
-				USB_UVC_TT_STREAMING, /* camera_output.wTerminalType */
-				0x00, /* camera_output.bAssocTerminal */
-				ENTITY_ID_PROCESSING, /* camera_output.bSourceID */
-				0x00, /* camera_output.iTerminal */
-		};
-
-		ADD_CONFIG_DESCRIPTOR(pCdEnd_hs, c);
-		ADD_CONFIG_DESCRIPTOR(pCdEnd_fs, c);
-
-		ADD_CONFIG_DESCRIPTOR_LEN(c, lenConfigDescriptor_hs);
-		ADD_CONFIG_DESCRIPTOR_LEN(c, lenCSInterfaceDescriptor_hs);
-
-		ADD_CONFIG_DESCRIPTOR_LEN(c, lenConfigDescriptor_fs);
-		ADD_CONFIG_DESCRIPTOR_LEN(c, lenCSInterfaceDescriptor_fs);
-	};
-
-	// ---- Processing Unit Descriptor ----
-	{
-		USB_UVC_VC_ProcessingUnitDescriptor(2) c = {
-				sizeof(USB_UVC_VC_ProcessingUnitDescriptor(2)), /* camera_proc_unit.bLength */
-				USB_UVC_DESCRIPTOR_TYPE_CS_INTERFACE, /* camera_proc_unit.bDescriptorType */
-				USB_UVC_DESCRIPTOR_SUBTYPE_VC_PROCESSING_UNIT, /* camera_proc_unit.bDescriptorSubtype */
-				ENTITY_ID_PROCESSING, /* camera_proc_unit.bUnitID */
-				ENTITY_ID_CAMERA, /* camera_proc_unit.bSourceID */
-				0x0000, /* camera_proc_unit.wMaxMultiplier */
-				0x02, /* camera_proc_unit.bControlSize */
-				{0x00, 0x00,}, /* camera_proc_unit.bmControls[3] */
-				0x00, /* camera_proc_unit.iProcessing */
-				//0x06, /* camera_proc_unit.bmVideoStandards */
-		};
-
-		ADD_CONFIG_DESCRIPTOR(pCdEnd_hs, c);
-		ADD_CONFIG_DESCRIPTOR(pCdEnd_fs, c);
-
-		ADD_CONFIG_DESCRIPTOR_LEN(c, lenConfigDescriptor_hs);
-		ADD_CONFIG_DESCRIPTOR_LEN(c, lenCSInterfaceDescriptor_hs);
-
-		ADD_CONFIG_DESCRIPTOR_LEN(c, lenConfigDescriptor_fs);
-		ADD_CONFIG_DESCRIPTOR_LEN(c, lenCSInterfaceDescriptor_fs);
-	};
-
-	pCSInterfaceDescriptor_hs->wTotalLength = lenCSInterfaceDescriptor_hs;
-	pCSInterfaceDescriptor_fs->wTotalLength = lenCSInterfaceDescriptor_fs;
-	};
-
-	// ---- ENDPOINT DESCRIPTOR ----
-	{
-		USB_UVC_VC_StandardInterruptEndpointDescriptor c = {
-				sizeof(USB_UVC_VC_StandardInterruptEndpointDescriptor), /* endpoint_int_in.bLength */
-				USB_DESCRIPTOR_TYPE_ENDPOINT, /* endpoint_int_in.bDescriptorType */
-				USB_ENDPOINT_DESCRIPTOR_EPADDR_IN | UVC_EP_INTERRUPT, /* endpoint_int_in.bEndpointAddress */
-				USB_ENDPOINT_DESCRIPTOR_ATTR_INTERRUPT, /* endpoint_int_in.bmAttributes */
-				UVC_INTERRUPT_EP_SIZE, /* endpoint_int_in.wMaxPacketSize */
-				0x08, /* endpoint_int_in.bInterval */
-		};
-
-		ADD_CONFIG_DESCRIPTOR(pCdEnd_hs, c);
-		ADD_CONFIG_DESCRIPTOR_LEN(c, lenConfigDescriptor_hs);
-
-		ADD_CONFIG_DESCRIPTOR(pCdEnd_fs, c);
-		ADD_CONFIG_DESCRIPTOR_LEN(c, lenConfigDescriptor_fs);
-	};
-
-	// ---- Class Specific ENDPOINT DESCRIPTOR ----
-	{
-		USB_UVC_VC_CSEndpointDescriptor c = {
-				sizeof(USB_UVC_VC_CSEndpointDescriptor), /* endpoint_int_descriptor.bLength */
-				USB_UVC_DESCRIPTOR_TYPE_CS_ENDPOINT, /* endpoint_int_descriptor.bDescriptorType */
-				USB_UVC_DESCRIPTOR_SUBTYPE_EP_INTERRUPT, /* endpoint_int_descriptor.bDescriptorSubType */
-				UVC_INTERRUPT_EP_SIZE, /* endpoint_int_descriptor.wMaxTransferSize */
-		};
+		uvc_data_ep_seen = count;
+		return 1;
+	}
+	return 0;
+}
 
-		ADD_CONFIG_DESCRIPTOR(pCdEnd_hs, c);
-		ADD_CONFIG_DESCRIPTOR_LEN(c, lenConfigDescriptor_hs);
+#ifdef USB_ENDPOINT_USE_ISOC
+static void class_vs_sof_cb(uint16_t frame)
+{
+	uint8_t count = uvc_data_ep_count;
 
-		ADD_CONFIG_DESCRIPTOR(pCdEnd_fs, c);
-		ADD_CONFIG_DESCRIPTOR_LEN(c, lenConfigDescriptor_fs);
-	};
+	(void)frame;
 
+	uvc_sof_count++;
 
-	// ---- Standard Video Streaming Interface Descriptor ----
+	// The host did not take a packet in the last (micro)frame but there
+	// was data to send.
+	if ((usb_alt) && (uvc_data_pending) && (count == uvc_sof_ep_count))
 	{
-		USB_UVC_VS_StandardInterfaceDescriptor c = {
-				sizeof(USB_UVC_VS_StandardInterfaceDescriptor), /* interface_video_stream.bLength */
-				USB_DESCRIPTOR_TYPE_INTERFACE, /* interface_video_stream.bDescriptorType */
-				1, /* interface_video_stream.bInterfaceNumber */
-				0x00, /* interface_video_stream.bAlternateSetting */
-#ifdef USB_ENDPOINT_USE_ISOC
-				0x00, /* interface_video_stream.bNumEndpoints */
-#else // !USB_ENDPOINT_USE_ISOC
-				0x01, /* interface_video_stream.bNumEndpoints */
-#endif // USB_ENDPOINT_USE_ISOC
-				USB_CLASS_VIDEO, /* interface_video_stream.bInterfaceClass */
-				USB_SUBCLASS_VIDEO_VIDEOSTREAMING, /* interface_video_stream.bInterfaceSubClass */
-				USB_PROTOCOL_VIDEO_UNDEFINED, /* interface_video_stream.bInterfaceProtocol */
-				0x00 /* interface_video_stream.iInterface */
-		};
+		uvc_missed_microframes++;
+	}
+	uvc_sof_ep_count = count;
+}
 
-		ADD_CONFIG_DESCRIPTOR(pCdEnd_hs, c);
-		ADD_CONFIG_DESCRIPTOR_LEN(c, lenConfigDescriptor_hs);
-	};
+uint8_t usb_uvc_sof_event()
+{
+	uint8_t count = uvc_sof_count;
 
+	if (count != uvc_sof_seen)
 	{
-		// ---- Class-specific Video Streaming Input Header Descriptor ----
-		{
-			USB_UVC_VS_CSInterfaceInputHeaderDescriptor(0) c = {
-					sizeof(USB_UVC_VS_CSInterfaceInputHeaderDescriptor(0)), /* vs_header.bLength */
-					USB_UVC_DESCRIPTOR_TYPE_CS_INTERFACE, /* vs_header.bDescriptorType */
-					USB_UVC_DESCRIPTOR_SUBTYPE_VS_INPUT_HEADER, /* vs_header.bDescriptorSubType */
-					countFormats, /* vs_header.bNumFormats */
-					0, /* vs_header.wTotalLength */
-					USB_ENDPOINT_DESCRIPTOR_EPADDR_IN | UVC_EP_DATA_IN, /* vs_header.bEndpointAddress */
-					0x00, /* vs_header.bmInfo */
-					0x03, /* vs_header.bTerminalLink */
-					0x00, /* vs_header.bStillCaptureMethod */
-					0x00, /* vs_header.bTriggerSupport */
-					0x00, /* vs_header.bTriggerUsage */
-					0x01, /* vs_header.bControlSize */
-					//{
-					//0x00, /* vs_header.bmaControls format 1 */
-					//},
-			};
-
-			pCSInputDescriptor_hs = (void *)pCdEnd_hs;
-
-			ADD_CONFIG_DESCRIPTOR(pCdEnd_hs, c);
-
-			if (countFrameUncompressed)
-			{
-				pCdEnd_hs++;
-				pCSInputDescriptor_hs->bLength += sizeof(unsigned char);
-				lenConfigDescriptor_hs++;
-				lenCSInputDescriptor_hs++;
-			}
-
-			ADD_CONFIG_DESCRIPTOR_LEN(c, lenConfigDescriptor_hs);
-			ADD_CONFIG_DESCRIPTOR_LEN(c, lenCSInputDescriptor_hs);
-		}
-
-		countFormats = 1;
-
-		// ---- Class specific Uncompressed VS Format Descriptor ----
-		if (countFrameUncompressed)
-		{
-			uvc_format_index_uncompressed = countFormats;
-
-			USB_UVC_VS_UncompressedVideoFormatDescriptor c = {
-					sizeof(USB_UVC_VS_UncompressedVideoFormatDescriptor), /* format.bLength */
-					USB_UVC_DESCRIPTOR_TYPE_CS_INTERFACE, /* format.bDescriptorType */
-					USB_UVC_DESCRIPTOR_SUBTYPE_VS_FORMAT_UNCOMPRESSED, /* format.bDescriptorSubType */
-					countFormats, /* format.bFormatIndex */
-					countFrameUncompressed, /* format.bNumFrameDescriptors */
-					PAYLOAD_FORMAT_UNCOMPRESSED, /* format.guidFormat[16] */
-					PAYLOAD_BBP_UNCOMPRESSED, /* format.bBitsPerPixel */
-					1, /* format.bDefaultFrameIndex */
-					FRAME_RATIO_X, /* format.bAspectRatioX */
-					FRAME_RATIO_Y, /* format.bAspectRatioY */
-					0x00, /* format.bmInterlaceFlags */
-					0x00, /* format.bCopyProtect */
-			};
-
-			ADD_CONFIG_DESCRIPTOR(pCdEnd_hs, c);
-			ADD_CONFIG_DESCRIPTOR_LEN(c, lenConfigDescriptor_hs);
-			ADD_CONFIG_DESCRIPTOR_LEN(c, lenCSInputDescriptor_hs);
-
-			countFrameUncompressed = 0;
-
-			// ---- Class specific Uncompressed VS Frame Descriptor ----
-			do
-			{
-				frame_index = camera_mode_get_frame(CAMERA_FORMAT_UNCOMPRESSED, countFrameUncompressed,
-						&width, &height);
-				if (frame_index == 0)
-				{
-					break;
-				}
-
-				countFrameRatesUncompressed = camera_mode_get_frame_rate_count(CAMERA_FORMAT_UNCOMPRESSED,
-						countFrameUncompressed);
-				/* Get first frame rate for default. */
-				frame_rate = camera_mode_get_frame_rate(CAMERA_FORMAT_UNCOMPRESSED, countFrameUncompressed,
-						0);
-				{
-					USB_UVC_VS_UncompressedVideoFrameDescriptorDiscrete(0) c = {
-							sizeof(USB_UVC_VS_UncompressedVideoFrameDescriptorDiscrete(countFrameRatesUncompressed)), /* frame.bLength */
-							USB_UVC_DESCRIPTOR_TYPE_CS_INTERFACE, /* frame.bDescriptorType */
-							USB_UVC_DESCRIPTOR_SUBTYPE_VS_FRAME_UNCOMPRESSED, /* frame.bDescriptorSubType */
-							frame_index, /* frame.bFrameIndex */
-							0x00, /* frame.bmCapabilities */
-							width, /* frame.wWidth */
-							height, /* frame.wHeight */
-							(width * height * FORMAT_UC_BBP) * frame_rate * 8, /* frame.dwMinBitRate */
-							(width * height * FORMAT_UC_BBP) * frame_rate * 8, /* frame.dwMaxBitRate */
-							(width * height * FORMAT_UC_BBP), /* frame.dwMaxVideoFrameBufferSize */
-							10000000 / frame_rate, /* frame.dwDefaultFrameInterval */
-							countFrameRatesUncompressed, /* frame.bFrameIntervalType */
-					};
-
-					for (i = 0; i < countFrameRatesUncompressed; i++)
-					{
-						frame_rate = camera_mode_get_frame_rate(CAMERA_FORMAT_UNCOMPRESSED,
-								countFrameUncompressed, i);
-						c.dwFrameInterval[i] = 10000000 / frame_rate; /* frame.dwFrameInterval */
-					}
-
-					ADD_CONFIG_DESCRIPTOR(pCdEnd_hs, c);
-					ADD_CONFIG_DESCRIPTOR_LEN(c, lenConfigDescriptor_hs);
-					ADD_CONFIG_DESCRIPTOR_LEN(c, lenCSInputDescriptor_hs);
-				}
-				countFrameUncompressed++;
-			} while (frame_index);
+		uvc_sof_seen = count;
+		return 1;
+	}
+	return 0;
+}
 
-			// ---- Class specific Color Matching Descriptor ----
-			{
-				USB_UVC_ColorMatchingDescriptor c = {
-						sizeof(USB_UVC_ColorMatchingDescriptor),  /* desc.bLength */
-						USB_UVC_DESCRIPTOR_TYPE_CS_INTERFACE, /* desc.bDescriptorType */
-						USB_UVC_DESCRIPTOR_SUBTYPE_VS_COLORFORMAT, /* desc.bDescriptorSubType */
-						1, /* desc.bColorPrimaries */
-						1, /* desc.bTransferCharacteristics */
-						4, /* desc.bMatrixCoefficients */
-				};
-
-				ADD_CONFIG_DESCRIPTOR(pCdEnd_hs, c);
-				ADD_CONFIG_DESCRIPTOR_LEN(c, lenConfigDescriptor_hs);
-				ADD_CONFIG_DESCRIPTOR_LEN(c, lenCSInputDescriptor_hs);
-			};
-
-			countFormats++;
-		};
-	};
-
-	pCSInputDescriptor_hs->wTotalLength = lenCSInputDescriptor_hs;
+void usb_uvc_set_data_pending(uint8_t pending)
+{
+	uvc_data_pending = pending;
+}
 
-#ifndef USB_ENDPOINT_USE_ISOC
-	// ---- ENDPOINT DESCRIPTOR ----
-	{
-		USB_UVC_VS_BulkVideoDataEndpointDescriptor c = {
-				sizeof(USB_UVC_VS_BulkVideoDataEndpointDescriptor), /* endpoint_bulk_in.bLength */
-				USB_DESCRIPTOR_TYPE_ENDPOINT, /* endpoint_bulk_in.bDescriptorType */
-				USB_ENDPOINT_DESCRIPTOR_EPADDR_IN | UVC_EP_DATA_IN, /* endpoint_bulk_in.bEndpointAddress */
-				USB_ENDPOINT_DESCRIPTOR_ATTR_BULK, /* endpoint_bulk_in.bmAttributes */
-				UVC_DATA_EP_SIZE_HS, /* endpoint_bulk_in.wMaxPacketSize */
-				0x00, /* endpoint_bulk_in.bInterval */
-		};
-		ADD_CONFIG_DESCRIPTOR(pCdEnd_hs, c);
-		ADD_CONFIG_DESCRIPTOR_LEN(c, lenConfigDescriptor_hs);
-	};
-#else // !USB_ENDPOINT_USE_ISOC
-	// ---- Standard Video Streaming Interface Descriptor ----
-	{
-		USB_UVC_VS_StandardInterfaceDescriptor c = {
-				sizeof(USB_UVC_VS_StandardInterfaceDescriptor), /* interface_video_stream.bLength */
-				USB_DESCRIPTOR_TYPE_INTERFACE, /* interface_video_stream.bDescriptorType */
-				1, /* interface_video_stream.bInterfaceNumber */
-				0x01, /* interface_video_stream.bAlternateSetting */
-				0x01, /* interface_video_stream.bNumEndpoints */
-				USB_CLASS_VIDEO, /* interface_video_stream.bInterfaceClass */
-				USB_SUBCLASS_VIDEO_VIDEOSTREAMING, /* interface_video_stream.bInterfaceSubClass */
-				USB_PROTOCOL_VIDEO_UNDEFINED, /* interface_video_stream.bInterfaceProtocol */
-				0x00 /* interface_video_stream.iInterface */
-		};
-
-		ADD_CONFIG_DESCRIPTOR(pCdEnd_hs, c);
-		ADD_CONFIG_DESCRIPTOR_LEN(c, lenConfigDescriptor_hs);
-	};
-
-	// ---- ENDPOINT DESCRIPTOR ----
-	{
-		USB_UVC_VS_IsochronousVideoDataEndpointDescriptor c = {
-				sizeof(USB_UVC_VS_IsochronousVideoDataEndpointDescriptor), /* endpoint_bulk_in.bLength */
-				USB_DESCRIPTOR_TYPE_ENDPOINT, /* endpoint_bulk_in.bDescriptorType */
-				USB_ENDPOINT_DESCRIPTOR_EPADDR_IN | UVC_EP_DATA_IN, /* endpoint_bulk_in.bEndpointAddress */
-				USB_ENDPOINT_DESCRIPTOR_ATTR_ISOCHRONOUS /*|
-			USB_ENDPOINT_DESCRIPTOR_ISOCHRONOUS_ASYNCHRONOUS*/, /* endpoint_bulk_in.bmAttributes */
-			/*USB_ENDPOINT_DESCRIPTOR_MAXPACKET_ADDN_TRANSACTION_1 |*/ UVC_DATA_EP_SIZE_HS, /* endpoint_bulk_in.wMaxPacketSize */
-			0x01, /* endpoint_bulk_in.bInterval */
-		};
-
-		ADD_CONFIG_DESCRIPTOR(pCdEnd_hs, c);
-		ADD_CONFIG_DESCRIPTOR_LEN(c, lenConfigDescriptor_hs);
-	};
+uint32_t usb_uvc_get_missed_microframes()
+{
+	return uvc_missed_microframes;
+}
 #endif // USB_ENDPOINT_USE_ISOC
 
-#ifdef USB_INTERFACE_USE_DFU
-	// ---- INTERFACE DESCRIPTOR for DFU Interface ----
-	{
-		USB_interface_descriptor c = {
-				sizeof(USB_interface_descriptor), /* dfu_interface.bLength */
-				USB_DESCRIPTOR_TYPE_INTERFACE, /* dfu_interface.bDescriptorType */
-				DFU_USB_INTERFACE_RUNTIME, /* dfu_interface.bInterfaceNumber */
-				0x00, /* dfu_interface.bAlternateSetting */
-				0x00, /* dfu_interface.bNumEndpoints */
-				USB_CLASS_APPLICATION, /* dfu_interface.bInterfaceClass */ // bInterfaceClass: Application Specific Class
-				USB_SUBCLASS_DFU, /* dfu_interface.bInterfaceSubClass */ // bInterfaceSubClass: Device Firmware Update
-				USB_PROTOCOL_DFU_RUNTIME, /* dfu_interface.bInterfaceProtocol */ // bInterfaceProtocol: Runtime Protocol
-				0x05 /* dfu_interface.iInterface */       // * iInterface: "DFU Interface"
-		};
-
-		ADD_CONFIG_DESCRIPTOR(pCdEnd_hs, c);
-		ADD_CONFIG_DESCRIPTOR_LEN(c, lenConfigDescriptor_hs);
-	};
-
-	// ---- FUNCTIONAL DESCRIPTOR for DFU Interface ----
-	{
-		USB_dfu_functional_descriptor c = {
-				sizeof(USB_dfu_functional_descriptor), /* dfu_functional.bLength */
-				USB_DESCRIPTOR_TYPE_DFU_FUNCTIONAL, /* dfu_functional.bDescriptorType */
-				DFU_ATTRIBUTES, /* dfu_functional.bmAttributes */  	// bmAttributes
-				DFU_TIMEOUT, /* dfu_functional.wDetatchTimeOut */ // wDetatchTimeOut
-				DFU_TRANSFER_SIZE, /* dfu_functional.wTransferSize */     // wTransferSize
-				USB_BCD_VERSION_DFU_1_1 /* dfu_functional.bpCdEndDfuVersion */ // bpCdEndDfuVersion: DFU Version 1.1
-		};
+void usb_uvc_build_configuration(uint16_t module)
+{
+	uint8_t defaultFormat = 1;
+	uint8_t defaultFrame = 1;
 
-		ADD_CONFIG_DESCRIPTOR(pCdEnd_hs, c);
-		ADD_CONFIG_DESCRIPTOR_LEN(c, lenConfigDescriptor_hs);
-	};
-#endif // USB_INTERFACE_USE_DFU
+	// The module ID is added to the serial number string when it is sent.
+	serial_module = module;
 
-	pConfigDescriptor_hs->wTotalLength = lenConfigDescriptor_hs;
-	pConfigDescriptor_fs->wTotalLength = lenConfigDescriptor_fs;
+	uvc_probe.bFrameIndex = uvc_probe_def.bFrameIndex = defaultFrame;
+	uvc_probe.bFormatIndex = uvc_probe_def.bFormatIndex = defaultFormat;
+	// Setup the default probe settings.
+	class_vs_check_probecommit(&uvc_probe_def);
 
-	// Find the serial number string in the string descriptor table
-	serial = 3; // serial number is the third string
-	i = 0;
-	src = (uint8_t *)string_descriptor;
+	// Setup probe and commit settings.
+	memcpy(&uvc_probe, &uvc_probe_def, sizeof(USB_UVC_VideoProbeAndCommitControls));
+	memset(&uvc_commit, 0, sizeof(USB_UVC_VideoProbeAndCommitControls));
+}
 
-#define TO_HEX(A) ((A) <= 9 ? '0' + (A) : 'A' - 10 + (A))
+int8_t usb_uvc_bandwidth_ok(USBD_DEVICE_SPEED speed, uint16_t width, uint16_t height,
+		uint8_t frame_rate, int8_t format)
+{
+	uint32_t rate = (uint32_t)width * height * class_vs_format_bbp(format) * frame_rate;
 
-	while ((slen = ((uint8_t *)string_descriptor)[i]) > 0)
+#ifdef USB_ENDPOINT_USE_ISOC
+	// The number of bytes to send must not be greater than the theoretical
+	// maximum number of bytes that may be sent by an isochronous
+	// endpoint. Access constraints are 1 icochronous transfer per
+	// microframe on Rev A and Rev B devices and 1 per frame at Full Speed.
+	if (speed == USBD_SPEED_HIGH)
 	{
-		src = (uint8_t *) &((uint8_t *)string_descriptor)[i];
-		if (serial == 0)
-		{
-			break;
-		}
-		i += slen;
-		serial--;
+		return (rate <= ((UVC_DATA_EP_SIZE_HS - sizeof(USB_UVC_Payload_Header_PTS_SCR)) * 8 * 1000));
 	}
-	if (serial == 0)
+	return (rate <= ((UVC_DATA_EP_SIZE_FS - sizeof(USB_UVC_Payload_Header_PTS_SCR)) * 1000));
+#else // !USB_ENDPOINT_USE_ISOC
+	// BULK transfers at High Speed are not limited for bandwidth through
+	// bus access constraints. At Full Speed only a few packets fit in
+	// each frame.
+	if (speed == USBD_SPEED_HIGH)
 	{
-		src[2] = TO_HEX((module >> 12)&0x0f);
-		src[4] = TO_HEX((module >> 8)&0x0f);
-		src[6] = TO_HEX((module >> 4)&0x0f);
-		src[8] = TO_HEX((module >> 0)&0x0f);
+		return 1;
 	}
+	return (rate <= (UVC_BULK_FRAME_BYTES_FS * 1000UL));
+#endif // USB_ENDPOINT_USE_ISOC
+}
 
-	uvc_probe.bFrameIndex = uvc_probe_def_hs.bFrameIndex = defaultFrame;
-	uvc_probe.bFormatIndex = uvc_probe_def_hs.bFormatIndex = defaultFormat;
-	// Setup the default probe settings.
-	class_vs_check_probecommit(&uvc_probe_def_hs);
-
-	// Setup probe and commit settings.
-	if (usb_speed == USBD_SPEED_HIGH)
+uint8_t usb_uvc_get_frame_count_fs(int8_t format)
+{
+	if (format == CAMERA_FORMAT_UNCOMPRESSED)
 	{
-		memcpy(&uvc_probe, &uvc_probe_def_hs, sizeof(USB_UVC_VideoProbeAndCommitControls));
+		return CAMERA_FRAME_COUNT_UNCOMPRESSED_FS;
 	}
-	else
+	if (format == CAMERA_FORMAT_LUMA)
 	{
-		memset(&uvc_probe, 0, sizeof(USB_UVC_VideoProbeAndCommitControls));
+		return CAMERA_FRAME_COUNT_LUMA_FS;
 	}
-	memset(&uvc_commit, 0, sizeof(USB_UVC_VideoProbeAndCommitControls));
-}
-
-int8_t usb_uvc_bandwidth_ok(uint16_t width, uint16_t height, uint8_t frame_rate)
-{
-#ifdef USB_ENDPOINT_USE_ISOC
-	if (width * height * 2 * frame_rate >
-				((UVC_DATA_EP_SIZE_HS - sizeof(USB_UVC_Payload_Header)) * 8 * 1000))
+	if (format == CAMERA_FORMAT_MJPEG)
 	{
-		// The number of bytes to send is greater than the theoretical
-		// maximum number of bytes that may be sent by an isochronous
-		// endpoint. Access constraints are 1 icochronous transfer per
-		// microframe on Rev A and Rev B devices.
-		return 0;
+		return CAMERA_FRAME_COUNT_MJPEG_FS;
 	}
-	return 1;
-#else // !USB_ENDPOINT_USE_ISOC
-	// BULK transfers are not limited for bandwidth through bus access
-	// constraints.
-	return 1;
-#endif // USB_ENDPOINT_USE_ISOC
+	return 0;
 }
 
 uint16_t usb_uvc_init()
@@ -2201,21 +2696,31 @@ uint16_t usb_uvc_init()
 	if (usb_speed == USBD_SPEED_HIGH)
 	{
 #ifdef USB_ENDPOINT_USE_ISOC
+		// Double buffered so that the packet for the next microframe can
+		// be loaded while the current one is sent.
 		USBD_create_endpoint(UVC_EP_DATA_IN, USBD_EP_ISOC, USBD_DIR_IN,
-				UVC_DATA_USBD_EP_SIZE_HS, USBD_DB_OFF, NULL /*ep_cb*/);
+				UVC_DATA_USBD_EP_SIZE_HS, USBD_DB_ON, class_vs_data_ep_cb);
 #else // !USB_ENDPOINT_USE_ISOC
 		USBD_create_endpoint(UVC_EP_DATA_IN, USBD_EP_BULK, USBD_DIR_IN,
-				UVC_DATA_USBD_EP_SIZE_HS, USBD_DB_ON, NULL /*ep_cb*/);
+				UVC_DATA_USBD_EP_SIZE_HS, USBD_DB_ON, class_vs_data_ep_cb);
 #endif // USB_ENDPOINT_USE_ISOC
 		packet_len = UVC_DATA_EP_SIZE_HS;
+#ifdef USB_ENDPOINT_USE_ISOC
+		uvc_isoc_alt_size = uvc_isoc_alt_size_hs;
+#endif // USB_ENDPOINT_USE_ISOC
 	}
 	else
 	{
+		// Full Speed offers only the Full Speed camera modes.
 #ifdef USB_ENDPOINT_USE_ISOC
 		USBD_create_endpoint(UVC_EP_DATA_IN, USBD_EP_ISOC, USBD_DIR_IN,
-				UVC_DATA_USBD_EP_SIZE_FS, USBD_DB_ON, NULL /*ep_cb*/);
-		packet_len = UVC_DATA_EP_SIZE_FS;
+				UVC_DATA_USBD_EP_SIZE_FS, USBD_DB_ON, class_vs_data_ep_cb);
+		uvc_isoc_alt_size = uvc_isoc_alt_size_fs;
+#else // !USB_ENDPOINT_USE_ISOC
+		USBD_create_endpoint(UVC_EP_DATA_IN, USBD_EP_BULK, USBD_DIR_IN,
+				UVC_DATA_USBD_EP_SIZE_FS, USBD_DB_ON, class_vs_data_ep_cb);
 #endif // USB_ENDPOINT_USE_ISOC
+		packet_len = UVC_DATA_EP_SIZE_FS;
 	}
 	return packet_len;
 }
@@ -2236,7 +2741,11 @@ void usb_uvc_setup()
 	usb_ctx.suspend_cb = suspend_cb;
 	usb_ctx.resume_cb = resume_cb;
 	usb_ctx.reset_cb = reset_cb;
+#ifdef USB_ENDPOINT_USE_ISOC
+	usb_ctx.sof_cb = class_vs_sof_cb;
+#else // !USB_ENDPOINT_USE_ISOC
 	usb_ctx.sof_cb = NULL;
+#endif // USB_ENDPOINT_USE_ISOC
 	usb_ctx.lpm_cb = NULL;
 	usb_ctx.speed = USBD_SPEED_HIGH;
 
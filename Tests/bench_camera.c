@@ -0,0 +1,140 @@
+/**
+  @file bench_camera.c
+  @brief Host benchmark of camera_read with the camera ISR feeding lines.
+  @details The camera ISR fills the camera buffer with lines from the
+  simulated camera module until it is full. The buffer is then emptied
+  with camera_read and only that part is timed. This repeats for
+  BENCH_LINES lines.
+  Reads per second are host figures for the read path alone. Calls to
+  cam_disable_interrupt are counted for each read. The ring buffer used
+  to call cam_disable_interrupt and cam_enable_interrupt around every
+  read to update a shared byte count. Those are empty stubs on the host,
+  so the old cost of masking shows up only in the count and not in the
+  host time.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "../Sources/camera.c"
+
+#include "test.h"
+
+/// Lines sent by the camera module for each measurement.
+#define BENCH_LINES 200000
+
+/// Number of times each measurement is repeated. The fastest is kept.
+#define BENCH_REPEATS 5
+
+/// RAM handed to camera.c in place of the free RAM found by camera_init.
+static uint8_t bench_buffer[0x14000] __attribute__((aligned(4)));
+
+static uint32_t bench_reads;
+
+/** @brief Set up and start a mode from the camera mode table.
+ */
+static int8_t bench_start(int8_t format, int8_t frame, uint16_t max_sample)
+{
+	uint16_t width, height, image_width, image_height, x, y;
+
+	CAMERA_start_fn = epuck_start;
+	CAMERA_stop_fn = epuck_stop;
+	CAMERA_set_fn = epuck_set;
+	CAMERA_supports_fn = epuck_supports;
+	camera_buffer_ptr = bench_buffer;
+	camera_buffer_length = sizeof(bench_buffer);
+
+	camera_mode_get_frame(format, frame, &width, &height);
+	camera_mode_get_window(format, frame, &image_width, &image_height, &x, &y);
+	if ((camera_set(image_width, image_height, CAMERA_FRAME_RATE_ANY, format, max_sample) != 0) ||
+			(camera_set_window(x, y, width, height) != 0))
+	{
+		return -1;
+	}
+	camera_set_decimation(1);
+	camera_start();
+	return 0;
+}
+
+/** @brief Send one line from the camera module and run the camera ISR.
+ */
+static void bench_feed_line(void)
+{
+	stub_cam_fifo = camera_sample_length;
+	cam_ISR();
+}
+
+/** @brief Time reading BENCH_LINES lines.
+ *  @returns Nanoseconds spent in camera_read.
+ */
+static double bench_time(void)
+{
+	struct timespec start, end;
+	double ns = 0;
+	uint32_t lines = 0;
+
+	bench_reads = 0;
+	stub_cam_masks = 0;
+
+	while (lines < BENCH_LINES)
+	{
+		// Fill the camera buffer. Lines from the camera module which are
+		// not kept are skipped by the ISR.
+		while ((lines < BENCH_LINES) &&
+				(camera_buffer_size - (camera_wr_total - camera_rd_total) >= camera_line_length))
+		{
+			if ((lines % CAMERA_FRAME_HEIGHT_VGA) == 0)
+			{
+				camera_vsync_isr(lines / CAMERA_FRAME_HEIGHT_VGA);
+			}
+			bench_feed_line();
+			lines++;
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		while (camera_read())
+		{
+			bench_reads++;
+		}
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		ns += ((end.tv_sec - start.tv_sec) * 1e9) + (end.tv_nsec - start.tv_nsec);
+	}
+
+	return ns;
+}
+
+static void bench_mode(const char *name, int8_t format, int8_t frame, uint16_t max_sample)
+{
+	double ns_best = 1e18;
+	double ns;
+	uint8_t i;
+
+	if (bench_start(format, frame, max_sample) != 0)
+	{
+		printf("%-18s not supported\n", name);
+		return;
+	}
+
+	for (i = 0; i < BENCH_REPEATS; i++)
+	{
+		ns = bench_time();
+		ns_best = (ns < ns_best) ? ns : ns_best;
+	}
+
+	printf("%-18s %4u byte samples, %6.1f ns per read, %6.2f M reads/s, %4.2f masks per read\n",
+			name, read_sample_length, ns_best / bench_reads,
+			(bench_reads * 1e3) / ns_best,
+			(double)stub_cam_masks / bench_reads);
+	camera_stop();
+}
+
+int main(void)
+{
+	bench_mode("VGA YUYV", CAMERA_FORMAT_UNCOMPRESSED, 2, 1280);
+	bench_mode("QVGA YUYV", CAMERA_FORMAT_UNCOMPRESSED, 1, 320);
+	bench_mode("QQVGA luma", CAMERA_FORMAT_LUMA, 0, 40);
+
+	return 0;
+}
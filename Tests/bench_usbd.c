@@ -0,0 +1,138 @@
+/**
+  @file bench_usbd.c
+  @brief Host benchmark of USBD_stream_in against USBD_transfer_ex.
+  @details Sends isochronous style payloads of a 12 byte header and 500
+  bytes of data as one 512 byte packet each. The old data path writes the
+  header with USBD_TRANSFER_EX_PART_NO_SEND and then the data with
+  USBD_transfer_ex. The new one writes both fragments with a single
+  USBD_stream_in call.
+  The endpoint registers are simulated and the host takes each packet at
+  once. Packets and register accesses per payload are counted exactly.
+  The time per payload is host time. It only shows the difference in call
+  overhead as host builds write the FIFO a byte at a time in both paths.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "../Sources/usbd.c"
+
+/// Number of payloads sent for each measurement.
+#define BENCH_PAYLOADS 200000
+
+static uint8_t bench_sr[USBD_MAX_ENDPOINT_COUNT];
+static uint8_t bench_fifo;
+static uint32_t bench_sr_count;
+static uint32_t bench_fifo_count;
+static uint32_t bench_masked_count;
+static uint32_t bench_packet_count;
+
+volatile uint8_t *stub_usbd_ep_sr(uint8_t ep_number)
+{
+	// A packet handed over by the last write is taken by the host at once.
+	if (bench_sr[ep_number] & MASK_USBD_EPxSR_INPRDY)
+	{
+		bench_packet_count++;
+	}
+	bench_sr[ep_number] = 0;
+	bench_sr_count++;
+	return &bench_sr[ep_number];
+}
+
+volatile uint8_t *stub_usbd_ep_fifo(uint8_t ep_number)
+{
+	(void)ep_number;
+	bench_fifo_count++;
+	bench_masked_count += (stub_critical_depth != 0);
+	return &bench_fifo;
+}
+
+static uint8_t bench_header[12];
+static uint8_t bench_data[500];
+
+static void bench_transfer_ex(void)
+{
+	USBD_transfer_ex(USBD_EP_2, bench_header, sizeof(bench_header),
+			USBD_TRANSFER_EX_PART_NO_SEND, 0);
+	USBD_transfer_ex(USBD_EP_2, bench_data, sizeof(bench_data),
+			USBD_TRANSFER_EX_PART_NORMAL, sizeof(bench_header));
+}
+
+static void bench_stream_in(void)
+{
+	USBD_stream_fragment frag[2];
+	size_t offset = 0;
+
+	frag[0].data = bench_header;
+	frag[0].length = sizeof(bench_header);
+	frag[1].data = bench_data;
+	frag[1].length = sizeof(bench_data);
+	USBD_stream_in(USBD_EP_2, frag, 2, &offset, USBD_STREAM_IN_END);
+}
+
+/// Number of times each measurement is repeated. The fastest is kept.
+#define BENCH_REPEATS 10
+
+/** @brief Time sending BENCH_PAYLOADS payloads.
+ *  @returns Nanoseconds per payload.
+ */
+static double bench_time(void (*send)(void))
+{
+	struct timespec start, end;
+	uint32_t i;
+
+	bench_sr_count = 0;
+	bench_fifo_count = 0;
+	bench_masked_count = 0;
+	bench_packet_count = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < BENCH_PAYLOADS; i++)
+	{
+		send();
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	return (((end.tv_sec - start.tv_sec) * 1e9) + (end.tv_nsec - start.tv_nsec)) / BENCH_PAYLOADS;
+}
+
+static void bench_print(const char *name, double ns)
+{
+	printf("%-18s %4.2f packets, %4.2f SR accesses, %6.1f FIFO writes, %4.1f masked FIFO writes, %6.1f ns per payload\n",
+			name,
+			(double)bench_packet_count / BENCH_PAYLOADS,
+			(double)bench_sr_count / BENCH_PAYLOADS,
+			(double)bench_fifo_count / BENCH_PAYLOADS,
+			(double)bench_masked_count / BENCH_PAYLOADS,
+			ns);
+}
+
+int main(void)
+{
+	double ns_transfer_ex = 1e9;
+	double ns_stream_in = 1e9;
+	double ns;
+	uint8_t i;
+
+	USBD_create_endpoint(USBD_EP_0, USBD_EP_CTRL, USBD_DIR_OUT, USBD_EP_SIZE_64, USBD_DB_OFF, NULL);
+	USBD_create_endpoint(USBD_EP_2, USBD_EP_BULK, USBD_DIR_IN, USBD_EP_SIZE_512, USBD_DB_ON, NULL);
+
+	// The two are run in turn so that both see the same host load.
+	for (i = 0; i < BENCH_REPEATS; i++)
+	{
+		ns = bench_time(bench_transfer_ex);
+		ns_transfer_ex = (ns < ns_transfer_ex) ? ns : ns_transfer_ex;
+		ns = bench_time(bench_stream_in);
+		ns_stream_in = (ns < ns_stream_in) ? ns : ns_stream_in;
+	}
+
+	// Run each once more for its counts.
+	bench_time(bench_transfer_ex);
+	bench_print("USBD_transfer_ex", ns_transfer_ex);
+	bench_time(bench_stream_in);
+	bench_print("USBD_stream_in", ns_stream_in);
+
+	return 0;
+}
@@ -0,0 +1,106 @@
+/**
+  @file ft900.h
+  @brief Host stand-in for the FT900 peripheral library header.
+  @details Declares only what the firmware sources under test use. The
+  camera interface is simulated by stubs.c.
+ */
+
+#ifndef TESTS_FT900_H_
+#define TESTS_FT900_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <registers/ft900_registers.h>
+
+#define PACK __attribute__((packed))
+
+/* Program memory is ordinary memory on the host. */
+#define __flash__
+#define memcpy_pm2dat(dst, src, size) memcpy((dst), (src), (size))
+
+/* Interrupt masking is counted so that tests can check where it is used. */
+extern int stub_critical_depth;
+#define CRITICAL_SECTION_BEGIN { stub_critical_depth++;
+#define CRITICAL_SECTION_END stub_critical_depth--; }
+
+/* Camera interface registers. Reads of CAM_REG3 return camera FIFO data. */
+typedef struct
+{
+	volatile uint32_t CAM_REG1;
+	volatile uint32_t CAM_REG2;
+	volatile uint32_t CAM_REG3;
+} ft900_cam_regs_t;
+
+extern ft900_cam_regs_t *CAM;
+
+typedef enum
+{
+	cam_trigger_mode_0,
+	cam_trigger_mode_1,
+} cam_trigger_mode_t;
+
+typedef enum
+{
+	cam_clock_pol_falling,
+	cam_clock_pol_raising,
+} cam_clock_pol_t;
+
+typedef enum
+{
+	interrupt_usb_device = 3,
+	interrupt_camera = 20,
+} interrupt_t;
+
+typedef enum
+{
+	pad_gpio3,
+	pad_vbus_dtc,
+} pad_func_t;
+
+typedef enum
+{
+	pad_pull_none,
+	pad_pull_pullup,
+	pad_pull_pulldown,
+} pad_pull_t;
+
+typedef enum
+{
+	pad_dir_input,
+	pad_dir_output,
+} pad_dir_t;
+
+typedef enum
+{
+	sys_device_usb_device = 1,
+	sys_device_camera = 2,
+} sys_device_t;
+
+void cam_init(cam_trigger_mode_t triggers, cam_clock_pol_t clkpol);
+void cam_start(uint16_t count);
+void cam_stop(void);
+uint16_t cam_available(void);
+void cam_flush(void);
+void cam_set_threshold(uint16_t count);
+void cam_enable_interrupt(void);
+void cam_disable_interrupt(void);
+
+int8_t interrupt_attach(interrupt_t interrupt, uint8_t priority, void (*func)(void));
+
+int8_t gpio_function(uint8_t num, pad_func_t func);
+int8_t gpio_dir(uint8_t num, pad_dir_t dir);
+int8_t gpio_pull(uint8_t num, pad_pull_t pull);
+int8_t gpio_read(uint8_t num);
+int8_t gpio_interrupt_disable(uint8_t num);
+
+int8_t sys_enable(sys_device_t dev);
+int8_t sys_disable(sys_device_t dev);
+int8_t sys_check_ft900_revB(void);
+
+void delayms(uint32_t t);
+void delayus(uint32_t t);
+
+#endif /* TESTS_FT900_H_ */
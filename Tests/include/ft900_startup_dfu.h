@@ -0,0 +1,12 @@
+/**
+  @file ft900_startup_dfu.h
+  @brief Host stand-in. Nothing from this header is used by the sources
+  under test.
+ */
+
+#ifndef TESTS_FT900_STARTUP_DFU_H_
+#define TESTS_FT900_STARTUP_DFU_H_
+
+#include <ft900.h>
+
+#endif /* TESTS_FT900_STARTUP_DFU_H_ */
@@ -0,0 +1,11 @@
+/**
+  @file ft900_sys.h
+  @brief Host stand-in. The declarations are in ft900.h.
+ */
+
+#ifndef TESTS_FT900_SYS_H_
+#define TESTS_FT900_SYS_H_
+
+#include <ft900.h>
+
+#endif /* TESTS_FT900_SYS_H_ */
@@ -0,0 +1,12 @@
+/**
+  @file ft900_uart_simple.h
+  @brief Host stand-in. Nothing from this header is used by the sources
+  under test.
+ */
+
+#ifndef TESTS_FT900_UART_SIMPLE_H_
+#define TESTS_FT900_UART_SIMPLE_H_
+
+#include <ft900.h>
+
+#endif /* TESTS_FT900_UART_SIMPLE_H_ */
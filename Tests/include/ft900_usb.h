@@ -0,0 +1,170 @@
+/**
+  @file ft900_usb.h
+  @brief Host stand-in for the FT900 USB definitions header.
+ */
+
+#ifndef TESTS_FT900_USB_H_
+#define TESTS_FT900_USB_H_
+
+#include <ft900.h>
+
+#define LSB(x) ((uint8_t)((x) & 0xff))
+#define MSB(x) ((uint8_t)(((x) >> 8) & 0xff))
+typedef struct PACK {
+	uint8_t bmRequestType;
+	uint8_t bRequest;
+	uint16_t wValue;
+	uint16_t wIndex;
+	uint16_t wLength;
+} USB_device_request;
+
+typedef struct PACK {
+	uint8_t bLength;
+	uint8_t bDescriptorType;
+	uint16_t bcdUSB;
+	uint8_t bDeviceClass;
+	uint8_t bDeviceSubClass;
+	uint8_t bDeviceProtocol;
+	uint8_t bMaxPacketSize0;
+	uint16_t idVendor;
+	uint16_t idProduct;
+	uint16_t bcdDevice;
+	uint8_t iManufacturer;
+	uint8_t iProduct;
+	uint8_t iSerialNumber;
+	uint8_t bNumConfigurations;
+} USB_device_descriptor;
+
+typedef struct PACK {
+	uint8_t bLength;
+	uint8_t bDescriptorType;
+	uint16_t bcdUSB;
+	uint8_t bDeviceClass;
+	uint8_t bDeviceSubClass;
+	uint8_t bDeviceProtocol;
+	uint8_t bMaxPacketSize0;
+	uint8_t bNumConfigurations;
+	uint8_t bReserved;
+} USB_device_qualifier_descriptor;
+
+typedef struct PACK {
+	uint8_t bLength;
+	uint8_t bDescriptorType;
+	uint16_t wTotalLength;
+	uint8_t bNumInterfaces;
+	uint8_t bConfigurationValue;
+	uint8_t iConfiguration;
+	uint8_t bmAttributes;
+	uint8_t bMaxPower;
+} USB_configuration_descriptor;
+
+typedef struct PACK {
+	uint8_t bLength;
+	uint8_t bDescriptorType;
+	uint8_t bInterfaceNumber;
+	uint8_t bAlternateSetting;
+	uint8_t bNumEndpoints;
+	uint8_t bInterfaceClass;
+	uint8_t bInterfaceSubClass;
+	uint8_t bInterfaceProtocol;
+	uint8_t iInterface;
+} USB_interface_descriptor;
+
+typedef struct PACK {
+	uint8_t bLength;
+	uint8_t bDescriptorType;
+	uint8_t bmAttributes;
+	uint16_t wDetatchTimeOut;
+	uint16_t wTransferSize;
+	uint16_t bcdDfuVersion;
+} USB_dfu_functional_descriptor;
+
+typedef struct PACK USB_WCID_feature_descriptor {
+	uint32_t dwLength;
+	uint16_t bcdVersion;
+	uint16_t wIndex;
+	uint8_t bCount;
+	uint8_t rsv1[7];
+	uint8_t bFirstInterfaceNumber;
+	uint8_t rsv2;
+	char compatibleID[8];
+	uint8_t subCompatibleID[8];
+	uint8_t rsv3[6];
+} USB_WCID_feature_descriptor;
+
+enum {
+	USB_DESCRIPTOR_TYPE_DEVICE = 1,
+	USB_DESCRIPTOR_TYPE_CONFIGURATION = 2,
+	USB_DESCRIPTOR_TYPE_STRING = 3,
+	USB_DESCRIPTOR_TYPE_INTERFACE = 4,
+	USB_DESCRIPTOR_TYPE_ENDPOINT = 5,
+	USB_DESCRIPTOR_TYPE_DEVICE_QUALIFIER = 6,
+	USB_DESCRIPTOR_TYPE_OTHER_SPEED_CONFIGURATION = 7,
+	USB_DESCRIPTOR_TYPE_INTERFACE_ASSOCIATION = 11,
+	USB_DESCRIPTOR_TYPE_DFU_FUNCTIONAL = 0x21,
+};
+
+enum {
+	USB_BCD_VERSION_2_0 = 0x200,
+	USB_CLASS_MISCELLANEOUS = 0xef,
+	USB_SUBCLASS_COMMON_CLASS = 2,
+	USB_PROTOCOL_INTERFACE_ASSOCIATION = 1,
+	USB_VID_FTDI = 0x403,
+	USB_CLASS_DEVICE = 0,
+	USB_SUBCLASS_DEVICE = 0,
+	USB_PROTOCOL_DEVICE = 0,
+	USB_CLASS_APPLICATION = 0xfe,
+	USB_SUBCLASS_DFU = 1,
+	USB_PROTOCOL_DFU_DFUMODE = 2,
+	USB_PROTOCOL_DFU_RUNTIME = 1,
+	USB_BCD_VERSION_DFU_1_1 = 0x110,
+	USB_CONFIG_BMATTRIBUTES_SELF_POWERED = 0x40,
+	USB_CONFIG_BMATTRIBUTES_RESERVED_SET_TO_1 = 0x80,
+	USB_CONFIG_BMATTRIBUTES_REMOTE_WAKEUP = 0x20,
+	USB_MICROSOFT_WCID_STRING_LENGTH = 18,
+	USB_MICROSOFT_WCID_VERSION = 0x100,
+	USB_MICROSOFT_WCID_FEATURE_WINDEX_COMPAT_ID = 4,
+	USB_MICROSOFT_WCID_STRING_DESCRIPTOR = 0xee,
+	USB_BMREQUESTTYPE_DIR_MASK = 0x80,
+	USB_BMREQUESTTYPE_DIR_HOST_TO_DEV = 0,
+	USB_BMREQUESTTYPE_DIR_DEV_TO_HOST = 0x80,
+	USB_BMREQUESTTYPE_RECIPIENT_MASK = 0x1f,
+	USB_BMREQUESTTYPE_RECIPIENT_DEVICE = 0,
+	USB_BMREQUESTTYPE_RECIPIENT_INTERFACE = 1,
+	USB_BMREQUESTTYPE_RECIPIENT_ENDPOINT = 2,
+	USB_BMREQUESTTYPE_TYPE_MASK = 0x60,
+	USB_BMREQUESTTYPE_STANDARD = 0,
+	USB_BMREQUESTTYPE_CLASS = 0x20,
+	USB_BMREQUESTTYPE_VENDOR = 0x40,
+	USB_CLASS_REQUEST_DETACH = 0,
+	USB_CLASS_REQUEST_DNLOAD,
+	USB_CLASS_REQUEST_UPLOAD,
+	USB_CLASS_REQUEST_GETSTATUS,
+	USB_CLASS_REQUEST_CLRSTATUS,
+	USB_CLASS_REQUEST_GETSTATE,
+	USB_CLASS_REQUEST_ABORT,
+	USB_REQUEST_CODE_GET_STATUS = 0,
+	USB_REQUEST_CODE_CLEAR_FEATURE = 1,
+	USB_REQUEST_CODE_SET_FEATURE = 3,
+	USB_REQUEST_CODE_SET_ADDRESS = 5,
+	USB_REQUEST_CODE_GET_DESCRIPTOR = 6,
+	USB_REQUEST_CODE_GET_CONFIGURATION = 8,
+	USB_REQUEST_CODE_SET_CONFIGURATION = 9,
+	USB_REQUEST_CODE_GET_INTERFACE = 10,
+	USB_REQUEST_CODE_SET_INTERFACE = 11,
+	USB_ENDPOINT_DESCRIPTOR_EPADDR_IN = 0x80,
+	USB_ENDPOINT_DESCRIPTOR_ATTR_BULK = 2,
+	USB_ENDPOINT_DESCRIPTOR_ATTR_INTERRUPT = 3,
+	USB_ENDPOINT_DESCRIPTOR_ATTR_ISOCHRONOUS = 1,
+	USB_ENDPOINT_DESCRIPTOR_ISOCHRONOUS_ASYNCHRONOUS = 4,
+	USB_FEATURE_ENDPOINT_HALT = 0,
+	USB_FEATURE_DEVICE_REMOTE_WAKEUP = 1,
+	USB_FEATURE_TEST_MODE = 2,
+	USB_GET_STATUS_ENDPOINT_HALT = 1,
+	USB_GET_STATUS_DEVICE_REMOTE_WAKEUP = 2,
+	USB_GET_STATUS_DEVICE_SELF_POWERED = 1,
+};
+
+#define USB_MICROSOFT_WCID_STRING(x) 18, 3, 'M', 0, 'S', 0, 'F', 0, 'T', 0, '1', 0, '0', 0, '0', 0, x, 0
+
+#endif /* TESTS_FT900_USB_H_ */
@@ -0,0 +1,255 @@
+/**
+  @file ft900_usb_uvc.h
+  @brief Host stand-in for the FT900 USB video class header.
+ */
+
+#ifndef TESTS_FT900_USB_UVC_H_
+#define TESTS_FT900_USB_UVC_H_
+
+#include <ft900_usb.h>
+
+typedef struct PACK {
+	uint8_t bHeaderLength;
+	uint8_t bmHeaderInfo;
+} USB_UVC_Payload_Header;
+
+typedef struct PACK {
+	uint16_t bmHint;
+	uint8_t bFormatIndex;
+	uint8_t bFrameIndex;
+	uint32_t dwFrameInterval;
+	uint16_t wKeyFrameRate;
+	uint16_t wPFrameRate;
+	uint16_t wCompQuality;
+	uint16_t wCompWindowSize;
+	uint16_t wDelay;
+	uint32_t dwMaxVideoFrameSize;
+	uint32_t dwMaxPayloadTransferSize;
+	uint32_t dwClockFrequency;
+	uint8_t bmFramingInfo;
+	uint8_t bPreferedVersion;
+	uint8_t bMinVersion;
+	uint8_t bMaxVersion;
+} USB_UVC_VideoProbeAndCommitControls;
+
+typedef struct PACK {
+	uint8_t bLength;
+	uint8_t bDescriptorType;
+	uint8_t bFirstInterface;
+	uint8_t bInterfaceCount;
+	uint8_t bFunctionClass;
+	uint8_t bFunctionSubClass;
+	uint8_t bFunctionProtocol;
+	uint8_t iFunction;
+} USB_UVC_interface_association_descriptor;
+
+typedef USB_interface_descriptor USB_UVC_VC_StandardInterfaceDescriptor;
+typedef USB_interface_descriptor USB_UVC_VS_StandardInterfaceDescriptor;
+#define USB_UVC_VC_CSInterfaceHeaderDescriptor(n) struct PACK { \
+	uint8_t bLength; \
+	uint8_t bDescriptorType; \
+	uint8_t bDescriptorSubtype; \
+	uint16_t bcdUVC; \
+	uint16_t wTotalLength; \
+	uint32_t dwClockFrequency; \
+	uint8_t bInCollection; \
+	uint8_t baInterfaceNr[n]; \
+}
+
+#define USB_UVC_VC_CameraTerminalDescriptor(n) struct PACK { \
+	uint8_t bLength; \
+	uint8_t bDescriptorType; \
+	uint8_t bDescriptorSubtype; \
+	uint8_t bTerminalID; \
+	uint16_t wTerminalType; \
+	uint8_t bAssocTerminal; \
+	uint8_t iTerminal; \
+	uint16_t wObjectiveFocalLengthMin; \
+	uint16_t wObjectiveFocalLengthMax; \
+	uint16_t wOcularFocalLength; \
+	uint8_t bControlSize; \
+	uint8_t bmControls[n]; \
+}
+
+typedef struct PACK {
+	uint8_t bLength;
+	uint8_t bDescriptorType;
+	uint8_t bDescriptorSubtype;
+	uint8_t bTerminalID;
+	uint16_t wTerminalType;
+	uint8_t bAssocTerminal;
+	uint8_t bSourceID;
+	uint8_t iTerminal;
+} USB_UVC_VC_OutputTerminalDescriptor;
+
+#define USB_UVC_VC_ProcessingUnitDescriptor(n) struct PACK { \
+	uint8_t bLength; \
+	uint8_t bDescriptorType; \
+	uint8_t bDescriptorSubtype; \
+	uint8_t bUnitID; \
+	uint8_t bSourceID; \
+	uint16_t wMaxMultiplier; \
+	uint8_t bControlSize; \
+	uint8_t bmControls[n]; \
+	uint8_t iProcessing; \
+}
+
+typedef struct PACK {
+	uint8_t bLength;
+	uint8_t bDescriptorType;
+	uint8_t bEndpointAddress;
+	uint8_t bmAttributes;
+	uint16_t wMaxPacketSize;
+	uint8_t bInterval;
+} USB_UVC_VC_StandardInterruptEndpointDescriptor;
+
+typedef struct PACK {
+	uint8_t bLength;
+	uint8_t bDescriptorType;
+	uint8_t bDescriptorSubType;
+	uint16_t wMaxTransferSize;
+} USB_UVC_VC_CSEndpointDescriptor;
+
+#define USB_UVC_VS_CSInterfaceInputHeaderDescriptor(n) struct PACK { \
+	uint8_t bLength; \
+	uint8_t bDescriptorType; \
+	uint8_t bDescriptorSubType; \
+	uint8_t bNumFormats; \
+	uint16_t wTotalLength; \
+	uint8_t bEndpointAddress; \
+	uint8_t bmInfo; \
+	uint8_t bTerminalLink; \
+	uint8_t bStillCaptureMethod; \
+	uint8_t bTriggerSupport; \
+	uint8_t bTriggerUsage; \
+	uint8_t bControlSize; \
+	uint8_t bmaControls[n]; \
+}
+
+typedef struct PACK {
+	uint8_t bLength;
+	uint8_t bDescriptorType;
+	uint8_t bEndpointAddress;
+	uint8_t bmAttributes;
+	uint16_t wMaxPacketSize;
+	uint8_t bInterval;
+} USB_UVC_VS_BulkVideoDataEndpointDescriptor;
+
+typedef USB_UVC_VS_BulkVideoDataEndpointDescriptor USB_UVC_VS_IsochronousVideoDataEndpointDescriptor;
+typedef struct PACK {
+	uint8_t bLength;
+	uint8_t bDescriptorType;
+	uint8_t bDescriptorSubType;
+	uint8_t bFormatIndex;
+	uint8_t bNumFrameDescriptors;
+	uint8_t guidFormat[16];
+	uint8_t bBitsPerPixel;
+	uint8_t bDefaultFrameIndex;
+	uint8_t bAspectRatioX;
+	uint8_t bAspectRatioY;
+	uint8_t bmInterlaceFlags;
+	uint8_t bCopyProtect;
+} USB_UVC_VS_UncompressedVideoFormatDescriptor;
+
+typedef struct PACK {
+	uint8_t bLength;
+	uint8_t bDescriptorType;
+	uint8_t bDescriptorSubType;
+	uint8_t bFormatIndex;
+	uint8_t bNumFrameDescriptors;
+	uint8_t bmFlags;
+	uint8_t bDefaultFrameIndex;
+	uint8_t bAspectRatioX;
+	uint8_t bAspectRatioY;
+	uint8_t bmInterlaceFlags;
+	uint8_t bCopyProtect;
+} USB_UVC_VS_MJPEGVideoFormatDescriptor;
+
+#define USB_UVC_VS_UncompressedVideoFrameDescriptorDiscrete(n) struct PACK { \
+	uint8_t bLength; \
+	uint8_t bDescriptorType; \
+	uint8_t bDescriptorSubType; \
+	uint8_t bFrameIndex; \
+	uint8_t bmCapabilities; \
+	uint16_t wWidth; \
+	uint16_t wHeight; \
+	uint32_t dwMinBitRate; \
+	uint32_t dwMaxBitRate; \
+	uint32_t dwMaxVideoFrameBufferSize; \
+	uint32_t dwDefaultFrameInterval; \
+	uint8_t bFrameIntervalType; \
+	uint32_t dwFrameInterval[n]; \
+}
+
+#define USB_UVC_VS_MJPEGVideoFrameDescriptorDiscrete(n) USB_UVC_VS_UncompressedVideoFrameDescriptorDiscrete(n)
+typedef struct PACK {
+	uint8_t bLength;
+	uint8_t bDescriptorType;
+	uint8_t bDescriptorSubType;
+	uint8_t bColorPrimaries;
+	uint8_t bTransferCharacteristics;
+	uint8_t bMatrixCoefficients;
+} USB_UVC_ColorMatchingDescriptor;
+
+#define USB_UVC_GUID_YUY2 {'Y','U','Y','2',0,0,0x10,0,0x80,0,0,0xaa,0,0x38,0x9b,0x71}
+#define USB_UVC_GUID_NV12 {'N','V','1','2',0,0,0x10,0,0x80,0,0,0xaa,0,0x38,0x9b,0x71}
+enum {
+	USB_CLASS_VIDEO = 0x0e,
+	USB_SUBCLASS_VIDEO_INTERFACE_COLLECTION = 3,
+	USB_SUBCLASS_VIDEO_VIDEOCONTROL = 1,
+	USB_SUBCLASS_VIDEO_VIDEOSTREAMING = 2,
+	USB_PROTOCOL_VIDEO_UNDEFINED = 0,
+	USB_UVC_DESCRIPTOR_TYPE_CS_INTERFACE = 0x24,
+	USB_UVC_DESCRIPTOR_TYPE_CS_ENDPOINT = 0x25,
+	USB_UVC_DESCRIPTOR_SUBTYPE_VC_HEADER = 1,
+	USB_UVC_DESCRIPTOR_SUBTYPE_VC_INPUT_TERMINAL = 2,
+	USB_UVC_DESCRIPTOR_SUBTYPE_VC_OUTPUT_TERMINAL = 3,
+	USB_UVC_DESCRIPTOR_SUBTYPE_VC_PROCESSING_UNIT = 5,
+	USB_UVC_DESCRIPTOR_SUBTYPE_EP_INTERRUPT = 3,
+	USB_UVC_DESCRIPTOR_SUBTYPE_VS_INPUT_HEADER = 1,
+	USB_UVC_DESCRIPTOR_SUBTYPE_VS_FORMAT_UNCOMPRESSED = 4,
+	USB_UVC_DESCRIPTOR_SUBTYPE_VS_FRAME_UNCOMPRESSED = 5,
+	USB_UVC_DESCRIPTOR_SUBTYPE_VS_FORMAT_MJPEG = 6,
+	USB_UVC_DESCRIPTOR_SUBTYPE_VS_FRAME_MJPEG = 7,
+	USB_UVC_DESCRIPTOR_SUBTYPE_VS_COLORFORMAT = 0x0d,
+	USB_UVC_ITT_CAMERA = 0x201,
+	USB_UVC_TT_STREAMING = 0x101,
+	USB_UVC_REQUEST_RC_UNDEFINED = 0,
+	USB_UVC_REQUEST_SET_CUR = 1,
+	USB_UVC_REQUEST_SET_CUR_ALL = 0x11,
+	USB_UVC_REQUEST_GET_CUR = 0x81,
+	USB_UVC_REQUEST_GET_MIN,
+	USB_UVC_REQUEST_GET_MAX,
+	USB_UVC_REQUEST_GET_RES,
+	USB_UVC_REQUEST_GET_LEN,
+	USB_UVC_REQUEST_GET_INFO,
+	USB_UVC_REQUEST_GET_DEF,
+	USB_UVC_REQUEST_GET_CUR_ALL = 0x91,
+	USB_UVC_REQUEST_GET_MIN_ALL,
+	USB_UVC_REQUEST_GET_MAX_ALL,
+	USB_UVC_REQUEST_GET_RES_ALL,
+	USB_UVC_REQUEST_GET_DEF_ALL = 0x97,
+	USB_UVC_REQUEST_ERROR_CODE_CONTROL_NO_ERROR = 0,
+	USB_UVC_REQUEST_ERROR_CODE_CONTROL_INVALID_CONTROL = 6,
+	USB_UVC_REQUEST_ERROR_CODE_CONTROL_INVALID_REQUEST = 7,
+	USB_UVC_REQUEST_ERROR_CODE_CONTROL_INVALID_UNIT = 5,
+	USB_UVC_REQUEST_ERROR_CODE_CONTROL_OUT_OF_RANGE = 4,
+	USB_UVC_GET_INFO_RESPONSE_SUPPORTS_GET = 1,
+	USB_UVC_GET_INFO_RESPONSE_SUPPORTS_SET = 2,
+	USB_UVC_VC_VIDEO_POWER_MODE_CONTROL = 1,
+	USB_UVC_VC_REQUEST_ERROR_CODE_CONTROL = 2,
+	USB_UVC_VS_PROBE_CONTROL = 1,
+	USB_UVC_VS_COMMIT_CONTROL,
+	USB_UVC_VS_STILL_PROBE_CONTROL,
+	USB_UVC_VS_STILL_COMMIT_CONTROL,
+	USB_UVC_VS_STILL_IMAGE_TRIGGER_CONTROL,
+	USB_UVC_VS_STREAM_ERROR_CODE_CONTROL,
+	USB_UVC_VS_GENERATE_KEY_FRAME_CONTROL,
+	USB_UVC_VS_UPDATE_FRAME_SEGMENT_CONTROL,
+	USB_UVC_VS_SYNCH_DELAY_CONTROL,
+	USB_UVC_VS_PROBE_COMMIT_CONTROL_BMHINT_FRAMINGINFO = 1,
+	USB_UVC_VS_PROBE_COMMIT_CONTROL_BMFRAMINGINFO_FRAMEIDFIELD = 1,
+	USB_UVC_VS_PROBE_COMMIT_CONTROL_BMFRAMINGINFO_EOFFIELD = 2,
+};
+
+#endif /* TESTS_FT900_USB_UVC_H_ */
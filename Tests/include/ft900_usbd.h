@@ -0,0 +1,158 @@
+/**
+  @file ft900_usbd.h
+  @brief Host stand-in for the FT900 USB device API header.
+ */
+
+#ifndef TESTS_FT900_USBD_H_
+#define TESTS_FT900_USBD_H_
+
+#include <ft900_usb.h>
+
+typedef enum {
+	USBD_EP_0,
+	USBD_EP_1,
+	USBD_EP_2,
+	USBD_EP_3,
+	USBD_EP_4,
+	USBD_EP_5,
+	USBD_EP_6,
+	USBD_EP_7,
+} USBD_ENDPOINT_NUMBER;
+
+typedef enum {
+	USBD_EP_TYPE_DISABLED,
+	USBD_EP_BULK,
+	USBD_EP_INT,
+	USBD_EP_ISOC,
+	USBD_EP_CTRL,
+} USBD_ENDPOINT_TYPE;
+
+typedef enum {
+	USBD_DIR_OUT,
+	USBD_DIR_IN,
+} USBD_ENDPOINT_DIR;
+
+typedef enum {
+	USBD_EP_SIZE_8,
+	USBD_EP_SIZE_16,
+	USBD_EP_SIZE_32,
+	USBD_EP_SIZE_64,
+	USBD_EP_SIZE_128,
+	USBD_EP_SIZE_256,
+	USBD_EP_SIZE_512,
+	USBD_EP_SIZE_1023,
+} USBD_ENDPOINT_SIZE;
+
+typedef enum {
+	USBD_DB_OFF,
+	USBD_DB_ON,
+} USBD_ENDPOINT_DB;
+
+typedef enum {
+	USBD_SPEED_LOW,
+	USBD_SPEED_FULL,
+	USBD_SPEED_HIGH,
+} USBD_DEVICE_SPEED;
+
+typedef enum {
+	USBD_STATE_NONE,
+	USBD_STATE_ATTACHED,
+	USBD_STATE_POWERED,
+	USBD_STATE_DEFAULT,
+	USBD_STATE_ADDRESS,
+	USBD_STATE_CONFIGURED,
+	USBD_STATE_SUSPENDED = 0x10,
+} USBD_STATE;
+
+typedef enum {
+	USBD_TEST_J = 1,
+	USBD_TEST_K,
+	USBD_TEST_SE0_NAK,
+	USBD_TEST_PACKET,
+} USBD_TESTMODE_SELECT;
+
+/* Endpoint control register disable settings and FIFO RAM. */
+#define USBD_EP_DIS_BULK 1
+#define USBD_EP_DIS_INT 2
+#define USBD_EP_DIS_ISO 3
+#define USBD_RAMTOTAL_IN 4096
+#define USBD_RAMTOTAL_OUT 4096
+enum {
+	USBD_OK = 0,
+	USBD_ERR_NOT_SUPPORTED = -1,
+	USBD_ERR_INVALID_PARAMETER = -2,
+	USBD_ERR_NOT_CONFIGURED = -3,
+	USBD_ERR_RESOURCES = -4,
+	USBD_ERR_INCOMPLETE = -5,
+	USBD_ERR_DISCONNECTED = -6,
+};
+
+enum {
+	USBD_TRANSFER_EX_PART_NORMAL = 0,
+	USBD_TRANSFER_EX_PART_NO_SEND = 1,
+};
+
+typedef int8_t (*USBD_request_callback)(USB_device_request *req);
+typedef int8_t (*USBD_descriptor_callback)(USB_device_request *req, uint8_t **buffer, uint16_t *len);
+typedef int8_t (*USBD_set_configuration_callback)(USB_device_request *req);
+typedef int8_t (*USBD_set_interface_callback)(USB_device_request *req);
+typedef int8_t (*USBD_get_interface_callback)(USB_device_request *req, uint8_t *val);
+typedef void (*USBD_suspend_callback)(uint8_t status);
+typedef void (*USBD_reset_callback)(uint8_t status);
+typedef void (*USBD_sof_callback)(uint16_t frame);
+typedef int8_t (*USBD_ep_callback)(USBD_ENDPOINT_NUMBER ep_number);
+typedef struct {
+	USBD_request_callback standard_req_cb;
+	USBD_descriptor_callback get_descriptor_cb;
+	USBD_set_configuration_callback set_configuration_cb;
+	USBD_set_interface_callback set_interface_cb;
+	USBD_get_interface_callback get_interface_cb;
+	USBD_request_callback class_req_cb;
+	USBD_request_callback vendor_req_cb;
+	USBD_request_callback ep_feature_req_cb;
+	USBD_request_callback feature_req_cb;
+	USBD_suspend_callback suspend_cb;
+	USBD_suspend_callback resume_cb;
+	USBD_reset_callback reset_cb;
+	USBD_suspend_callback lpm_cb;
+	USBD_sof_callback sof_cb;
+	USBD_ep_callback ep0_cb;
+	USBD_DEVICE_SPEED speed;
+	USBD_ENDPOINT_SIZE ep0_size;
+} USBD_ctx;
+
+void USBD_initialise(USBD_ctx *);
+void USBD_attach(void);
+void USBD_detach(void);
+int8_t USBD_connect(void);
+int8_t USBD_is_connected(void);
+USBD_STATE USBD_get_state(void);
+void USBD_set_state(USBD_STATE);
+USBD_DEVICE_SPEED USBD_get_bus_speed(void);
+int8_t USBD_create_endpoint(USBD_ENDPOINT_NUMBER, USBD_ENDPOINT_TYPE, USBD_ENDPOINT_DIR, USBD_ENDPOINT_SIZE, USBD_ENDPOINT_DB, USBD_ep_callback);
+int8_t USBD_ep_buffer_full(USBD_ENDPOINT_NUMBER);
+int32_t USBD_transfer_ex(USBD_ENDPOINT_NUMBER, uint8_t *, size_t, uint8_t, size_t);
+int32_t USBD_transfer_ep0(USBD_ENDPOINT_DIR, uint8_t *, size_t, size_t);
+void USBD_wakeup(void);
+void USBD_resume(void);
+int8_t USBD_clear_endpoint(USBD_ENDPOINT_NUMBER);
+int8_t USBD_stall_endpoint(USBD_ENDPOINT_NUMBER);
+int8_t USBD_get_ep_stalled(USBD_ENDPOINT_NUMBER);
+int8_t USBD_req_set_address(USB_device_request *);
+void USBD_clear_remote_wakeup(void);
+void USBD_suspend_device(void);
+int8_t USBD_DFU_is_runtime(void);
+void USBD_DFU_reset(void);
+void USBD_DFU_class_req_detach(uint16_t);
+void USBD_DFU_class_req_getstatus(uint16_t);
+void USBD_DFU_class_req_getstate(uint16_t);
+void USBD_DFU_class_req_download(uint32_t, uint16_t);
+void USBD_DFU_class_req_upload(uint32_t, uint16_t);
+void USBD_DFU_class_req_clrstatus(void);
+void USBD_DFU_class_req_abort(void);
+#define USBD_DFU_ATTRIBUTES 0x0b
+#define USBD_DFU_MAX_BLOCK_SIZE 256
+#define USBD_DFU_TIMEOUT 10000
+uint16_t USBD_ep_max_size(USBD_ENDPOINT_NUMBER);
+
+#endif /* TESTS_FT900_USBD_H_ */
@@ -0,0 +1,118 @@
+/**
+  @file ft900_registers.h
+  @brief Host stand-in for the FT900 register definitions.
+  @details Registers are plain memory. The endpoint status and FIFO
+  registers of the USB device go through hooks in the test so that it can
+  see when they are accessed and with what interrupt masking.
+ */
+
+#ifndef TESTS_FT900_REGISTERS_H_
+#define TESTS_FT900_REGISTERS_H_
+
+#include <stdint.h>
+
+/* System registers. */
+typedef struct
+{
+	volatile uint8_t PMCFG_L;
+	volatile uint8_t PMCFG_H;
+	volatile uint32_t MSC0CFG;
+} ft900_sys_regs_t;
+
+extern ft900_sys_regs_t *SYS;
+
+#define MASK_SYS_PMCFG_DEV_PHY_EN (1 << 0)
+#define MASK_SYS_PMCFG_HOST_RESUME_DEV (1 << 1)
+#define MASK_SYS_PMCFG_DEV_CONN_DEV (1 << 2)
+#define MASK_SYS_PMCFG_DEV_DIS_DEV (1 << 3)
+#define MASK_SYS_PMCFG_DEV_DETECT_EN (1 << 4)
+
+#define MASK_SYS_MSC0CFG_DEV_RESET_ALL (1UL << 0)
+#define MASK_SYS_MSC0CFG_DEV_RMWAKEUP (1UL << 1)
+#define MASK_SYS_MSC0CFG_USB_VBUS_EN (1UL << 2)
+#define MASK_SYS_MSC0CFG_HIGH_SPED_MODE (1UL << 3)
+
+/* USB device registers. */
+typedef struct
+{
+	volatile uint8_t epxcr;
+	volatile uint8_t epxsr;
+	volatile uint16_t epxcnt;
+	volatile uint32_t epxfifo;
+} ft900_usbd_ep_regs_t;
+
+typedef struct
+{
+	volatile uint8_t fctrl;
+	volatile uint8_t faddr;
+	volatile uint8_t cmif;
+	volatile uint8_t cmie;
+	volatile uint16_t epif;
+	volatile uint16_t epie;
+	volatile uint16_t frame;
+	ft900_usbd_ep_regs_t ep[16];
+} ft900_usbd_regs_t;
+
+extern ft900_usbd_regs_t stub_usbd_regs;
+volatile uint8_t *stub_usbd_ep_sr(uint8_t ep_number);
+volatile uint8_t *stub_usbd_ep_fifo(uint8_t ep_number);
+
+#define USBD (&stub_usbd_regs)
+#define USBD_REG(x) (stub_usbd_regs.x)
+#define USBD_EP_CR_REG(x) (stub_usbd_regs.ep[x].epxcr)
+#define USBD_EP_CNT_REG(x) (stub_usbd_regs.ep[x].epxcnt)
+#define USBD_EP_SR_REG(x) (*stub_usbd_ep_sr(x))
+#define USBD_EP_FIFO_REG(x) (*stub_usbd_ep_fifo(x))
+
+#define MASK_USBD_FCTRL_USB_DEV_EN (1 << 0)
+#define MASK_USBD_FCTRL_MODE_FS_ONLY (1 << 1)
+#define MASK_USBD_FCTRL_IMP_PERF (1 << 2)
+#define MASK_USBD_FCTRL_TST_MODE_ENABLE (1 << 3)
+#define MASK_USBD_FCTRL_TST_MODE_SELECT0 (1 << 4)
+#define MASK_USBD_FCTRL_TST_MODE_SELECT1 (1 << 5)
+
+#define MASK_USBD_CMIF_PHYIRQ (1 << 0)
+#define MASK_USBD_CMIF_PIDIRQ (1 << 1)
+#define MASK_USBD_CMIF_CRC16IRQ (1 << 2)
+#define MASK_USBD_CMIF_CRC5IRQ (1 << 3)
+#define MASK_USBD_CMIF_RSTIRQ (1 << 4)
+#define MASK_USBD_CMIF_SUSIRQ (1 << 5)
+#define MASK_USBD_CMIF_RESIRQ (1 << 6)
+#define MASK_USBD_CMIF_SOFIRQ (1 << 7)
+#define MASK_USBD_CMIF_ALL 0xff
+
+#define MASK_USBD_CMIE_PHYIE (1 << 0)
+#define MASK_USBD_CMIE_PIDIE (1 << 1)
+#define MASK_USBD_CMIE_CRC16IE (1 << 2)
+#define MASK_USBD_CMIE_CRC5IE (1 << 3)
+#define MASK_USBD_CMIE_RSTIE (1 << 4)
+#define MASK_USBD_CMIE_SUSIE (1 << 5)
+#define MASK_USBD_CMIE_RESIE (1 << 6)
+#define MASK_USBD_CMIE_SOFIE (1 << 7)
+#define MASK_USBD_CMIE_ALL 0xff
+
+#define MASK_USBD_EPIF_EP0IRQ (1 << 0)
+#define MASK_USBD_EPIF_IRQ(x) (1 << (x))
+#define MASK_USBD_EPIE_EP0IE (1 << 0)
+
+#define MASK_USBD_EP0CR_SDSTL (1 << 0)
+#define BIT_USBD_EP0_MAX_SIZE 1
+
+#define MASK_USBD_EP0SR_OPRDY (1 << 0)
+#define MASK_USBD_EP0SR_INPRDY (1 << 1)
+#define MASK_USBD_EP0SR_STALL (1 << 2)
+#define MASK_USBD_EP0SR_DATAEND (1 << 3)
+#define MASK_USBD_EP0SR_SETUP (1 << 4)
+
+#define MASK_USBD_EPxCR_SDSTL (1 << 0)
+#define BIT_USBD_EP_MAX_SIZE 1
+#define BIT_USBD_EP_CONTROL_DIS 4
+#define MASK_USBD_EPxCR_DIR (1 << 6)
+#define MASK_USBD_EPxCR_DB (1 << 7)
+
+#define MASK_USBD_EPxSR_OPRDY (1 << 0)
+#define MASK_USBD_EPxSR_INPRDY (1 << 1)
+#define MASK_USBD_EPxSR_FIFO_FLUSH (1 << 6)
+#define MASK_USBD_EPxSR_CLR_TOGGLE (1 << 7)
+
+#endif /* TESTS_FT900_REGISTERS_H_ */
@@ -0,0 +1,176 @@
+/**
+  @file stubs.c
+  @brief Host stand-ins for the hardware used by the firmware sources.
+  @details The camera module behaves like the e-puck module. It always
+  sends VGA YUYV lines at 15 fps and smaller frames are scaled down by
+  the camera interface code.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <ft900.h>
+
+#include "camera.h"
+
+static ft900_cam_regs_t stub_cam_regs;
+ft900_cam_regs_t *CAM = &stub_cam_regs;
+
+static ft900_sys_regs_t stub_sys_regs;
+ft900_sys_regs_t *SYS = &stub_sys_regs;
+
+ft900_usbd_regs_t stub_usbd_regs;
+
+int stub_critical_depth = 0;
+
+uint16_t stub_cam_fifo = 0;
+uint32_t stub_cam_flushes = 0;
+uint32_t stub_cam_masks = 0;
+
+void cam_init(cam_trigger_mode_t triggers, cam_clock_pol_t clkpol)
+{
+	(void)triggers;
+	(void)clkpol;
+}
+
+void cam_start(uint16_t count)
+{
+	(void)count;
+}
+
+void cam_stop(void)
+{
+}
+
+uint16_t cam_available(void)
+{
+	return stub_cam_fifo;
+}
+
+void cam_flush(void)
+{
+	stub_cam_fifo = 0;
+	stub_cam_flushes++;
+}
+
+void cam_set_threshold(uint16_t count)
+{
+	(void)count;
+}
+
+void cam_enable_interrupt(void)
+{
+}
+
+void cam_disable_interrupt(void)
+{
+	stub_cam_masks++;
+}
+
+int8_t interrupt_attach(interrupt_t interrupt, uint8_t priority, void (*func)(void))
+{
+	(void)interrupt;
+	(void)priority;
+	(void)func;
+	return 0;
+}
+
+int8_t gpio_function(uint8_t num, pad_func_t func)
+{
+	(void)num;
+	(void)func;
+	return 0;
+}
+
+int8_t gpio_dir(uint8_t num, pad_dir_t dir)
+{
+	(void)num;
+	(void)dir;
+	return 0;
+}
+
+int8_t gpio_pull(uint8_t num, pad_pull_t pull)
+{
+	(void)num;
+	(void)pull;
+	return 0;
+}
+
+int8_t gpio_read(uint8_t num)
+{
+	(void)num;
+	return 1;
+}
+
+int8_t gpio_interrupt_disable(uint8_t num)
+{
+	(void)num;
+	return 0;
+}
+
+int8_t sys_enable(sys_device_t dev)
+{
+	(void)dev;
+	return 0;
+}
+
+int8_t sys_disable(sys_device_t dev)
+{
+	(void)dev;
+	return 0;
+}
+
+int8_t sys_check_ft900_revB(void)
+{
+	return 0;
+}
+
+void delayms(uint32_t t)
+{
+	(void)t;
+}
+
+void delayus(uint32_t t)
+{
+	(void)t;
+}
+
+uint16_t epuck_init(void)
+{
+	return 1;
+}
+
+void epuck_start(void)
+{
+}
+
+void epuck_stop(void)
+{
+}
+
+int8_t epuck_supports(uint16_t width, uint16_t height, int8_t frame_rate, int8_t format)
+{
+	(void)width;
+	(void)height;
+	(void)frame_rate;
+	(void)format;
+	return 0;
+}
+
+int8_t epuck_set(uint16_t width, uint16_t height, int8_t format,
+		int8_t *frame_rate, uint16_t *sample_size, uint32_t *frame_size)
+{
+	if ((*frame_rate != 15) && (*frame_rate != CAMERA_FRAME_RATE_ANY))
+	{
+		return -1;
+	}
+	*sample_size = CAMERA_FRAME_WIDTH_VGA * 2;
+	*frame_size = (uint32_t)width * height * ((format == CAMERA_FORMAT_LUMA)?1:2);
+	*frame_rate = 15;
+	return 0;
+}
+
+void tfp_printf(char *fmt, ...)
+{
+	(void)fmt;
+}
@@ -0,0 +1,106 @@
+/**
+  @file stubs_usbd.c
+  @brief Host stand-ins for the FT900 USB device API.
+  @details Records the endpoints created and the data sent on the control
+  endpoint so that tests can check them.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <ft900.h>
+#include <ft900_usb.h>
+#include <ft900_usbd.h>
+
+uint8_t stub_usb_speed = USBD_SPEED_HIGH;
+uint8_t stub_ep_db[USBD_EP_7 + 1];
+uint8_t stub_ep0_data[1024];
+uint16_t stub_ep0_length = 0;
+
+void USBD_initialise(USBD_ctx *ctx)
+{
+	(void)ctx;
+}
+
+USBD_DEVICE_SPEED USBD_get_bus_speed(void)
+{
+	return (USBD_DEVICE_SPEED)stub_usb_speed;
+}
+
+void USBD_set_state(USBD_STATE state)
+{
+	(void)state;
+}
+
+int8_t USBD_create_endpoint(USBD_ENDPOINT_NUMBER ep_number, USBD_ENDPOINT_TYPE ep_type,
+		USBD_ENDPOINT_DIR ep_dir, USBD_ENDPOINT_SIZE ep_size, USBD_ENDPOINT_DB ep_db,
+		USBD_ep_callback ep_cb)
+{
+	(void)ep_type;
+	(void)ep_dir;
+	(void)ep_size;
+	(void)ep_cb;
+	stub_ep_db[ep_number] = ep_db;
+	return USBD_OK;
+}
+
+uint16_t USBD_ep_max_size(USBD_ENDPOINT_NUMBER ep_number)
+{
+	(void)ep_number;
+	return 512;
+}
+
+int32_t USBD_transfer_ep0(USBD_ENDPOINT_DIR direction, uint8_t *buffer, size_t length, size_t req_length)
+{
+	(void)req_length;
+	if ((direction == USBD_DIR_IN) && (length <= sizeof(stub_ep0_data)))
+	{
+		memcpy(stub_ep0_data, buffer, length);
+		stub_ep0_length = length;
+	}
+	return length;
+}
+
+int8_t USBD_DFU_is_runtime(void)
+{
+	return 1;
+}
+
+void USBD_DFU_reset(void)
+{
+}
+
+void USBD_DFU_class_req_detach(uint16_t timeout)
+{
+	(void)timeout;
+}
+
+void USBD_DFU_class_req_getstatus(uint16_t length)
+{
+	(void)length;
+}
+
+void USBD_DFU_class_req_getstate(uint16_t length)
+{
+	(void)length;
+}
+
+void USBD_DFU_class_req_download(uint32_t address, uint16_t length)
+{
+	(void)address;
+	(void)length;
+}
+
+void USBD_DFU_class_req_upload(uint32_t address, uint16_t length)
+{
+	(void)address;
+	(void)length;
+}
+
+void USBD_DFU_class_req_clrstatus(void)
+{
+}
+
+void USBD_DFU_class_req_abort(void)
+{
+}
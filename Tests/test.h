@@ -0,0 +1,43 @@
+/**
+  @file test.h
+  @brief Minimal checks for the host tests.
+  @details Each test program includes the firmware source it tests so that
+  it can reach the static state. Hardware is simulated by stubs.c.
+ */
+
+#ifndef TESTS_TEST_H_
+#define TESTS_TEST_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+/// Number of failed checks in this test program.
+static int test_failures = 0;
+
+#define TEST_CHECK(cond) do { \
+	if (!(cond)) { \
+		printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+		test_failures++; \
+	} } while (0)
+
+#define TEST_RUN(fn) do { \
+	int before = test_failures; \
+	fn(); \
+	printf("%s %s\n", (test_failures == before)?"PASS":"FAIL", #fn); \
+	} while (0)
+
+#define TEST_RESULT() ((test_failures == 0)?0:1)
+
+/** @brief Simulated camera interface.
+ *  @details cam_available() returns stub_cam_fifo. Reads of CAM_REG3
+ *  return the value last written to it. cam_flush() empties the FIFO and
+ *  counts the flushes. Each call to cam_disable_interrupt() is counted in
+ *  stub_cam_masks.
+ */
+//@{
+extern uint16_t stub_cam_fifo;
+extern uint32_t stub_cam_flushes;
+extern uint32_t stub_cam_masks;
+//@}
+
+#endif /* TESTS_TEST_H_ */
@@ -0,0 +1,458 @@
+/**
+  @file test_camera.c
+  @brief Host tests for the camera buffer in camera.c.
+  @details The camera ISR and camera_read are called alternately in a
+  random order to simulate the interrupt preempting the main loop at any
+  point between calls. Lines from the simulated camera module have every
+  byte set to a line number so that a sample read from the camera buffer
+  shows which line it came from.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../Sources/camera.c"
+
+#include "test.h"
+
+/// Lines sent by the camera module per frame.
+#define TEST_MODULE_LINES CAMERA_FRAME_HEIGHT_VGA
+
+/// RAM handed to camera.c in place of the free RAM found by camera_init.
+static uint8_t test_buffer[0x14000] __attribute__((aligned(4)));
+
+/** @brief Set up and start a mode from the camera mode table.
+ *  @details Follows the same steps as a commit from the host.
+ */
+static int8_t test_start(int8_t format, int8_t frame, uint16_t max_sample, uint32_t buffer_length)
+{
+	uint16_t width, height, image_width, image_height, x, y;
+
+	CAMERA_start_fn = epuck_start;
+	CAMERA_stop_fn = epuck_stop;
+	CAMERA_set_fn = epuck_set;
+	CAMERA_supports_fn = epuck_supports;
+	camera_buffer_ptr = test_buffer;
+	camera_buffer_length = buffer_length;
+	memset(test_buffer, 0, sizeof(test_buffer));
+
+	camera_mode_get_frame(format, frame, &width, &height);
+	camera_mode_get_window(format, frame, &image_width, &image_height, &x, &y);
+	if ((camera_set(image_width, image_height, CAMERA_FRAME_RATE_ANY, format, max_sample) != 0) ||
+			(camera_set_window(x, y, width, height) != 0))
+	{
+		return -1;
+	}
+	camera_set_decimation(1);
+	camera_start();
+	return 0;
+}
+
+/** @brief Send one line from the camera module and run the camera ISR.
+ *  @returns Non-zero if the line was stored in the camera buffer.
+ */
+static uint8_t test_feed_line(uint8_t id)
+{
+	uint32_t wr_total = camera_wr_total;
+
+	CAM->CAM_REG3 = 0x01010101UL * id;
+	stub_cam_fifo = camera_sample_length;
+	cam_ISR();
+	return (camera_wr_total != wr_total);
+}
+
+/** @brief Check every byte of a sample is from the expected line.
+ */
+static uint8_t test_sample_is(const uint8_t *sample, uint16_t length, uint8_t id)
+{
+	for (; length; length--)
+	{
+		if (*sample++ != id)
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/** @brief Pseudo-random numbers so that each run is the same.
+ */
+static uint32_t test_random(void)
+{
+	static uint32_t seed = 12345;
+
+	seed = seed * 1103515245UL + 12345;
+	return (seed >> 16) & 0x7fff;
+}
+
+/** @brief Interleave the camera ISR and camera_read.
+ *  @details The reader is sometimes faster and sometimes slower than the
+ *  camera so that the buffer both empties and overruns. Every sample
+ *  returned must hold the next stored line in order, lie wholly inside the
+ *  buffer and stay intact until the following call to camera_read.
+ */
+static void test_ring_interleave(void)
+{
+	static const struct { int8_t format; int8_t frame; uint16_t sample; } cases[] = {
+		{CAMERA_FORMAT_UNCOMPRESSED, 1, 320},	// QVGA, every other module line
+		{CAMERA_FORMAT_UNCOMPRESSED, 2, 1280},	// VGA, streamed straight in
+		{CAMERA_FORMAT_UNCOMPRESSED, 3, 256},	// VGA band, windowed rows
+		{CAMERA_FORMAT_LUMA, 0, 40},			// QQVGA luma, small samples
+	};
+	uint8_t stored[256];
+	uint8_t head, tail;
+	uint16_t line_reads, reads_per_line;
+	uint8_t *pending;
+	uint8_t pending_id;
+	uint8_t id;
+	uint16_t module_line;
+	uint32_t step, frames, samples;
+	uint8_t c;
+
+	for (c = 0; c < sizeof(cases) / sizeof(cases[0]); c++)
+	{
+		TEST_CHECK(test_start(cases[c].format, cases[c].frame, cases[c].sample, 4096) == 0);
+		TEST_CHECK(read_sample_length == cases[c].sample);
+		reads_per_line = camera_line_length / read_sample_length;
+
+		head = tail = 0;
+		line_reads = 0;
+		pending = NULL;
+		pending_id = 0;
+		id = 0;
+		module_line = 0;
+		frames = 0;
+		samples = 0;
+
+		for (step = 0; step < 400000; step++)
+		{
+			// Alternate between the reader keeping up and falling behind.
+			uint16_t producer = ((step >> 13) & 1)?24000:8000;
+
+			if (test_random() < producer)
+			{
+				if (module_line == 0)
+				{
+					camera_vsync_isr(frames++);
+				}
+				if (test_feed_line(id))
+				{
+					stored[head++] = id;
+				}
+				id++;
+				if (++module_line == TEST_MODULE_LINES)
+				{
+					module_line = 0;
+				}
+				// The ISR must not write over the sample being sent.
+				if (pending)
+				{
+					TEST_CHECK(test_sample_is(pending, read_sample_length, pending_id));
+				}
+			}
+			else
+			{
+				pending = camera_read();
+				if (pending)
+				{
+					TEST_CHECK(head != tail);
+					TEST_CHECK(pending >= camera_buffer_ptr);
+					TEST_CHECK(pending + read_sample_length <= camera_buffer_ptr + camera_buffer_size);
+					TEST_CHECK(test_sample_is(pending, read_sample_length, stored[tail]));
+					pending_id = stored[tail];
+					samples++;
+					if (++line_reads == reads_per_line)
+					{
+						line_reads = 0;
+						tail++;
+					}
+				}
+			}
+			TEST_CHECK(camera_wr_total - camera_rd_total <= camera_buffer_size);
+			if (test_failures)
+			{
+				return;
+			}
+		}
+
+		// Make sure the run covered the interesting cases.
+		TEST_CHECK(samples > 0);
+		TEST_CHECK(camera_wrap_count > 0);
+		TEST_CHECK(camera_stats.lines_dropped > 0);
+	}
+}
+
+/** @brief Ring sizing for every uncompressed mode and sample size.
+ *  @details The buffer must be a whole number of lines and read samples
+ *  and use as much of the RAM as it can. A read sample which does not
+ *  divide the line falls back to a whole line.
+ */
+static void test_ring_size(void)
+{
+	static const uint16_t max_samples[] = {0, 64, 188, 512, 900, 1000, 1020, 1023, 1024, 3072};
+	static const uint32_t lengths[] = {1280, 3000, 4096, 32768, 0xfffc, 0x14000};
+	int8_t format;
+	int8_t frame;
+	uint8_t m, l;
+	uint16_t sample;
+
+	for (format = CAMERA_FORMAT_UNCOMPRESSED; format <= CAMERA_FORMAT_LUMA; format++)
+	{
+		for (frame = 0; frame < camera_mode_get_frame_count(format); frame++)
+		{
+			for (m = 0; m < sizeof(max_samples) / sizeof(max_samples[0]); m++)
+			{
+				for (l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++)
+				{
+					sample = camera_mode_get_sample_size(format, frame, max_samples[m]);
+					TEST_CHECK(test_start(format, frame, sample, lengths[l]) == 0);
+					TEST_CHECK(read_sample_length == sample);
+					TEST_CHECK((camera_buffer_size % camera_line_length) == 0);
+					TEST_CHECK((camera_buffer_size % read_sample_length) == 0);
+					TEST_CHECK(camera_buffer_size <= camera_buffer_length);
+					TEST_CHECK(camera_buffer_length - camera_buffer_size < camera_line_length);
+				}
+			}
+		}
+	}
+
+	// 600 bytes does not divide a 640 byte QVGA line.
+	TEST_CHECK(test_start(CAMERA_FORMAT_UNCOMPRESSED, 1, 600, 4096) == 0);
+	TEST_CHECK(read_sample_length == camera_line_length);
+	TEST_CHECK(camera_buffer_size == 3840);
+}
+
+/** @brief Stream start waits for VSYNC without blocking.
+ *  @details camera_start returns straight away in the sync state. Lines
+ *  arriving before the first VSYNC edge are flushed and camera_read
+ *  returns nothing. The first edge starts the stream and the data which
+ *  follows carries that edge's timestamp. camera_restart goes back to
+ *  waiting for an edge.
+ */
+static void test_vsync_start(void)
+{
+	uint32_t flushes;
+	uint16_t i;
+
+	TEST_CHECK(test_start(CAMERA_FORMAT_UNCOMPRESSED, 2, 1280, 32768) == 0);
+	TEST_CHECK(camera_get_state() == CAMERA_STREAMING_SYNC);
+
+	flushes = stub_cam_flushes;
+	for (i = 0; i < 10; i++)
+	{
+		TEST_CHECK(test_feed_line(1) == 0);
+		TEST_CHECK(camera_read() == NULL);
+	}
+	TEST_CHECK(stub_cam_flushes == flushes + 10);
+	TEST_CHECK(camera_stats.fifo_flushes == 10);
+	TEST_CHECK(camera_wr_total == 0);
+
+	// The edge flushes any part line from before it.
+	stub_cam_fifo = 100;
+	camera_vsync_isr(1234);
+	TEST_CHECK(camera_get_state() == CAMERA_STREAMING_STARTED);
+	TEST_CHECK(stub_cam_fifo == 0);
+
+	TEST_CHECK(test_feed_line(2) != 0);
+	TEST_CHECK(test_sample_is(camera_read(), read_sample_length, 2));
+	TEST_CHECK(camera_get_timestamp() == 1234);
+	TEST_CHECK(camera_read() == NULL);
+
+	// A second edge part way through a frame does not restart it.
+	camera_vsync_isr(5678);
+	TEST_CHECK(camera_get_state() == CAMERA_STREAMING_STARTED);
+
+	camera_restart();
+	TEST_CHECK(camera_get_state() == CAMERA_STREAMING_SYNC);
+	TEST_CHECK(stub_critical_depth == 0);
+	TEST_CHECK(camera_read() == NULL);
+	TEST_CHECK(test_feed_line(3) == 0);
+	camera_vsync_isr(9999);
+	TEST_CHECK(test_feed_line(4) != 0);
+	TEST_CHECK(test_sample_is(camera_read(), read_sample_length, 4));
+	TEST_CHECK(camera_get_timestamp() == 9999);
+}
+
+/** @brief Read samples keep the image data longword aligned.
+ *  @details For uncompressed formats every sample is a multiple of 4
+ *  bytes which divides the line and is the largest such size that fits.
+ *  MJPEG always reads whole lines.
+ */
+static void test_sample_size(void)
+{
+	const CAMERA_mode *mode;
+	int8_t format;
+	int8_t frame;
+	uint16_t max_sample;
+	uint16_t limit;
+	uint16_t sample;
+	uint16_t larger;
+
+	for (format = CAMERA_FORMAT_UNCOMPRESSED; format <= CAMERA_FORMAT_COUNT; format++)
+	{
+		for (frame = 0; frame < camera_mode_get_frame_count(format); frame++)
+		{
+			mode = cam_mode_lookup(format, frame);
+			for (max_sample = 0; max_sample <= 2048; max_sample++)
+			{
+				sample = camera_mode_get_sample_size(format, frame, max_sample);
+				limit = max_sample & ~3;
+
+				TEST_CHECK((sample & 3) == 0);
+				TEST_CHECK((mode->line % sample) == 0);
+				if ((format == CAMERA_FORMAT_MJPEG) || (limit == 0))
+				{
+					TEST_CHECK(sample == mode->line);
+					continue;
+				}
+				TEST_CHECK((sample <= limit) || (sample == 4));
+				for (larger = sample + 4; (larger <= limit) && (larger <= mode->line); larger += 4)
+				{
+					TEST_CHECK((mode->line % larger) != 0);
+				}
+			}
+		}
+	}
+
+	// There is no mode for an unknown format or frame.
+	TEST_CHECK(camera_mode_get_sample_size(CAMERA_FORMAT_ANY, 0, 512) == 0);
+	TEST_CHECK(camera_mode_get_sample_size(CAMERA_FORMAT_UNCOMPRESSED,
+			camera_mode_get_frame_count(CAMERA_FORMAT_UNCOMPRESSED), 512) == 0);
+}
+
+/** @brief A burst of reads drains the camera buffer.
+ *  @details The bulk transmit loop calls camera_read back to back until it
+ *  returns NULL. Every stored sample must come out in order in one burst.
+ *  A burst stops at the end of an aborted frame and the next one carries
+ *  on with the following frame.
+ */
+static void test_read_burst(void)
+{
+	uint8_t *sample;
+	uint16_t lines;
+	uint16_t count;
+	uint8_t id;
+
+	TEST_CHECK(test_start(CAMERA_FORMAT_UNCOMPRESSED, 2, 640, 32768) == 0);
+	camera_vsync_isr(0);
+	TEST_CHECK(camera_buffer_size == 25 * 1280);
+
+	for (id = 0; id < 20; id++)
+	{
+		TEST_CHECK(test_feed_line(id) != 0);
+	}
+	for (count = 0; (sample = camera_read()) != NULL; count++)
+	{
+		TEST_CHECK(test_sample_is(sample, read_sample_length, count / 2));
+	}
+	TEST_CHECK(count == 40);
+	TEST_CHECK(camera_wr_total == camera_rd_total);
+	TEST_CHECK(camera_frame_aborted() == 0);
+
+	// Fill the buffer until a line is lost. The rest of the frame is
+	// dropped and the next frame starts after the next VSYNC edge.
+	for (lines = 0; test_feed_line(id); lines++, id++)
+		;
+	TEST_CHECK(lines == 25);
+	TEST_CHECK(camera_stats.frames_dropped == 1);
+	TEST_CHECK(test_feed_line(100) == 0);
+	camera_vsync_isr(1);
+	TEST_CHECK(test_feed_line(200) == 0);
+
+	for (count = 0; (sample = camera_read()) != NULL; count++)
+	{
+		TEST_CHECK(test_sample_is(sample, read_sample_length, 20 + count / 2));
+	}
+	TEST_CHECK(count == 50);
+	TEST_CHECK(camera_frame_aborted() == 1);
+	TEST_CHECK(camera_frame_aborted() == 0);
+
+	// The frame which started while the buffer was full was dropped too.
+	// Space has been released so the next frame is stored.
+	TEST_CHECK(camera_stats.frames_dropped == 2);
+	camera_vsync_isr(2);
+	TEST_CHECK(test_feed_line(201) != 0);
+	for (count = 0; (sample = camera_read()) != NULL; count++)
+	{
+		TEST_CHECK(test_sample_is(sample, read_sample_length, 201));
+	}
+	TEST_CHECK(count == 2);
+	TEST_CHECK(camera_get_timestamp() == 2);
+}
+
+#ifdef CAMERA_PASSTHROUGH
+/// Bytes the test passthrough function takes from each line.
+static uint16_t test_pass_length;
+
+static uint16_t test_pass(volatile uint32_t *port, uint16_t length)
+{
+	(void)port;
+	return (test_pass_length < length) ? test_pass_length : length;
+}
+
+/** @brief Lines written to the endpoint are not stored.
+ *  @details The reader starts passthrough with the camera buffer empty.
+ *  Lines the endpoint takes whole do not use the buffer, so more lines than
+ *  the buffer holds can pass. Part of a line is stored and camera_read
+ *  returns the rest. The endpoint is tried before the buffer is checked
+ *  for space. If part of a line has no space the line is dropped and
+ *  camera_read has nothing to skip.
+ */
+static void test_passthrough(void)
+{
+	uint32_t dropped;
+	uint8_t i;
+
+	TEST_CHECK(test_start(CAMERA_FORMAT_UNCOMPRESSED, 2, 1280, 4 * 1280) == 0);
+	camera_vsync_isr(1);
+	dropped = camera_stats.lines_dropped;
+
+	test_pass_length = camera_line_length;
+	camera_passthrough_start(test_pass);
+	for (i = 0; i < 6; i++)
+	{
+		TEST_CHECK(test_feed_line(i + 1) == 0);
+	}
+	TEST_CHECK(camera_stats.lines_dropped == dropped);
+	TEST_CHECK(camera_passthrough_active());
+	TEST_CHECK(camera_passthrough_stop() == 6 * camera_line_length);
+	TEST_CHECK(camera_read() == NULL);
+
+	test_pass_length = 512;
+	camera_passthrough_start(test_pass);
+	TEST_CHECK(test_feed_line(7) != 0);
+	TEST_CHECK(!camera_passthrough_active());
+	TEST_CHECK(test_sample_is(camera_read(), camera_line_length - 512, 7));
+	TEST_CHECK(camera_get_read_length() == camera_line_length - 512);
+
+	// Fill the buffer behind the sample still held by the reader.
+	for (i = 0; i < 3; i++)
+	{
+		TEST_CHECK(test_feed_line(8 + i) != 0);
+	}
+	camera_passthrough_start(test_pass);
+	TEST_CHECK(test_feed_line(11) == 0);
+	TEST_CHECK(camera_stats.lines_dropped == dropped + 1);
+	TEST_CHECK(!camera_passthrough_active());
+	for (i = 0; i < 3; i++)
+	{
+		TEST_CHECK(test_sample_is(camera_read(), camera_line_length, 8 + i));
+		TEST_CHECK(camera_get_read_length() == camera_line_length);
+	}
+}
+#endif // CAMERA_PASSTHROUGH
+
+int main(void)
+{
+	TEST_RUN(test_ring_interleave);
+	TEST_RUN(test_ring_size);
+	TEST_RUN(test_vsync_start);
+	TEST_RUN(test_sample_size);
+	TEST_RUN(test_read_burst);
+#ifdef CAMERA_PASSTHROUGH
+	TEST_RUN(test_passthrough);
+#endif // CAMERA_PASSTHROUGH
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,238 @@
+/**
+  @file test_mjpeg.c
+  @brief Host tests for the MJPEG encoder in mjpeg.c.
+  @details Synthetic YUYV frames are encoded a line at a time as the
+  camera code does. The bands are joined into one JPEG image which is
+  decoded with the IJG libjpeg library. The decoded image must have the
+  right size and its luma must be close to the input. The size of each
+  frame and the luma PSNR are printed.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <jpeglib.h>
+
+#include "../Sources/mjpeg.c"
+
+#include "test.h"
+
+/// Largest test frame, QVGA in YUYV.
+#define TEST_WIDTH 320
+#define TEST_HEIGHT 240
+
+/// Input frame in YUYV.
+static uint8_t test_yuyv[TEST_HEIGHT][TEST_WIDTH * 2] __attribute__((aligned(4)));
+/// Encoded frame made from the output of each band.
+static uint8_t test_jpeg[TEST_WIDTH * TEST_HEIGHT * 2];
+/// Decoded frame in YCbCr.
+static uint8_t test_decoded[TEST_HEIGHT][TEST_WIDTH * 3];
+
+/** @brief Fill the frame with smooth ramps in luma and chroma.
+ */
+static void test_fill_smooth(uint16_t width, uint16_t height)
+{
+	uint16_t x, y;
+
+	for (y = 0; y < height; y++)
+	{
+		for (x = 0; x < width; x += 2)
+		{
+			test_yuyv[y][(x * 2) + 0] = (uint8_t)(16 + ((x * 200) / width));
+			test_yuyv[y][(x * 2) + 1] = (uint8_t)(64 + ((y * 128) / height));
+			test_yuyv[y][(x * 2) + 2] = (uint8_t)(16 + (((x + 1) * 200) / width));
+			test_yuyv[y][(x * 2) + 3] = (uint8_t)(192 - ((x * 128) / width));
+		}
+	}
+}
+
+/** @brief Fill the frame with edges, stripes and noise in luma.
+ */
+static void test_fill_textured(uint16_t width, uint16_t height)
+{
+	uint32_t seed = 12345;
+	uint16_t x, y;
+	uint8_t i;
+	int v;
+
+	for (y = 0; y < height; y++)
+	{
+		for (x = 0; x < width; x += 2)
+		{
+			for (i = 0; i < 2; i++)
+			{
+				seed = (seed * 1103515245) + 12345;
+				v = (((x + i) / 20 + y / 20) & 1) ? 180 : 60;
+				v += ((x + i) % 7 < 2) ? 30 : 0;
+				v += (int)((seed >> 16) % 17) - 8;
+				test_yuyv[y][((x + i) * 2)] = (uint8_t)v;
+			}
+			test_yuyv[y][(x * 2) + 1] = (uint8_t)(((x / 40) & 1) ? 100 : 150);
+			test_yuyv[y][(x * 2) + 3] = (uint8_t)(((y / 30) & 1) ? 110 : 140);
+		}
+	}
+}
+
+/** @brief Encode the frame a line at a time.
+ *  @returns Length of the JPEG image or zero if the encoder failed.
+ */
+static uint32_t test_encode(uint16_t width, uint16_t height)
+{
+	uint32_t length = 0;
+	uint16_t bands = 0;
+	uint16_t out;
+	uint16_t y;
+
+	if (mjpeg_start(width, height, MJPEG_QUALITY) != 0)
+	{
+		return 0;
+	}
+
+	for (y = 0; y < height; y++)
+	{
+		out = mjpeg_encode_line(test_yuyv[y]);
+		if (out)
+		{
+			bands++;
+			TEST_CHECK(out <= MJPEG_OUTPUT_LENGTH);
+			memcpy(&test_jpeg[length], mjpeg_get_output(), out);
+			length += out;
+			TEST_CHECK(mjpeg_frame_end() == (y == height - 1));
+		}
+	}
+
+	TEST_CHECK(bands == height / MJPEG_BAND_LINES);
+	TEST_CHECK(mjpeg_frame_error() == 0);
+
+	return length;
+}
+
+/** @brief Decode the JPEG image with libjpeg.
+ *  @returns Zero on success or -1 if the image is damaged or has the wrong size.
+ */
+static int test_decode(uint32_t length, uint16_t width, uint16_t height)
+{
+	struct jpeg_decompress_struct cinfo;
+	struct jpeg_error_mgr jerr;
+	JSAMPROW row;
+	int ret = 0;
+
+	cinfo.err = jpeg_std_error(&jerr);
+	jpeg_create_decompress(&cinfo);
+	jpeg_mem_src(&cinfo, test_jpeg, length);
+	jpeg_read_header(&cinfo, TRUE);
+	// Keep the YCbCr samples so that luma can be compared with the input.
+	cinfo.out_color_space = JCS_YCbCr;
+	jpeg_start_decompress(&cinfo);
+
+	if ((cinfo.output_width != width) || (cinfo.output_height != height) ||
+			(cinfo.output_components != 3))
+	{
+		ret = -1;
+	}
+	else
+	{
+		while (cinfo.output_scanline < cinfo.output_height)
+		{
+			row = test_decoded[cinfo.output_scanline];
+			jpeg_read_scanlines(&cinfo, &row, 1);
+		}
+	}
+
+	jpeg_finish_decompress(&cinfo);
+	jpeg_destroy_decompress(&cinfo);
+
+	// libjpeg counts data it could not make sense of as a warning.
+	if (jerr.num_warnings)
+	{
+		ret = -1;
+	}
+	return ret;
+}
+
+/** @brief Peak signal to noise ratio of the decoded luma in dB.
+ */
+static double test_psnr(uint16_t width, uint16_t height)
+{
+	double sum = 0;
+	int d;
+	uint16_t x, y;
+
+	for (y = 0; y < height; y++)
+	{
+		for (x = 0; x < width; x++)
+		{
+			d = (int)test_yuyv[y][x * 2] - (int)test_decoded[y][x * 3];
+			sum += d * d;
+		}
+	}
+	if (sum == 0)
+	{
+		return 99.0;
+	}
+	return 10.0 * log10((255.0 * 255.0) / (sum / ((double)width * height)));
+}
+
+/** @brief Encode, decode and compare one frame.
+ *  @param[in] max_length Largest expected frame in bytes.
+ *  @param[in] min_psnr Lowest acceptable luma PSNR in dB.
+ */
+static void test_frame(const char *name, uint16_t width, uint16_t height,
+		uint32_t max_length, double min_psnr)
+{
+	uint32_t length;
+	double psnr = 0;
+
+	length = test_encode(width, height);
+	TEST_CHECK(length > 0);
+	TEST_CHECK(length <= max_length);
+	// Start and end of image markers.
+	TEST_CHECK((test_jpeg[0] == 0xff) && (test_jpeg[1] == 0xd8));
+	TEST_CHECK((test_jpeg[length - 2] == 0xff) && (test_jpeg[length - 1] == 0xd9));
+
+	if (length)
+	{
+		TEST_CHECK(test_decode(length, width, height) == 0);
+		psnr = test_psnr(width, height);
+		TEST_CHECK(psnr >= min_psnr);
+	}
+
+	printf("%-16s %3ux%-3u q%u %6u bytes/frame, luma PSNR %4.1f dB\n",
+			name, width, height, MJPEG_QUALITY, length, psnr);
+}
+
+static void test_qvga(void)
+{
+	test_fill_smooth(320, 240);
+	test_frame("QVGA smooth", 320, 240, 8000, 45.0);
+	test_fill_textured(320, 240);
+	test_frame("QVGA textured", 320, 240, 20000, 30.0);
+}
+
+static void test_qqvga(void)
+{
+	test_fill_smooth(160, 120);
+	test_frame("QQVGA smooth", 160, 120, 3000, 45.0);
+	test_fill_textured(160, 120);
+	test_frame("QQVGA textured", 160, 120, 6000, 30.0);
+}
+
+/** @brief Frame sizes the encoder cannot handle are rejected.
+ */
+static void test_sizes(void)
+{
+	TEST_CHECK(mjpeg_start(640, 480, MJPEG_QUALITY) == -1);
+	TEST_CHECK(mjpeg_start(328, 240, MJPEG_QUALITY) == -1);
+	TEST_CHECK(mjpeg_start(320, 244, MJPEG_QUALITY) == -1);
+	TEST_CHECK(mjpeg_start(320, 240, MJPEG_QUALITY) == 0);
+}
+
+int main(void)
+{
+	TEST_RUN(test_qvga);
+	TEST_RUN(test_qqvga);
+	TEST_RUN(test_sizes);
+
+	return TEST_RESULT();
+}
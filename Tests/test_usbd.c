@@ -0,0 +1,230 @@
+/**
+  @file test_usbd.c
+  @brief Host tests for the IN transfers in usbd.c.
+  @details The endpoint status and FIFO registers are simulated here. The
+  host takes each packet as soon as INPRDY is set. Every FIFO write and
+  every packet handoff records how deeply interrupts were masked at the
+  time so that the tests can check which parts of a transfer can be
+  interrupted by the camera.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../Sources/usbd.c"
+
+#include "test.h"
+
+/// Bytes written to each endpoint FIFO since the last test_reset.
+static uint8_t test_fifo[USBD_MAX_ENDPOINT_COUNT][4096];
+static uint16_t test_fifo_pos[USBD_MAX_ENDPOINT_COUNT];
+/// Deepest interrupt masking seen for a FIFO write.
+static int test_fifo_depth_max[USBD_MAX_ENDPOINT_COUNT];
+/// Shallowest interrupt masking seen for a FIFO write.
+static int test_fifo_depth_min[USBD_MAX_ENDPOINT_COUNT];
+
+/// Status register as last written by the code under test.
+static uint8_t test_sr[USBD_MAX_ENDPOINT_COUNT];
+/// Interrupt masking at the last status register access.
+static int test_sr_depth[USBD_MAX_ENDPOINT_COUNT];
+/// Packets handed to the host and the length of each.
+static uint16_t test_packets[USBD_MAX_ENDPOINT_COUNT];
+static uint16_t test_packet_length[USBD_MAX_ENDPOINT_COUNT][16];
+static uint16_t test_packet_start[USBD_MAX_ENDPOINT_COUNT];
+/// Packets handed over without interrupts masked.
+static uint16_t test_packets_unmasked[USBD_MAX_ENDPOINT_COUNT];
+
+/** @brief Act on the last write to a status register.
+ *  @details Bits are only ever set by a write. A set INPRDY bit hands the
+ *  packet in the FIFO to the host which takes it straight away.
+ */
+static void test_sr_sync(uint8_t ep_number)
+{
+	uint8_t inprdy = (ep_number == USBD_EP_0)?MASK_USBD_EP0SR_INPRDY:MASK_USBD_EPxSR_INPRDY;
+
+	if (test_sr[ep_number] & inprdy)
+	{
+		if (test_packets[ep_number] < 16)
+		{
+			test_packet_length[ep_number][test_packets[ep_number]] =
+					test_fifo_pos[ep_number] - test_packet_start[ep_number];
+		}
+		test_packets[ep_number]++;
+		test_packet_start[ep_number] = test_fifo_pos[ep_number];
+		if (test_sr_depth[ep_number] == 0)
+		{
+			test_packets_unmasked[ep_number]++;
+		}
+	}
+	test_sr[ep_number] = 0;
+}
+
+volatile uint8_t *stub_usbd_ep_sr(uint8_t ep_number)
+{
+	test_sr_sync(ep_number);
+	test_sr_depth[ep_number] = stub_critical_depth;
+	return &test_sr[ep_number];
+}
+
+volatile uint8_t *stub_usbd_ep_fifo(uint8_t ep_number)
+{
+	if (stub_critical_depth > test_fifo_depth_max[ep_number])
+	{
+		test_fifo_depth_max[ep_number] = stub_critical_depth;
+	}
+	if (stub_critical_depth < test_fifo_depth_min[ep_number])
+	{
+		test_fifo_depth_min[ep_number] = stub_critical_depth;
+	}
+	return &test_fifo[ep_number][test_fifo_pos[ep_number]++ & 4095];
+}
+
+/** @brief Clear the simulated registers and the records.
+ */
+static void test_reset(void)
+{
+	memset(test_fifo, 0, sizeof(test_fifo));
+	memset(test_fifo_pos, 0, sizeof(test_fifo_pos));
+	memset(test_fifo_depth_max, 0, sizeof(test_fifo_depth_max));
+	memset(test_fifo_depth_min, 0x7f, sizeof(test_fifo_depth_min));
+	memset(test_sr, 0, sizeof(test_sr));
+	memset(test_sr_depth, 0, sizeof(test_sr_depth));
+	memset(test_packets, 0, sizeof(test_packets));
+	memset(test_packet_length, 0, sizeof(test_packet_length));
+	memset(test_packet_start, 0, sizeof(test_packet_start));
+	memset(test_packets_unmasked, 0, sizeof(test_packets_unmasked));
+
+	USBD_create_endpoint(USBD_EP_0, USBD_EP_CTRL, USBD_DIR_OUT, USBD_EP_SIZE_64, USBD_DB_OFF, NULL);
+	USBD_create_endpoint(USBD_EP_2, USBD_EP_BULK, USBD_DIR_IN, USBD_EP_SIZE_512, USBD_DB_ON, NULL);
+}
+
+/** @brief Finish a transfer by acting on the last status register write.
+ */
+static void test_finish(uint8_t ep_number)
+{
+	test_sr_sync(ep_number);
+	TEST_CHECK(stub_critical_depth == 0);
+}
+
+/// Data to send. Each byte is different from its neighbours.
+static uint8_t test_data[2048] __attribute__((aligned(4)));
+
+static void test_data_fill(void)
+{
+	uint16_t i;
+
+	for (i = 0; i < sizeof(test_data); i++)
+	{
+		test_data[i] = (uint8_t)(i * 7 + 3);
+	}
+}
+
+/** @brief A data endpoint transfer runs with interrupts enabled.
+ *  @details Only the INPRDY handoff of each packet masks interrupts. The
+ *  data arrives in packets of the endpoint size in the right order.
+ */
+static void test_transfer_data_endpoint(void)
+{
+	test_data_fill();
+	test_reset();
+
+	TEST_CHECK(USBD_transfer_ex(USBD_EP_2, test_data, 1300, USBD_TRANSFER_EX_PART_NORMAL, 0) == 1300);
+	test_finish(USBD_EP_2);
+
+	TEST_CHECK(test_fifo_pos[USBD_EP_2] == 1300);
+	TEST_CHECK(memcmp(test_fifo[USBD_EP_2], test_data, 1300) == 0);
+	TEST_CHECK(test_fifo_depth_max[USBD_EP_2] == 0);
+	TEST_CHECK(test_packets[USBD_EP_2] == 3);
+	TEST_CHECK(test_packet_length[USBD_EP_2][0] == 512);
+	TEST_CHECK(test_packet_length[USBD_EP_2][1] == 512);
+	TEST_CHECK(test_packet_length[USBD_EP_2][2] == 276);
+	TEST_CHECK(test_packets_unmasked[USBD_EP_2] == 0);
+
+	// A payload header written without sending, then the data after it.
+	test_reset();
+	TEST_CHECK(USBD_transfer_ex(USBD_EP_2, test_data, 12, USBD_TRANSFER_EX_PART_NO_SEND, 0) == 12);
+	TEST_CHECK(test_packets[USBD_EP_2] == 0);
+	TEST_CHECK(USBD_transfer_ex(USBD_EP_2, &test_data[12], 1012, USBD_TRANSFER_EX_PART_NORMAL, 12) == 1012);
+	test_finish(USBD_EP_2);
+
+	TEST_CHECK(memcmp(test_fifo[USBD_EP_2], test_data, 1024) == 0);
+	TEST_CHECK(test_fifo_depth_max[USBD_EP_2] == 0);
+	TEST_CHECK(test_packets[USBD_EP_2] == 3);
+	TEST_CHECK(test_packet_length[USBD_EP_2][0] == 512);
+	TEST_CHECK(test_packet_length[USBD_EP_2][1] == 512);
+	TEST_CHECK(test_packet_length[USBD_EP_2][2] == 0);
+	TEST_CHECK(test_packets_unmasked[USBD_EP_2] == 0);
+}
+
+/** @brief Streamed fragments run with interrupts enabled.
+ */
+static void test_stream_in(void)
+{
+	USBD_stream_fragment fragments[3];
+	size_t offset = 0;
+
+	test_data_fill();
+	test_reset();
+
+	fragments[0].data = test_data;
+	fragments[0].length = 12;
+	fragments[1].data = &test_data[12];
+	fragments[1].length = 640;
+	fragments[2].data = &test_data[652];
+	fragments[2].length = 640;
+
+	TEST_CHECK(USBD_stream_in(USBD_EP_2, fragments, 3, &offset, USBD_STREAM_IN_END) == 1292);
+	test_finish(USBD_EP_2);
+
+	TEST_CHECK(offset == 0);
+	TEST_CHECK(memcmp(test_fifo[USBD_EP_2], test_data, 1292) == 0);
+	TEST_CHECK(test_fifo_depth_max[USBD_EP_2] == 0);
+	TEST_CHECK(test_packets[USBD_EP_2] == 3);
+	TEST_CHECK(test_packet_length[USBD_EP_2][2] == 1292 - 1024);
+	TEST_CHECK(test_packets_unmasked[USBD_EP_2] == 0);
+
+	// Part of a packet is left in the FIFO to be continued later.
+	test_reset();
+	offset = 0;
+	TEST_CHECK(USBD_stream_in(USBD_EP_2, fragments, 2, &offset, USBD_STREAM_IN_PART) == 652);
+	test_finish(USBD_EP_2);
+	TEST_CHECK(offset == 140);
+	TEST_CHECK(test_packets[USBD_EP_2] == 1);
+
+	// Endpoints which do not exist or are not set up are rejected.
+	test_reset();
+	offset = 0;
+	TEST_CHECK(USBD_stream_in(USBD_MAX_ENDPOINT_COUNT, fragments, 3, &offset, USBD_STREAM_IN_END) ==
+			USBD_ERR_INVALID_PARAMETER);
+	TEST_CHECK(USBD_stream_in(USBD_EP_3, fragments, 3, &offset, USBD_STREAM_IN_END) ==
+			USBD_ERR_NOT_CONFIGURED);
+	TEST_CHECK(test_fifo_pos[USBD_EP_2] == 0);
+}
+
+/** @brief Control endpoint data is written with interrupts masked.
+ *  @details EP0 is also handled from the USB interrupt.
+ */
+static void test_transfer_control_endpoint(void)
+{
+	test_data_fill();
+	test_reset();
+
+	TEST_CHECK(USBD_transfer_ep0(USBD_DIR_IN, test_data, 100, 100) == 100);
+	test_finish(USBD_EP_0);
+
+	TEST_CHECK(memcmp(test_fifo[USBD_EP_0], test_data, 100) == 0);
+	TEST_CHECK(test_fifo_depth_min[USBD_EP_0] == 1);
+	TEST_CHECK(test_packets[USBD_EP_0] == 2);
+	TEST_CHECK(test_packet_length[USBD_EP_0][0] == 64);
+	TEST_CHECK(test_packet_length[USBD_EP_0][1] == 36);
+}
+
+int main(void)
+{
+	TEST_RUN(test_transfer_data_endpoint);
+	TEST_RUN(test_stream_in);
+	TEST_RUN(test_transfer_control_endpoint);
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,593 @@
+/**
+  @file test_uvc.c
+  @brief Host tests for the UVC device in usbd_uvc_v1_1.c.
+  @details Built once for a bulk data endpoint and once for an isochronous
+  data endpoint. The camera code is linked in and the camera module is
+  simulated by stubs.c.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../Sources/usbd_uvc_v1_1.c"
+
+#include "test.h"
+
+/// Speed returned by USBD_get_bus_speed.
+extern uint8_t stub_usb_speed;
+/// Double buffering requested for each endpoint by USBD_create_endpoint.
+extern uint8_t stub_ep_db[];
+
+/**
+ @name Reference configuration descriptor
+ @brief Configuration descriptor built one descriptor at a time.
+ @details This follows the run time builder which the compile time
+ descriptors replaced. It walks the camera mode table through the
+ camera_mode_* functions instead of the CAMERA_MODES_* lists so that the
+ two are made independently. The DFU interface is not built as
+ USB_INTERFACE_USE_DFU is not defined.
+ */
+//@{
+static uint8_t test_ref[2048];
+static uint16_t test_ref_len;
+
+/** @brief Append a descriptor to the reference configuration.
+ *  @returns Where the descriptor was put so that lengths can be filled in.
+ */
+static void *test_ref_add(const void *desc, uint16_t length)
+{
+	void *dst = &test_ref[test_ref_len];
+
+	memcpy(dst, desc, length);
+	test_ref_len += length;
+	return dst;
+}
+
+static void test_ref_add_format(uint8_t format, uint8_t format_index, uint8_t count)
+{
+	static const uint8_t guid_luma[16] = PAYLOAD_FORMAT_LUMA;
+	uint8_t bbp = class_vs_format_bbp(format);
+	uint16_t width, height;
+	uint32_t interval, min_interval, max_interval;
+	uint8_t rates;
+	uint8_t frame;
+	uint8_t i;
+
+	if (format == CAMERA_FORMAT_MJPEG)
+	{
+		USB_UVC_VS_MJPEGVideoFormatDescriptor c = {
+				sizeof(USB_UVC_VS_MJPEGVideoFormatDescriptor),
+				USB_UVC_DESCRIPTOR_TYPE_CS_INTERFACE,
+				USB_UVC_DESCRIPTOR_SUBTYPE_VS_FORMAT_MJPEG,
+				format_index, count, 0x00, 1,
+				FRAME_RATIO_X, FRAME_RATIO_Y, 0x00, 0x00,
+		};
+		test_ref_add(&c, c.bLength);
+	}
+	else
+	{
+		USB_UVC_VS_UncompressedVideoFormatDescriptor c = {
+				sizeof(USB_UVC_VS_UncompressedVideoFormatDescriptor),
+				USB_UVC_DESCRIPTOR_TYPE_CS_INTERFACE,
+				USB_UVC_DESCRIPTOR_SUBTYPE_VS_FORMAT_UNCOMPRESSED,
+				format_index, count,
+				PAYLOAD_FORMAT_UNCOMPRESSED, PAYLOAD_BBP_UNCOMPRESSED, 1,
+				FRAME_RATIO_X, FRAME_RATIO_Y, 0x00, 0x00,
+		};
+		if (format == CAMERA_FORMAT_LUMA)
+		{
+			memcpy(c.guidFormat, guid_luma, sizeof(c.guidFormat));
+			c.bBitsPerPixel = PAYLOAD_BBP_LUMA;
+		}
+		test_ref_add(&c, c.bLength);
+	}
+
+	for (frame = 0; frame < count; frame++)
+	{
+		USB_UVC_VS_UncompressedVideoFrameDescriptorDiscrete(16) c;
+
+		memset(&c, 0, sizeof(c));
+		c.bFrameIndex = camera_mode_get_frame(format, frame, &width, &height);
+		rates = camera_mode_get_frame_rate_count(format, frame);
+		interval = camera_mode_get_frame_interval(format, frame, 0);
+		min_interval = max_interval = interval;
+		for (i = 0; i < rates; i++)
+		{
+			c.dwFrameInterval[i] = camera_mode_get_frame_interval(format, frame, i);
+			if (c.dwFrameInterval[i] < min_interval)
+			{
+				min_interval = c.dwFrameInterval[i];
+			}
+			if (c.dwFrameInterval[i] > max_interval)
+			{
+				max_interval = c.dwFrameInterval[i];
+			}
+		}
+		c.bLength = sizeof(USB_UVC_VS_UncompressedVideoFrameDescriptorDiscrete(0)) +
+				(rates * sizeof(uint32_t));
+		c.bDescriptorType = USB_UVC_DESCRIPTOR_TYPE_CS_INTERFACE;
+		c.bDescriptorSubType = (format == CAMERA_FORMAT_MJPEG) ?
+				USB_UVC_DESCRIPTOR_SUBTYPE_VS_FRAME_MJPEG :
+				USB_UVC_DESCRIPTOR_SUBTYPE_VS_FRAME_UNCOMPRESSED;
+		c.wWidth = width;
+		c.wHeight = height;
+		c.dwMinBitRate = (uint32_t)(((uint64_t)width * height * bbp * 8 * 10000000) / max_interval);
+		c.dwMaxBitRate = (uint32_t)(((uint64_t)width * height * bbp * 8 * 10000000) / min_interval);
+		c.dwMaxVideoFrameBufferSize = (uint32_t)width * height * bbp;
+		c.dwDefaultFrameInterval = interval;
+		c.bFrameIntervalType = rates;
+		test_ref_add(&c, c.bLength);
+	}
+
+	{
+		USB_UVC_ColorMatchingDescriptor c = {
+				sizeof(USB_UVC_ColorMatchingDescriptor),
+				USB_UVC_DESCRIPTOR_TYPE_CS_INTERFACE,
+				USB_UVC_DESCRIPTOR_SUBTYPE_VS_COLORFORMAT,
+				1, 1, 4,
+		};
+		test_ref_add(&c, c.bLength);
+	}
+}
+
+/** @brief Build the reference configuration descriptor for a bus speed.
+ */
+static void test_ref_build(uint8_t speed)
+{
+	static const uint8_t formats[] = {
+			CAMERA_FORMAT_UNCOMPRESSED, CAMERA_FORMAT_LUMA, CAMERA_FORMAT_MJPEG,
+	};
+	USB_configuration_descriptor *config;
+	USB_UVC_VC_CSInterfaceHeaderDescriptor(1) *vc_header;
+	USB_UVC_VS_CSInterfaceInputHeaderDescriptor(0) *vs_header;
+	uint16_t vc_start, vs_start;
+	uint8_t count[sizeof(formats)];
+	uint8_t format_count = 0;
+	uint8_t format_index = 1;
+	uint8_t i;
+
+	memset(test_ref, 0, sizeof(test_ref));
+	test_ref_len = 0;
+
+	for (i = 0; i < sizeof(formats); i++)
+	{
+		count[i] = (speed == USBD_SPEED_HIGH) ? camera_mode_get_frame_count(formats[i]) :
+				usb_uvc_get_frame_count_fs(formats[i]);
+		format_count += (count[i] > 0);
+	}
+
+	{
+		USB_configuration_descriptor c = {
+				sizeof(USB_configuration_descriptor),
+				USB_DESCRIPTOR_TYPE_CONFIGURATION,
+				0, 0x02, 0x01, 0x00,
+				USB_CONFIG_BMATTRIBUTES_VALUE, 0x00,
+		};
+		config = test_ref_add(&c, c.bLength);
+	}
+	{
+		USB_UVC_interface_association_descriptor c = {
+				sizeof(USB_UVC_interface_association_descriptor),
+				USB_DESCRIPTOR_TYPE_INTERFACE_ASSOCIATION,
+				0, 2, USB_CLASS_VIDEO, USB_SUBCLASS_VIDEO_INTERFACE_COLLECTION,
+				USB_PROTOCOL_VIDEO_UNDEFINED, 2,
+		};
+		test_ref_add(&c, c.bLength);
+	}
+	{
+		USB_UVC_VC_StandardInterfaceDescriptor c = {
+				sizeof(USB_UVC_VC_StandardInterfaceDescriptor),
+				USB_DESCRIPTOR_TYPE_INTERFACE,
+				0, 0x00, 0x01, USB_CLASS_VIDEO, USB_SUBCLASS_VIDEO_VIDEOCONTROL,
+				USB_PROTOCOL_VIDEO_UNDEFINED, 2,
+		};
+		test_ref_add(&c, c.bLength);
+	}
+
+	vc_start = test_ref_len;
+	{
+		USB_UVC_VC_CSInterfaceHeaderDescriptor(1) c = {
+				sizeof(USB_UVC_VC_CSInterfaceHeaderDescriptor(1)),
+				USB_UVC_DESCRIPTOR_TYPE_CS_INTERFACE,
+				USB_UVC_DESCRIPTOR_SUBTYPE_VC_HEADER,
+				(USB_VIDEO_CLASS_VERSION_MAJOR << 8) | (USB_VIDEO_CLASS_VERSION_MINOR << 4),
+				0, CLK_FREQ_SOURCE_CLOCK, 0x01, {0x01,},
+		};
+		vc_header = test_ref_add(&c, c.bLength);
+	}
+	{
+		USB_UVC_VC_CameraTerminalDescriptor(2) c = {
+				sizeof(USB_UVC_VC_CameraTerminalDescriptor(2)),
+				USB_UVC_DESCRIPTOR_TYPE_CS_INTERFACE,
+				USB_UVC_DESCRIPTOR_SUBTYPE_VC_INPUT_TERMINAL,
+				ENTITY_ID_CAMERA, USB_UVC_ITT_CAMERA, 0x00, 0x00,
+				0x0000, 0x0000, 0x0000, 0x02, {0x00, 0x00,},
+		};
+		test_ref_add(&c, c.bLength);
+	}
+	{
+		USB_UVC_VC_OutputTerminalDescriptor c = {
+				sizeof(USB_UVC_VC_OutputTerminalDescriptor),
+				USB_UVC_DESCRIPTOR_TYPE_CS_INTERFACE,
+				USB_UVC_DESCRIPTOR_SUBTYPE_VC_OUTPUT_TERMINAL,
+				ENTITY_ID_OUTPUT, USB_UVC_TT_STREAMING, 0x00, ENTITY_ID_PROCESSING, 0x00,
+		};
+		test_ref_add(&c, c.bLength);
+	}
+	{
+		USB_UVC_VC_ProcessingUnitDescriptor(2) c = {
+				sizeof(USB_UVC_VC_ProcessingUnitDescriptor(2)),
+				USB_UVC_DESCRIPTOR_TYPE_CS_INTERFACE,
+				USB_UVC_DESCRIPTOR_SUBTYPE_VC_PROCESSING_UNIT,
+				ENTITY_ID_PROCESSING, ENTITY_ID_CAMERA, 0x0000, 0x02, {0x00, 0x00,}, 0x00,
+		};
+		test_ref_add(&c, c.bLength);
+	}
+	vc_header->wTotalLength = test_ref_len - vc_start;
+
+	{
+		USB_UVC_VC_StandardInterruptEndpointDescriptor c = {
+				sizeof(USB_UVC_VC_StandardInterruptEndpointDescriptor),
+				USB_DESCRIPTOR_TYPE_ENDPOINT,
+				USB_ENDPOINT_DESCRIPTOR_EPADDR_IN | UVC_EP_INTERRUPT,
+				USB_ENDPOINT_DESCRIPTOR_ATTR_INTERRUPT, UVC_INTERRUPT_EP_SIZE, 0x08,
+		};
+		test_ref_add(&c, c.bLength);
+	}
+	{
+		USB_UVC_VC_CSEndpointDescriptor c = {
+				sizeof(USB_UVC_VC_CSEndpointDescriptor),
+				USB_UVC_DESCRIPTOR_TYPE_CS_ENDPOINT,
+				USB_UVC_DESCRIPTOR_SUBTYPE_EP_INTERRUPT, UVC_INTERRUPT_EP_SIZE,
+		};
+		test_ref_add(&c, c.bLength);
+	}
+	{
+		USB_UVC_VS_StandardInterfaceDescriptor c = {
+				sizeof(USB_UVC_VS_StandardInterfaceDescriptor),
+				USB_DESCRIPTOR_TYPE_INTERFACE,
+#ifdef USB_ENDPOINT_USE_ISOC
+				1, 0x00, 0x00,
+#else // !USB_ENDPOINT_USE_ISOC
+				1, 0x00, 0x01,
+#endif // USB_ENDPOINT_USE_ISOC
+				USB_CLASS_VIDEO, USB_SUBCLASS_VIDEO_VIDEOSTREAMING,
+				USB_PROTOCOL_VIDEO_UNDEFINED, 0x00,
+		};
+		test_ref_add(&c, c.bLength);
+	}
+
+	vs_start = test_ref_len;
+	{
+		USB_UVC_VS_CSInterfaceInputHeaderDescriptor(0) c = {
+				sizeof(USB_UVC_VS_CSInterfaceInputHeaderDescriptor(0)) + format_count,
+				USB_UVC_DESCRIPTOR_TYPE_CS_INTERFACE,
+				USB_UVC_DESCRIPTOR_SUBTYPE_VS_INPUT_HEADER,
+				format_count, 0, USB_ENDPOINT_DESCRIPTOR_EPADDR_IN | UVC_EP_DATA_IN,
+				0x00, 0x03, 0x00, 0x00, 0x00, 0x01,
+		};
+		vs_header = test_ref_add(&c, sizeof(c));
+		// One zero bmaControls entry for each format.
+		test_ref_len += format_count;
+	}
+	for (i = 0; i < sizeof(formats); i++)
+	{
+		if (count[i])
+		{
+			test_ref_add_format(formats[i], format_index++, count[i]);
+		}
+	}
+	vs_header->wTotalLength = test_ref_len - vs_start;
+
+#ifndef USB_ENDPOINT_USE_ISOC
+	{
+		USB_UVC_VS_BulkVideoDataEndpointDescriptor c = {
+				sizeof(USB_UVC_VS_BulkVideoDataEndpointDescriptor),
+				USB_DESCRIPTOR_TYPE_ENDPOINT,
+				USB_ENDPOINT_DESCRIPTOR_EPADDR_IN | UVC_EP_DATA_IN,
+				USB_ENDPOINT_DESCRIPTOR_ATTR_BULK,
+				(speed == USBD_SPEED_HIGH) ? UVC_DATA_EP_SIZE_HS : UVC_DATA_EP_SIZE_FS, 0x00,
+		};
+		test_ref_add(&c, c.bLength);
+	}
+#else // !USB_ENDPOINT_USE_ISOC
+	for (i = 0; i < UVC_ISOC_ALT_COUNT; i++)
+	{
+		USB_UVC_VS_StandardInterfaceDescriptor c = {
+				sizeof(USB_UVC_VS_StandardInterfaceDescriptor),
+				USB_DESCRIPTOR_TYPE_INTERFACE,
+				1, i + 1, 0x01, USB_CLASS_VIDEO, USB_SUBCLASS_VIDEO_VIDEOSTREAMING,
+				USB_PROTOCOL_VIDEO_UNDEFINED, 0x00,
+		};
+		USB_UVC_VS_IsochronousVideoDataEndpointDescriptor e = {
+				sizeof(USB_UVC_VS_IsochronousVideoDataEndpointDescriptor),
+				USB_DESCRIPTOR_TYPE_ENDPOINT,
+				USB_ENDPOINT_DESCRIPTOR_EPADDR_IN | UVC_EP_DATA_IN,
+				USB_ENDPOINT_DESCRIPTOR_ATTR_ISOCHRONOUS,
+				(speed == USBD_SPEED_HIGH) ? uvc_isoc_alt_size_hs[i] : uvc_isoc_alt_size_fs[i], 0x01,
+		};
+		test_ref_add(&c, c.bLength);
+		test_ref_add(&e, e.bLength);
+	}
+#endif // USB_ENDPOINT_USE_ISOC
+
+	config->wTotalLength = test_ref_len;
+}
+//@}
+
+/** @brief Compare a configuration descriptor with the reference.
+ *  @details Prints the offset of the first difference.
+ */
+static int test_ref_same(const void *desc, uint16_t length)
+{
+	const uint8_t *p = desc;
+	uint16_t i;
+
+	if (length != test_ref_len)
+	{
+		printf("length %u, reference %u\n", length, test_ref_len);
+		return 0;
+	}
+	for (i = 0; i < length; i++)
+	{
+		if (p[i] != test_ref[i])
+		{
+			printf("offset %u: 0x%02x, reference 0x%02x\n", i, p[i], test_ref[i]);
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/** @brief Compile time configuration descriptors match the reference.
+ *  @details Checked at both speeds. The High Speed descriptor must also
+ *  be unchanged by a GET_DESCRIPTOR for the other speed configuration.
+ */
+static void test_config_descriptors(void)
+{
+	USB_device_request req;
+	uint8_t *buffer;
+	uint16_t len;
+
+	test_ref_build(USBD_SPEED_HIGH);
+	TEST_CHECK(test_ref_same(&config_descriptor_hs, sizeof(config_descriptor_hs)));
+	TEST_CHECK(config_descriptor_hs.control.configuration.wTotalLength == sizeof(config_descriptor_hs));
+
+	test_ref_build(USBD_SPEED_FULL);
+	TEST_CHECK(test_ref_same(&config_descriptor_fs, sizeof(config_descriptor_fs)));
+	TEST_CHECK(config_descriptor_fs.control.configuration.wTotalLength == sizeof(config_descriptor_fs));
+
+	// The other speed configuration at Full Speed is the High Speed one.
+	stub_usb_speed = USBD_SPEED_FULL;
+	usb_uvc_init();
+	memset(&req, 0, sizeof(req));
+	req.bRequest = USB_REQUEST_CODE_GET_DESCRIPTOR;
+	req.wValue = USB_DESCRIPTOR_TYPE_OTHER_SPEED_CONFIGURATION << 8;
+	req.wLength = 0xffff;
+	TEST_CHECK(standard_req_get_descriptor(&req, &buffer, &len) == USBD_OK);
+	test_ref_build(USBD_SPEED_HIGH);
+	TEST_CHECK(len == test_ref_len);
+	TEST_CHECK(buffer[0] == test_ref[0]);
+	TEST_CHECK(buffer[1] == USB_DESCRIPTOR_TYPE_OTHER_SPEED_CONFIGURATION);
+	TEST_CHECK(memcmp(&buffer[2], &test_ref[2], len - 2) == 0);
+	TEST_CHECK(test_ref_same(&config_descriptor_hs, sizeof(config_descriptor_hs)));
+}
+
+/** @brief The serial number string carries the camera module ID.
+ *  @details The string table itself is left unchanged.
+ */
+static void test_serial_string(void)
+{
+	USB_device_request req;
+	uint8_t *buffer;
+	uint16_t len;
+	const uint8_t expect[] = {18, USB_DESCRIPTOR_TYPE_STRING,
+			'1', 0, 'A', 0, '2', 0, 'B', 0, '0', 0, '0', 0, '0', 0, '1', 0};
+
+	usb_uvc_build_configuration(0x1a2b);
+	memset(&req, 0, sizeof(req));
+	req.bRequest = USB_REQUEST_CODE_GET_DESCRIPTOR;
+	req.wValue = (USB_DESCRIPTOR_TYPE_STRING << 8) | 3;
+	req.wLength = 0xff;
+	TEST_CHECK(standard_req_get_descriptor(&req, &buffer, &len) == USBD_OK);
+	TEST_CHECK(len == sizeof(expect));
+	TEST_CHECK(memcmp(buffer, expect, sizeof(expect)) == 0);
+
+	// A short read gets only the first characters.
+	req.wLength = 6;
+	TEST_CHECK(standard_req_get_descriptor(&req, &buffer, &len) == USBD_OK);
+	TEST_CHECK(len == 6);
+	TEST_CHECK(memcmp(buffer, expect, 6) == 0);
+
+	TEST_CHECK(memcmp(&string_descriptor[1 + 1 + 19 + 25 + 1], u"xxxx", 8) == 0);
+}
+
+#ifdef USB_ENDPOINT_USE_ISOC
+/** @brief Select an alternate setting of the video streaming interface.
+ */
+static int8_t test_set_interface(uint8_t alt)
+{
+	USB_device_request req;
+
+	memset(&req, 0, sizeof(req));
+	req.bRequest = USB_REQUEST_CODE_SET_INTERFACE;
+	req.bmRequestType = USB_BMREQUESTTYPE_RECIPIENT_INTERFACE;
+	req.wIndex = 1;
+	req.wValue = alt;
+	return setif_req_cb(&req);
+}
+
+/** @brief Missed isochronous service intervals.
+ *  @details The data endpoint is double buffered at both speeds. A
+ *  (micro)frame is counted as missed only when a streaming alternate
+ *  setting is selected, the main loop has data waiting and the host took
+ *  no packet since the last SOF.
+ */
+static void test_isoc_missed_microframes(void)
+{
+	stub_usb_speed = USBD_SPEED_HIGH;
+	usb_uvc_init();
+	TEST_CHECK(stub_ep_db[UVC_EP_DATA_IN] == USBD_DB_ON);
+
+	TEST_CHECK(test_set_interface(1) == USBD_OK);
+	TEST_CHECK(usb_uvc_get_missed_microframes() == 0);
+
+	// Nothing waiting to be sent.
+	class_vs_sof_cb(0);
+	class_vs_sof_cb(1);
+	TEST_CHECK(usb_uvc_sof_event() == 1);
+	TEST_CHECK(usb_uvc_sof_event() == 0);
+	TEST_CHECK(usb_uvc_get_missed_microframes() == 0);
+
+	// A packet is taken in every microframe.
+	usb_uvc_set_data_pending(1);
+	class_vs_data_ep_cb(UVC_EP_DATA_IN);
+	class_vs_sof_cb(2);
+	class_vs_data_ep_cb(UVC_EP_DATA_IN);
+	class_vs_sof_cb(3);
+	class_vs_data_ep_cb(UVC_EP_DATA_IN);
+	class_vs_sof_cb(4);
+	TEST_CHECK(usb_uvc_data_ep_event() == 1);
+	TEST_CHECK(usb_uvc_data_ep_event() == 0);
+	TEST_CHECK(usb_uvc_get_missed_microframes() == 0);
+
+	// Two microframes pass without a packet.
+	class_vs_sof_cb(5);
+	class_vs_sof_cb(6);
+	TEST_CHECK(usb_uvc_get_missed_microframes() == 2);
+	class_vs_data_ep_cb(UVC_EP_DATA_IN);
+	class_vs_sof_cb(7);
+	TEST_CHECK(usb_uvc_get_missed_microframes() == 2);
+
+	// Alternate setting zero has no bandwidth so nothing is missed.
+	TEST_CHECK(test_set_interface(0) == USBD_OK);
+	class_vs_sof_cb(8);
+	class_vs_sof_cb(9);
+	TEST_CHECK(usb_uvc_get_missed_microframes() == 2);
+
+	// Selecting a streaming setting starts a new count.
+	TEST_CHECK(test_set_interface(UVC_ISOC_ALT_COUNT) == USBD_OK);
+	TEST_CHECK(usb_uvc_get_missed_microframes() == 0);
+	TEST_CHECK(test_set_interface(UVC_ISOC_ALT_COUNT + 1) != USBD_OK);
+
+	stub_usb_speed = USBD_SPEED_FULL;
+	usb_uvc_init();
+	TEST_CHECK(stub_ep_db[UVC_EP_DATA_IN] == USBD_DB_ON);
+}
+
+/** @brief Probe every frame and frame rate at both speeds.
+ *  @details A frame rate which does not fit in the largest alternate
+ *  setting is answered with the next slower one which does. The payload
+ *  size returned must then fit in an alternate setting.
+ */
+static void test_isoc_probe_clamp(void)
+{
+	static const uint8_t speeds[] = {USBD_SPEED_HIGH, USBD_SPEED_FULL};
+	static const uint8_t formats[] = {
+			CAMERA_FORMAT_UNCOMPRESSED, CAMERA_FORMAT_LUMA, CAMERA_FORMAT_MJPEG,
+	};
+	static const uint8_t format_index[] = {
+			UVC_FORMAT_INDEX_UNCOMPRESSED, UVC_FORMAT_INDEX_LUMA, UVC_FORMAT_INDEX_MJPEG,
+	};
+	USB_UVC_VideoProbeAndCommitControls probe;
+	uint16_t width, height;
+	uint16_t sample;
+	uint8_t s, f, frame, rate, count, fit;
+	uint32_t interval;
+	int8_t status;
+
+	for (s = 0; s < sizeof(speeds); s++)
+	{
+		stub_usb_speed = speeds[s];
+		usb_uvc_init();
+
+		for (f = 0; f < sizeof(formats); f++)
+		{
+			for (frame = 0; frame < class_vs_frame_count(formats[f]); frame++)
+			{
+				count = camera_mode_get_frame_rate_count(formats[f], frame);
+				for (rate = 0; rate < count; rate++)
+				{
+					interval = camera_mode_get_frame_interval(formats[f], frame, rate);
+					memset(&probe, 0, sizeof(probe));
+					probe.bmHint = USB_UVC_VS_PROBE_COMMIT_CONTROL_BMHINT_FRAMINGINFO;
+					probe.bFormatIndex = format_index[f];
+					probe.bFrameIndex = camera_mode_get_frame(formats[f], frame, &width, &height);
+					probe.dwFrameInterval = interval;
+					status = class_vs_check_probecommit(&probe);
+
+					// The first frame rate from this one onwards which fits.
+					for (fit = rate; fit < count; fit++)
+					{
+						if (class_vs_isoc_alt(formats[f], frame,
+								camera_mode_get_frame_interval(formats[f], frame, fit), &sample))
+						{
+							break;
+						}
+					}
+
+					if (fit == count)
+					{
+						TEST_CHECK(status != USBD_OK);
+						continue;
+					}
+					TEST_CHECK(status == USBD_OK);
+					TEST_CHECK(probe.dwFrameInterval ==
+							camera_mode_get_frame_interval(formats[f], frame, fit));
+					TEST_CHECK(probe.dwMaxPayloadTransferSize <= uvc_isoc_alt_size[UVC_ISOC_ALT_COUNT - 1]);
+				}
+			}
+		}
+	}
+
+	// VGA YUYV at the camera frame rate needs more than the largest
+	// alternate setting at High Speed.
+	stub_usb_speed = USBD_SPEED_HIGH;
+	usb_uvc_init();
+	memset(&probe, 0, sizeof(probe));
+	probe.bmHint = USB_UVC_VS_PROBE_COMMIT_CONTROL_BMHINT_FRAMINGINFO;
+	probe.bFormatIndex = UVC_FORMAT_INDEX_UNCOMPRESSED;
+	probe.bFrameIndex = UVC_FRAME_NAME(UNCOMPRESSED, 640, 480, 0, 0, 640, 480);
+	probe.dwFrameInterval = UVC_FRAME_INTERVAL(1, 15);
+	TEST_CHECK(class_vs_check_probecommit(&probe) == USBD_OK);
+	TEST_CHECK(probe.dwFrameInterval > UVC_FRAME_INTERVAL(1, 15));
+	TEST_CHECK(probe.dwMaxPayloadTransferSize <= UVC_DATA_EP_SIZE_HS);
+
+	// VGA YUYV at 7.5 fps needs 720 bytes per microframe with headroom. A
+	// sample must divide the 1280 byte line so at most 640 bytes fit in a
+	// 1024 byte packet. It is not reachable and settles at 5 fps.
+	memset(&probe, 0, sizeof(probe));
+	probe.bmHint = USB_UVC_VS_PROBE_COMMIT_CONTROL_BMHINT_FRAMINGINFO;
+	probe.bFormatIndex = UVC_FORMAT_INDEX_UNCOMPRESSED;
+	probe.bFrameIndex = UVC_FRAME_NAME(UNCOMPRESSED, 640, 480, 0, 0, 640, 480);
+	probe.dwFrameInterval = UVC_FRAME_INTERVAL(2, 15);
+	TEST_CHECK(class_vs_check_probecommit(&probe) == USBD_OK);
+	TEST_CHECK(probe.dwFrameInterval == UVC_FRAME_INTERVAL(3, 15));
+	TEST_CHECK(probe.dwMaxPayloadTransferSize == 640 + sizeof(USB_UVC_Payload_Header_PTS_SCR));
+
+	// QVGA YUYV at 15 fps, the fastest the camera module runs, fits in
+	// the 768 byte alternate setting.
+	memset(&probe, 0, sizeof(probe));
+	probe.bmHint = USB_UVC_VS_PROBE_COMMIT_CONTROL_BMHINT_FRAMINGINFO;
+	probe.bFormatIndex = UVC_FORMAT_INDEX_UNCOMPRESSED;
+	probe.bFrameIndex = UVC_FRAME_NAME(UNCOMPRESSED, 320, 240, 0, 0, 320, 240);
+	probe.dwFrameInterval = UVC_FRAME_INTERVAL(1, 15);
+	TEST_CHECK(class_vs_check_probecommit(&probe) == USBD_OK);
+	TEST_CHECK(probe.dwFrameInterval == UVC_FRAME_INTERVAL(1, 15));
+	TEST_CHECK(probe.dwMaxPayloadTransferSize == 640 + sizeof(USB_UVC_Payload_Header_PTS_SCR));
+	TEST_CHECK(class_vs_isoc_alt(CAMERA_FORMAT_UNCOMPRESSED, 1, UVC_FRAME_INTERVAL(1, 15), &sample) == 4);
+}
+#endif // USB_ENDPOINT_USE_ISOC
+
+int main(void)
+{
+	TEST_RUN(test_config_descriptors);
+	TEST_RUN(test_serial_string);
+#ifdef USB_ENDPOINT_USE_ISOC
+	TEST_RUN(test_isoc_missed_microframes);
+	TEST_RUN(test_isoc_probe_clamp);
+#endif // USB_ENDPOINT_USE_ISOC
+
+	return TEST_RESULT();
+}